@@ -35,18 +35,40 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
-#include <fnmatch.h>
+#include <time.h>
 #include "AMSStatServer.hpp"
-#include <FirebirdExecuteSQL.hpp>
-#include <FirebirdQuerySQL.hpp>
-#include <FirebirdItem.hpp>
-#include <XMLIterator.hpp>
+#include "StatAllocCounter.hpp"
 #include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <stdint.h>
+
+// maximum number of events returned by one epoll_wait call
+#define EVENT_LOOP_MAX_EVENTS 8
 
 //------------------------------------------------------------------------------
 
 #define MAX_NET_NAME 255
 
+// histogram buckets - batch sizes and latencies (us)
+static const long int BatchSizeBuckets[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 };
+static const long int LatencyBuckets[] = { 100, 250, 500, 1000, 2500, 5000, 10000, 25000,
+                                           50000, 100000, 250000, 500000, 1000000, 2500000 };
+
+#define NUM_OF_BUCKETS(x) ((int)(sizeof(x)/sizeof(x[0])))
+
+// append one metric in text exposition format
+static void AddMetric(std::string& out,const char* p_name,const char* p_type,
+                      const char* p_help,double value)
+{
+    char buffer[256];
+    snprintf(buffer,sizeof(buffer),"# HELP ams_isoftstat_%s %s\n# TYPE ams_isoftstat_%s %s\nams_isoftstat_%s %.15g\n",
+             p_name,p_help,p_name,p_type,p_name,value);
+    out += buffer;
+}
+
 using namespace std;
 
 //------------------------------------------------------------------------------
@@ -60,15 +82,46 @@ MAIN_ENTRY_OBJECT(Server)
 //==============================================================================
 
 CAMSStatServer::CAMSStatServer(void)
+    : BatchSizeHistogram(BatchSizeBuckets,NUM_OF_BUCKETS(BatchSizeBuckets)),
+      BatchWaitHistogram(LatencyBuckets,NUM_OF_BUCKETS(LatencyBuckets)),
+      BatchWriteHistogram(LatencyBuckets,NUM_OF_BUCKETS(LatencyBuckets)),
+      KeyCreateHistogram(LatencyBuckets,NUM_OF_BUCKETS(LatencyBuckets))
 {
     Terminated = false;
+    EpollFD = -1;
+    SignalFD = -1;
+    BatchTimerFD = -1;
+    RollupTimerFD = -1;
+    ErrorTimerFD = -1;
+    WakeupFD = -1;
+    SpoolEnabled = false;
+    RelayEnabled = false;
+    StreamEnabled = false;
+    RateLimitEnabled = false;
+    DedupEnabled = false;
+    RollupEnabled = false;
+    MetricsEnabled = false;
+    StartTime = 0;
+    NumOfKeyFailures = 0;
+    Storage = NULL;
+    pthread_rwlock_init(&KeyCacheLock,NULL);
 }
 
 //------------------------------------------------------------------------------
 
 CAMSStatServer::~CAMSStatServer(void)
 {
-    if( Database.IsLogged() ) Database.Logout();
+    for(size_t i=0; i < Receivers.size(); i++) {
+        delete Receivers[i];
+    }
+    for(size_t i=0; i < Writers.size(); i++) {
+        delete Writers[i];
+    }
+    // storage sessions must be released before the storage
+    Rollup.CloseRollup();
+    if( Storage != NULL ) delete Storage;
+    CloseEventLoop();
+    pthread_rwlock_destroy(&KeyCacheLock);
 }
 
 //==============================================================================
@@ -113,12 +166,86 @@ int CAMSStatServer::Init(int argc, char* argv[])
     vout << "# Server setup" << endl;
     vout << "# ----------------------------------" << endl;
     vout << "# Port        : " << GetPortNumber() << endl;
+    vout << "# Batch size  : " << GetBatchSize() << endl;
+    vout << "# Batch time  : " << GetBatchTimeout() << " ms" << endl;
+    vout << "# Block rows  : " << GetBatchBlockRows() << endl;
+    vout << "# Recv batch  : " << GetReceiveBatchSize() << endl;
+    vout << "# Receivers   : " << GetNumOfReceivers() << endl;
+    vout << "# All families: " << (GetReceiveAllFamilies() ? "yes" : "no") << endl;
+    if( GetReceiveBufferSize() > 0 ) {
+        vout << "# Recv buffer : " << GetReceiveBufferSize() << " bytes" << endl;
+    } else {
+        vout << "# Recv buffer : system default" << endl;
+    }
+    vout << "# Peer TTL    : " << GetPeerCacheTTL() << " s" << endl;
+    vout << "# Peer cache  : " << GetPeerCacheSize() << " addresses" << endl;
+    vout << "# Key cache   : " << GetKeyCacheSize() << " keys" << endl;
+    vout << "# Writers     : " << GetNumOfWriters() << endl;
+    vout << "# Ring size   : " << GetRingSize() << endl;
+    if( GetSpoolEnabled() ) {
+        vout << "# Spool       : " << GetSpoolPath() << " (" << GetSpoolSegmentSize() << " MB segments";
+        if( GetSpoolLimit() > 0 ) vout << ", at most " << GetSpoolLimit() << " MB";
+        vout << ")" << endl;
+    } else {
+        vout << "# Spool       : disabled" << endl;
+    }
+    if( GetRelayEnabled() ) {
+        vout << "# Relay       : " << GetRelayUpstream() << ":" << GetRelayPort()
+             << " (" << GetRelayBatchSize() << " datagrams per batch)" << endl;
+    } else {
+        vout << "# Relay       : disabled" << endl;
+    }
+    if( GetStreamEnabled() ) {
+        if( GetStreamPort() > 0 ) {
+            vout << "# Stream      : " << GetStreamAddress() << ":" << GetStreamPort() << endl;
+        }
+        if( GetStreamUnixPath() != "" ) {
+            vout << "# Stream      : " << GetStreamUnixPath() << endl;
+        }
+    } else {
+        vout << "# Stream      : disabled" << endl;
+    }
+    if( GetRateLimitEnabled() ) {
+        vout << "# Rate limit  : " << GetRateLimitRate() << " datagrams/s per client (burst "
+             << GetRateLimitBurst() << ")" << endl;
+    } else {
+        vout << "# Rate limit  : disabled" << endl;
+    }
+    if( GetDedupEnabled() ) {
+        vout << "# Dedup       : " << GetDedupWindow() << " s window (" << GetDedupMemory() << " MB)" << endl;
+    } else {
+        vout << "# Dedup       : disabled" << endl;
+    }
+    if( GetMetricsEnabled() ) {
+        vout << "# Metrics     : http://" << GetMetricsAddress() << ":" << GetMetricsPort() << "/metrics" << endl;
+    } else {
+        vout << "# Metrics     : disabled" << endl;
+    }
+    if( GetRollupEnabled() ) {
+        vout << "# Rollups     : flushed every " << GetRollupFlushInterval() << " s" << endl;
+    } else {
+        vout << "# Rollups     : disabled" << endl;
+    }
+    vout << "# Error log   : " << GetErrorRingSize() << " entries, flushed every "
+         << GetErrorLogInterval() << " s" << endl;
+    if( GetRelayEnabled() == false ) {
+        vout << "# Reconnect   : up to " << GetReconnectMaxDelay() << " s between attempts";
+        if( GetSpoolEnabled() == false ) {
+            vout << ", " << GetRetryQueueSize() << " queued datagrams per writer";
+        }
+        vout << endl;
+    }
     vout << "#" << endl;
     vout << "# Statistics database" << endl;
     vout << "# ----------------------------------" << endl;
-    vout << "# Database    : " << Server.GetDatabaseName() << endl;
-    vout << "# User        : " << Server.GetDatabaseUser() << endl;
-    vout << "# Password    : " << "********" << endl;
+    vout << "# Backend     : " << GetStorageBackend() << endl;
+    if( GetStorageBackend() == "sqlite" ) {
+        vout << "# Database    : " << GetStoragePath() << endl;
+    } else {
+        vout << "# Database    : " << Server.GetDatabaseName() << endl;
+        vout << "# User        : " << Server.GetDatabaseUser() << endl;
+        vout << "# Password    : " << "********" << endl;
+    }
     vout << "#" << endl;
     CXMLElement* p_watcher = ServerConfig.GetChildElementByPath("config/watcher");
     Watcher.ProcessWatcherControl(vout,p_watcher);
@@ -133,16 +260,24 @@ int CAMSStatServer::Init(int argc, char* argv[])
 
 bool CAMSStatServer::Run(void)
 {
+    // signals are received by signalfd in the event loop, they must be
+    // blocked before any thread is started so that all threads inherit the mask
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask,SIGINT);
+    sigaddset(&mask,SIGTERM);
+    sigaddset(&mask,SIGHUP);
+    if( pthread_sigmask(SIG_BLOCK,&mask,NULL) != 0 ) {
+        ES_ERROR("unable to block signals");
+        return(false);
+    }
+
     // init server
     if( InitServer() == false ) {
         ES_ERROR("unable to init server");
         return(false);
     }
 
-    // set SIGINT hadler to cleanly shutdown server ----------
-    signal(SIGINT,CtrlCSignalHandler);
-    signal(SIGTERM,CtrlCSignalHandler);
-
     // execute server
     Watcher.StartThread(); // watcher
     if( ExecuteServer() == false ) {
@@ -159,16 +294,6 @@ bool CAMSStatServer::Run(void)
 
 //------------------------------------------------------------------------------
 
-void CAMSStatServer::CtrlCSignalHandler(int signal)
-{
-    printf("\nCtrl+C signal recieved.\n   Initiating server shutdown ... \n");
-    printf("Waiting for server finalization ... \n");
-    fflush(stdout);
-    Server.ShutdownServer();
-}
-
-//------------------------------------------------------------------------------
-
 void CAMSStatServer::Finalize(void)
 {
     CSmallTimeAndDate dt;
@@ -207,6 +332,12 @@ bool CAMSStatServer::LoadConfig(void)
         return(false);
     }
 
+    // compile client access list
+    if( ClientACL.Compile(ServerConfig.GetChildElementByPath("config/clients")) == false ) {
+        ES_ERROR("unable to compile client list");
+        return(false);
+    }
+
     return(true);
 }
 
@@ -216,257 +347,776 @@ bool CAMSStatServer::LoadConfig(void)
 
 bool CAMSStatServer::InitServer(void)
 {
-    Database.SetDatabaseName(GetDatabaseName());
+    // a relay forwards datagrams to the central instance, it has no database
+    RelayEnabled = GetRelayEnabled();
+    if( (RelayEnabled == false) && (OpenStorage() == false) ) {
+        ES_ERROR("unable to open storage");
+        return(false);
+    }
+
+    ErrorLog.SetRingSize(GetErrorRingSize());
+
+    // client authorization
+    PeerCache.SetACL(&ClientACL);
+    int peer_cache_size = GetPeerCacheSize();
+    if( peer_cache_size < 1 ) peer_cache_size = 1;
+    PeerCache.SetCache(GetPeerCacheTTL(),peer_cache_size);
+
+    // receivers
+    int nreceivers = GetNumOfReceivers();
+    if( nreceivers < 1 ) nreceivers = 1;
+
+    for(int i=0; i < nreceivers; i++) {
+        CStatReceiver* p_receiver = new CStatReceiver(i);
+        Receivers.push_back(p_receiver);
+        p_receiver->SetBatchSize(GetReceiveBatchSize());
+        p_receiver->SetReceiveBuffer(GetReceiveBufferSize());
+    }
+
+    // stream listener feeds the writers like one more receiver
+    StreamEnabled = GetStreamEnabled();
+    int nrings = nreceivers;
+    if( StreamEnabled ) {
+        StreamListener.SetID(nrings);
+        nrings++;
+    }
+
+    // per-client rate limit
+    RateLimitEnabled = GetRateLimitEnabled();
+    if( RateLimitEnabled ) {
+        RateLimiter.SetLimit(GetRateLimitRate(),GetRateLimitBurst(),GetRateLimitClients());
+    }
+
+    // deduplication
+    DedupEnabled = GetDedupEnabled();
+    if( DedupEnabled ) {
+        int memory = GetDedupMemory();
+        if( memory < 1 ) memory = 1;
+        Dedup.SetFilter(GetDedupWindow(),(size_t)memory*1024*1024);
+    }
+
+    // write-ahead spool, the relay forwards datagrams from the spool
+    SpoolEnabled = GetSpoolEnabled() || RelayEnabled;
+
+    // batches are acknowledged when their records are queued, only the spool
+    // keeps them if the server stops while the database is not available
+    if( StreamEnabled && (SpoolEnabled == false) ) {
+        ES_ERROR("stream listener requires the spool (spool enabled=\"true\")");
+        return(false);
+    }
+    if( SpoolEnabled ) {
+        int segment_size = GetSpoolSegmentSize();
+        if( segment_size < 1 ) segment_size = 1;
+        int limit = GetSpoolLimit();
+        if( limit < 0 ) limit = 0;
+        Spool.SetLimit((size_t)limit*1024*1024);
+        if( Spool.Open(GetSpoolPath(),(size_t)segment_size*1024*1024) == false ) {
+            ES_ERROR("unable to open spool");
+            return(false);
+        }
+    }
+
+    // hourly and daily rollups
+    RollupEnabled = GetRollupEnabled() && (RelayEnabled == false);
+    if( RollupEnabled ) {
+        if( Rollup.InitRollup(Storage) == false ) {
+            ES_ERROR("unable to init rollups");
+            return(false);
+        }
+    }
 
-    if( Database.Login(GetDatabaseUser(),GetDatabasePassword()) == false ) {
-        ES_ERROR("unable to login to the database");
+    if( RelayEnabled ) {
+        Relay.SetUpstream(GetRelayUpstream(),GetRelayPort());
+        Relay.SetBatch(GetRelayBatchSize());
+        Relay.SetSpool(&Spool);
+        return(true);
+    }
+
+    // database writers, each has one ring per receiver and stream listener
+    int nwriters = GetNumOfWriters();
+    if( nwriters < 1 ) nwriters = 1;
+    // the spool is replayed in order by a single writer
+    if( SpoolEnabled && (nwriters > 1) ) {
+        ES_ERROR("enabled spool requires a single writer (pipeline writers=\"1\")");
         return(false);
-    };
+    }
+    int ring_size = GetRingSize();
+    if( ring_size < 1 ) ring_size = 1;
+
+    for(int i=0; i < nwriters; i++) {
+        CStatWriter* p_writer = new CStatWriter(nrings,ring_size);
+        Writers.push_back(p_writer);
+        p_writer->SetBatch(GetBatchSize());
+        p_writer->SetBlockRows(GetBatchBlockRows());
+        // the spool keeps datagrams during database outage on its own
+        if( SpoolEnabled ) {
+            p_writer->SetSpool(&Spool);
+        } else {
+            p_writer->SetRetryQueue(GetRetryQueueSize());
+        }
+        p_writer->SetMaxRetryDelay(GetReconnectMaxDelay()*1000);
+        if( RollupEnabled ) p_writer->SetRollup(&Rollup);
+        // each writer has its own storage session (connection)
+        if( p_writer->InitWriter(Storage) == false ) {
+            ES_ERROR("unable to init database writer");
+            return(false);
+        }
+    }
 
     return(true);
 }
 
-//==============================================================================
 //------------------------------------------------------------------------------
-//==============================================================================
 
-bool CAMSStatServer::ExecuteServer(void)
+bool CAMSStatServer::OpenStorage(void)
 {
-    struct addrinfo hints;
-    struct addrinfo *result, *rp;
-    int  s;
-
-    memset(&hints, 0, sizeof(struct addrinfo));
-    hints.ai_family = AF_UNSPEC;    /* Allow IPv4 or IPv6 */
-    hints.ai_socktype = SOCK_DGRAM; /* Datagram socket */
-    hints.ai_flags = AI_PASSIVE;    /* For wildcard IP address */
-    hints.ai_protocol = 0;          /* Any protocol */
-    hints.ai_canonname = NULL;
-    hints.ai_addr = NULL;
-    hints.ai_next = NULL;
-
-    s = getaddrinfo(NULL,CSmallString(GetPortNumber()), &hints, &result);
-    if(s != 0) {
+    // statistics database
+    Storage = CStatStorage::Create(GetStorageBackend());
+    if( Storage == NULL ) {
         CSmallString error;
-        error << "getaddrinfo: " << gai_strerror(s);
+        error << "unsupported storage backend '" << GetStorageBackend() << "'";
         ES_ERROR(error);
         return(false);
     }
 
-    //  getaddrinfo() returns a list of address structures.
-    // Try each address until we successfully bind(2).
-    // If socket(2) (or bind(2)) fails, we (close the socket
-    // and) try the next address.
+    bool opened;
+    if( GetStorageBackend() == "sqlite" ) {
+        opened = Storage->Open(GetStoragePath(),"","");
+    } else {
+        opened = Storage->Open(GetDatabaseName(),GetDatabaseUser(),GetDatabasePassword());
+    }
+    if( opened == false ) {
+        ES_ERROR("unable to open the database");
+        return(false);
+    }
+
+    // load KEYS table into memory
+    int cache_size = GetKeyCacheSize();
+    if( cache_size < 0 ) cache_size = 0;
+    KeyCache.SetMaxSize(cache_size);
+    if( Storage->LoadKeys(KeyCache) == false ) {
+        ES_ERROR("unable to load keys");
+        return(false);
+    }
+
+    vout << high;
+    vout << "Number of loaded keys: " << KeyCache.GetSize() << endl;
+    vout << low;
 
-    for(rp = result; rp != NULL; rp = rp->ai_next) {
-        Socket = socket(rp->ai_family, rp->ai_socktype,
-                        rp->ai_protocol);
-        if( Socket == -1 ) continue;
+    return(true);
+}
 
-        if( bind(Socket, rp->ai_addr, rp->ai_addrlen) == 0) break; // Success
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
 
-        close(Socket);
+bool CAMSStatServer::ExecuteServer(void)
+{
+    // more receivers share the port by SO_REUSEPORT
+    bool reuse_port = Receivers.size() > 1;
+    bool all_families = GetReceiveAllFamilies();
+
+    for(size_t i=0; i < Receivers.size(); i++) {
+        if( Receivers[i]->OpenSocket(GetPortNumber(),reuse_port,all_families) == false ) {
+            ES_ERROR("unable to open socket");
+            return(false);
+        }
     }
 
-    if( rp == NULL ) { // No address succeeded
-        ES_ERROR("could not bind");
-        return(false);
+    if( StreamEnabled ) {
+        // zero port disables the TCP listener
+        if( (GetStreamPort() > 0) &&
+            (StreamListener.OpenSocket(GetStreamAddress(),GetStreamPort()) == false) ) {
+            ES_ERROR("unable to open stream listener");
+            return(false);
+        }
+        if( (GetStreamUnixPath() != "") &&
+            (StreamListener.OpenUnixSocket(GetStreamUnixPath()) == false) ) {
+            ES_ERROR("unable to open stream listener");
+            return(false);
+        }
     }
 
-    freeaddrinfo(result); // No longer needed
+    MetricsEnabled = GetMetricsEnabled();
+    if( MetricsEnabled ) {
+        if( Metrics.OpenSocket(GetMetricsAddress(),GetMetricsPort()) == false ) {
+            ES_ERROR("unable to open metrics endpoint");
+            return(false);
+        }
+    }
 
-    int counted_requests = 0;
-    int successful_requests = 0;
+    if( OpenEventLoop() == false ) {
+        ES_ERROR("unable to open event loop");
+        return(false);
+    }
 
-    Transaction.AssignToDatabase(&Database);
+    long int start_time = GetTimeInMS();
+    StartTime = start_time;
 
-    // server loop
-    while(Terminated == false) {
+    // start pipeline - writers first, then receiver
+    for(size_t i=0; i < Writers.size(); i++) {
+        Writers[i]->StartThread();
+    }
+    if( RelayEnabled ) Relay.StartThread();
+    if( RollupEnabled ) Rollup.StartThread();
+    if( MetricsEnabled ) Metrics.StartThread();
+    PeerCache.StartThread();
+    for(size_t i=0; i < Receivers.size(); i++) {
+        Receivers[i]->StartThread();
+    }
+    if( StreamEnabled ) StreamListener.StartThread();
 
-        CAddStatDatagram        datagram;
-        struct sockaddr_storage peer_addr;
-        socklen_t               peer_addr_len;
-        ssize_t                 nread;
+    // wait for termination, the pipeline is always drained
+    bool result = RunEventLoop();
 
-        // get datagram ------------------------------
-        peer_addr_len = sizeof(struct sockaddr_storage);
-        nread = recvfrom(Socket,&datagram,sizeof(datagram), 0,
-                         (struct sockaddr *)&peer_addr, &peer_addr_len);
+    // the pipeline is deleted below
+    if( MetricsEnabled ) {
+        Metrics.ShutdownMetrics();
+        Metrics.WaitForThread();
+    }
 
-        counted_requests++;
+    // stop receivers and let writers drain their rings
+    for(size_t i=0; i < Receivers.size(); i++) {
+        Receivers[i]->ShutdownReceiver();
+    }
+    for(size_t i=0; i < Receivers.size(); i++) {
+        Receivers[i]->WaitForThread();
+    }
+    if( StreamEnabled ) {
+        StreamListener.ShutdownListener();
+        StreamListener.WaitForThread();
+    }
+    PeerCache.ShutdownResolver();
+    PeerCache.WaitForThread();
 
-        if(nread == -1) continue;                   // Ignore failed request
-        if(nread != sizeof(datagram) ) continue;    // Ignore incomplete request
+    for(size_t i=0; i < Writers.size(); i++) {
+        Writers[i]->ShutdownWriter();
+    }
+    for(size_t i=0; i < Writers.size(); i++) {
+        Writers[i]->WaitForThread();
+    }
+    // the relay tries to send the last batch, the rest stays in the spool
+    if( RelayEnabled ) {
+        Relay.ShutdownRelay();
+        Relay.WaitForThread();
+    }
+    // the writers are stopped, the last rollups are emitted by the rollup thread
+    if( RollupEnabled ) {
+        Rollup.ShutdownRollup();
+        Rollup.WaitForThread();
+    }
+    ErrorLog.Flush(vout);
+    CloseEventLoop();
+
+    long int elapsed = GetTimeInMS() - start_time;
+
+    // statistics
+    long int requests = 0;
+    long int invalid = 0;
+    long int bad_checksum = 0;
+    long int unauthorized = 0;
+    long int duplicates = 0;
+    long int kernel_drops = 0;
+    long int recv_calls = 0;
+    long int recv_datagrams = 0;
+    long int recv_allocations = 0;
+    int      max_recv_batch = 0;
+    long int packets = 0;
+    long int packet_records = 0;
+    for(size_t i=0; i < Receivers.size(); i++) {
+        requests += Receivers[i]->GetNumOfRequests();
+        invalid += Receivers[i]->GetNumOfInvalid();
+        packets += Receivers[i]->GetNumOfPackets();
+        packet_records += Receivers[i]->GetNumOfPacketRecords();
+        bad_checksum += Receivers[i]->GetNumOfBadChecksum();
+        unauthorized += Receivers[i]->GetNumOfUnauthorized();
+        duplicates += Receivers[i]->GetNumOfDuplicates();
+        kernel_drops += Receivers[i]->GetNumOfKernelDrops();
+        recv_calls += Receivers[i]->GetNumOfRecvCalls();
+        recv_datagrams += Receivers[i]->GetNumOfRecvDatagrams();
+        recv_allocations += Receivers[i]->GetNumOfAllocations();
+        if( max_recv_batch < Receivers[i]->GetMaxRecvBatch() ) max_recv_batch = Receivers[i]->GetMaxRecvBatch();
+    }
 
-        char host[NI_MAXHOST], service[NI_MAXSERV];
-        memset(host,0,NI_MAXHOST);
+    long int successful = 0;
+    long int failed = 0;
+    long int batches = 0;
+    long int failed_batches = 0;
+    long int blocks = 0;
+    long int failed_blocks = 0;
+    long int drops = 0;
+    long int writer_allocations = 0;
+    long int outages = 0;
+    long int longest_outage = 0;
+    for(size_t i=0; i < Writers.size(); i++) {
+        successful += Writers[i]->GetNumOfSuccessful();
+        failed += Writers[i]->GetNumOfFailed();
+        batches += Writers[i]->GetNumOfBatches();
+        failed_batches += Writers[i]->GetNumOfFailedBatches();
+        blocks += Writers[i]->GetNumOfBlocks();
+        failed_blocks += Writers[i]->GetNumOfFailedBlocks();
+        drops += Writers[i]->GetNumOfRingDrops();
+        writer_allocations += Writers[i]->GetNumOfAllocations();
+        outages += Writers[i]->GetNumOfOutages();
+        if( longest_outage < Writers[i]->GetLongestOutage() ) longest_outage = Writers[i]->GetLongestOutage();
+    }
 
-        // get client hostname -----------------------
-        s = getnameinfo((struct sockaddr *) &peer_addr,
-                        peer_addr_len, host, NI_MAXHOST-1,
-                        service, NI_MAXSERV-1, NI_NUMERICSERV);
-        if(s != 0) {
-            // client hostname is not available
-            CSmallString error;
-            error << "getnameinfo: " << gai_strerror(s);
-            ES_ERROR(error);
-            continue;
+    vout << endl;
+    vout << "Number of requests  : " << requests << endl;
+    vout << "Kernel drops        : " << kernel_drops << endl;
+    vout << "Invalid datagrams   : " << invalid << endl;
+    vout << "V2 packets          : " << packets << " (" << packet_records << " records)" << endl;
+    if( RateLimitEnabled ) {
+        vout << "Rate limited        : " << RateLimiter.GetNumOfDropped() << " ("
+             << RateLimiter.GetNumOfClients() << " clients tracked)" << endl;
+        std::vector<SStatLimitedClient> clients;
+        RateLimiter.GetTopClients(clients,10);
+        for(size_t i=0; i < clients.size(); i++) {
+            vout << "  " << clients[i].Address << " : " << clients[i].NumOfDropped
+                 << " dropped, " << clients[i].NumOfPassed << " passed" << endl;
         }
-
-        // validate datagram -------------------------
-        if( datagram.IsValid() == false ) {
-            ES_ERROR("datagram is not valid (checksum error)");
-            continue;
+    }
+    vout << "Checksum errors     : " << bad_checksum << endl;
+    vout << "Unauthorized        : " << unauthorized << endl;
+    if( DedupEnabled ) {
+        vout << "Duplicates          : " << duplicates << endl;
+        vout << "Dedup rotations     : " << Dedup.GetNumOfRotations() << endl;
+    }
+    if( SpoolEnabled ) {
+        vout << "Spooled datagrams   : " << Spool.GetNumOfAppended() << endl;
+        vout << "Spool failures      : " << Spool.GetNumOfFailed() << endl;
+        vout << "Spool overflows     : " << Spool.GetNumOfOverflows() << endl;
+        vout << "Damaged spool recs  : " << Spool.GetNumOfDamaged() << endl;
+        vout << "Replayed datagrams  : " << Spool.GetNumOfCommitted() << endl;
+        vout << "Spool backlog       : " << Spool.GetBacklog() << endl;
+    } else {
+        vout << "Ring overflows      : " << drops << endl;
+    }
+    if( RelayEnabled ) {
+        vout << "Forwarded datagrams : " << Relay.GetNumOfForwarded() << " in "
+             << Relay.GetNumOfBatches() << " batches" << endl;
+        vout << "Relay failures      : " << Relay.GetNumOfFailures() << endl;
+        if( Relay.GetNumOfSentBytes() > 0 ) {
+            vout << "Relay compression   : " << (double)Relay.GetNumOfPayloadBytes()/Relay.GetNumOfSentBytes() << endl;
         }
-
-        // is client authorized? ---------------------
-        if( IsClientAuthorized(host) == false ) {
-            CSmallString error;
-            error << "client (" <<  host << ") is not authorized";
-            ES_ERROR(error);
-            continue;
+    }
+    if( StreamEnabled ) {
+        vout << "Stream connections  : " << StreamListener.GetNumOfConnections() << " ("
+             << StreamListener.GetNumOfUnauthorized() << " unauthorized)" << endl;
+        vout << "Stream batches      : " << StreamListener.GetNumOfBatches() << " ("
+             << StreamListener.GetNumOfBadBatches() << " malformed)" << endl;
+        vout << "Stream records      : " << StreamListener.GetNumOfAccepted() << " ("
+             << StreamListener.GetNumOfDuplicates() << " duplicates)" << endl;
+    }
+    vout << "Successful requests : " << successful << endl;
+    vout << "Failed requests     : " << failed << endl;
+    vout << "Number of batches   : " << batches << endl;
+    vout << "Failed batches      : " << failed_batches << endl;
+    vout << "Insert blocks       : " << blocks << " (" << failed_blocks << " batches retried by rows)" << endl;
+    vout << "Database outages    : " << outages << " (longest " << longest_outage/1000.0 << " s)" << endl;
+    vout << "Receive batch size  : " << GetReceiveBatchSize() << endl;
+    vout << "Receive calls       : " << recv_calls << endl;
+    if( recv_calls > 0 ) {
+        vout << "Datagrams per call  : " << (double)recv_datagrams/recv_calls
+             << " (max " << max_recv_batch << ")" << endl;
+    }
+    if( elapsed > 0 ) {
+        vout << "Datagrams per sec   : " << (double)recv_datagrams*1000.0/elapsed << endl;
+    }
+    // including start-up, the steady state should add none on the receive path
+    // with one writer (the site is copied for writer selection otherwise),
+    // writers copy the keys of each record (library getters return copies)
+    if( CStatAllocCounter::IsEnabled() ) {
+        vout << "Heap allocations    : receivers " << recv_allocations << ", writers " << writer_allocations;
+        if( StreamEnabled ) vout << ", stream " << StreamListener.GetNumOfAllocations();
+        vout << endl;
+    }
+    for(size_t i=0; i < Receivers.size(); i++) {
+        vout << "Receiver #" << i+1 << "         : " << Receivers[i]->GetNumOfRecvDatagrams()
+             << " datagrams, " << Receivers[i]->GetNumOfAccepted() << " accepted, "
+             << Receivers[i]->GetNumOfSockets() << " socket(s), "
+             << Receivers[i]->GetNumOfKernelDrops() << " kernel drops, "
+             << Receivers[i]->GetReceiveBuffer() << " bytes buffer" << endl;
+    }
+    for(size_t i=0; (i < Writers.size()) && (SpoolEnabled == false); i++) {
+        vout << "Writer #" << i+1 << " rings      : depth " << Writers[i]->GetRingDepth()
+             << ", high-water " << Writers[i]->GetRingHighWaterMark()
+             << " of " << Writers[i]->GetRingSize() << " per ring"
+             << ", drops " << Writers[i]->GetNumOfRingDrops()
+             << ", written " << Writers[i]->GetNumOfSuccessful() << endl;
+        if( Writers[i]->GetRetryQueueCapacity() > 0 ) {
+            vout << "Writer #" << i+1 << " retry queue: high-water " << Writers[i]->GetRetryQueueHighWaterMark()
+                 << " of " << Writers[i]->GetRetryQueueCapacity() << endl;
         }
+    }
+    ClientACL.PrintStatistics(vout);
+    if( ClientACL.IsEnabled() && ClientACL.HasNameRules() ) {
+        long int lookups = PeerCache.GetNumOfHits() + PeerCache.GetNumOfMisses();
+        vout << "Cached peers        : " << PeerCache.GetSize() << endl;
+        vout << "Peer cache hits     : " << PeerCache.GetNumOfHits();
+        if( lookups > 0 ) vout << " (" << PeerCache.GetNumOfHits()*100.0/lookups << " %)";
+        vout << endl;
+        vout << "Peer cache misses   : " << PeerCache.GetNumOfMisses()
+             << " (" << PeerCache.GetNumOfEvictions() << " evictions)" << endl;
+        vout << "Peer refreshes      : " << PeerCache.GetNumOfRefreshes()
+             << " (" << PeerCache.GetNumOfDroppedRequests() << " dropped)" << endl;
+        vout << "DNS lookups         : " << PeerCache.GetNumOfLookups() << " (avg "
+             << PeerCache.GetAverageLookupTime() << " ms, max "
+             << PeerCache.GetMaxLookupTime() << " ms)" << endl;
+    }
+    if( RollupEnabled ) {
+        vout << "Rollup buckets      : " << Rollup.GetNumOfBuckets() << endl;
+        vout << "Rollup rows flushed : " << Rollup.GetNumOfFlushedRows() << endl;
+        vout << "Failed rollups      : " << Rollup.GetNumOfFailedFlushes() << endl;
+    }
+    vout << "Cached keys         : " << KeyCache.GetSize() << " (~"
+         << KeyCache.GetMemoryUsage()/1024 << " kB)" << endl;
+    vout << "Key cache hits      : " << KeyCache.GetNumOfHits() << endl;
+    vout << "Key cache misses    : " << KeyCache.GetNumOfMisses() << endl;
+    vout << "Key cache overflows : " << KeyCache.GetNumOfOverflows() << endl;
+    vout << "Key failures        : " << NumOfKeyFailures << endl;
+    ErrorLog.PrintStatistics(vout);
 
-        // write data to database---------------------
-        if( Transaction.StartTransaction() == false ) {
-            ES_ERROR("unable to start database transaction");
-            continue;
-        }
+    // clean-up -------------------------------------
+    for(size_t i=0; i < Receivers.size(); i++) {
+        delete Receivers[i];
+    }
+    Receivers.clear();
+    for(size_t i=0; i < Writers.size(); i++) {
+        delete Writers[i];
+    }
+    Writers.clear();
+    Rollup.CloseRollup();
+    Spool.Close();
+    if( Storage != NULL ) Storage->Close();
 
-        if( WriteDataToDatabase(datagram) == false ){
-            ES_ERROR("unable to write datagram to database");
-            Transaction.RollbackTransaction();
-            continue;
-        }
+    return(result);
+}
 
-        if( Transaction.CommitTransaction() == false ) {
-            ES_ERROR("unable to commit database transaction");
-            continue;
-        }
+//------------------------------------------------------------------------------
+
+bool CAMSStatServer::IsWithinRateLimit(const struct sockaddr* p_addr)
+{
+    if( RateLimitEnabled == false ) return(true);
+    return(RateLimiter.IsAllowed(p_addr));
+}
+
+//------------------------------------------------------------------------------
+
+bool CAMSStatServer::IsDuplicate(const CAddStatDatagram& datagram)
+{
+    if( DedupEnabled == false ) return(false);
+
+    // the whole payload including the client time is compared
+    return(Dedup.IsDuplicate(&datagram,sizeof(datagram)));
+}
+
+//------------------------------------------------------------------------------
 
-        successful_requests++;
+bool CAMSStatServer::DispatchDatagram(int receiver,const CAddStatDatagram& datagram)
+{
+    // accepted datagrams are made durable before database insertion
+    if( SpoolEnabled ) {
+        return(Spool.Append(datagram));
     }
 
-    vout << endl;
-    vout << "Number of requests  : " << counted_requests << endl;
-    vout << "Successful requests : " << successful_requests << endl;
+    // each receiver has its own ring in every writer
+    // datagrams of one site are written by the same writer in order
+    if( Writers.size() == 1 ) return(Writers[0]->Push(receiver,datagram));
 
-    // clean-up -------------------------------------
-    //close(sfd); //it is closed in ShutdownServer
-    Database.Logout();
+    CStatWriter* p_writer = Writers[GetSiteHash(datagram) % Writers.size()];
 
-    return(true);
+    return(p_writer->Push(receiver,datagram));
 }
 
-//==============================================================================
 //------------------------------------------------------------------------------
-//==============================================================================
 
-bool CAMSStatServer::WriteDataToDatabase(CAddStatDatagram& datagram)
+bool CAMSStatServer::CanDispatchBatch(size_t count)
 {
-    CFirebirdExecuteSQL sql_exec;
-    sql_exec.AssignToTransaction(&Transaction);
+    // the stream listener requires the spool, the batch is held
+    // until the spool has room for all its records
+    return(SpoolEnabled && Spool.HasRoom(count));
+}
 
-    if( sql_exec.AllocateInputItems(14) == false ) {
-        ES_ERROR("unable to allocate items for ExecuteSQL");
-        return(false);
-    }
+//------------------------------------------------------------------------------
 
-    // set items
-    sql_exec.GetInputItem(0)->SetInt(GetKeyID(datagram.GetSite()));
-    sql_exec.GetInputItem(1)->SetInt(GetKeyID(datagram.GetModuleName()));
-    sql_exec.GetInputItem(2)->SetInt(GetKeyID(datagram.GetModuleVers()));
-    sql_exec.GetInputItem(3)->SetInt(GetKeyID(datagram.GetModuleArch()));
-    sql_exec.GetInputItem(4)->SetInt(GetKeyID(datagram.GetModuleMode()));
-    sql_exec.GetInputItem(5)->SetInt(GetKeyID(datagram.GetUser()));
-    sql_exec.GetInputItem(6)->SetInt(GetKeyID(datagram.GetHostName()));
-    sql_exec.GetInputItem(7)->SetInt(datagram.GetNCPUs());
-    sql_exec.GetInputItem(8)->SetInt(datagram.GetNumOfHostCPUs());
-    sql_exec.GetInputItem(9)->SetInt(datagram.GetNGPUs());
-    sql_exec.GetInputItem(10)->SetInt(datagram.GetNumOfHostGPUs());
-    sql_exec.GetInputItem(11)->SetInt(datagram.GetNumOfNodes());
-    sql_exec.GetInputItem(12)->SetInt(datagram.GetFlags());
-    sql_exec.GetInputItem(13)->SetTimeAndDate(datagram.GetTimeAndDate());
-
-    CSmallString sql;
-
-    sql = "INSERT INTO \"STATISTICS\" (\"Site\",\"ModuleName\",\"ModuleVers\",\"ModuleArch\","
-          "\"ModuleMode\",\"User\",\"HostName\",\"NCPUS\",\"NHostCPUS\",\"NGPUS\",\"NHostGPUS\",\"NNODES\","
-          "\"Flags\",\"Time\") VALUES(?,?,?,?,?,?,?,?,?,?,?,?,?,?)";
-
-    // execute SQL statement
-    if( sql_exec.ExecuteSQL(sql) == false ) {
-        ES_ERROR("unable to execute SQL statement");
-        return(false);
+size_t CAMSStatServer::GetSiteHash(const CAddStatDatagram& datagram)
+{
+    // FNV-1a
+    CSmallString    site = datagram.GetSite();
+    const char*     p_str = site;
+    size_t          hash = 2166136261u;
+
+    if( p_str == NULL ) return(0);
+    while( *p_str != '\0' ) {
+        hash ^= (unsigned char)*p_str++;
+        hash *= 16777619u;
     }
+    return(hash);
+}
 
-    return(true);
+//------------------------------------------------------------------------------
+
+void CAMSStatServer::ReportError(EStatError error,const struct sockaddr* p_peer,socklen_t peer_len)
+{
+    ErrorLog.Report(error,p_peer,peer_len);
 }
 
 //------------------------------------------------------------------------------
 
-int CAMSStatServer::GetKeyID(const CSmallString& key)
+void CAMSStatServer::ObserveBatch(size_t size,long int wait,long int write)
 {
-    // find key id
-    CFirebirdQuerySQL sql_query;
-    sql_query.AssignToTransaction(&Transaction);
+    BatchSizeHistogram.Observe(size);
+    BatchWaitHistogram.Observe(wait);
+    BatchWriteHistogram.Observe(write);
+}
 
-    CSmallString sql;
+//------------------------------------------------------------------------------
 
-    sql = "SELECT \"ID\" FROM \"KEYS\" WHERE \"Key\" = ?";
+long int CAMSStatServer::GetTimeInMS(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return(ts.tv_sec*1000 + ts.tv_nsec/1000000);
+}
 
-    if( sql_query.PrepareQuery(sql) == false ){
-        ES_ERROR("unable to prepare sql query");
-        return(false);
-    }
+//------------------------------------------------------------------------------
 
-    sql_query.GetInputItem(0)->SetString(key);
+long int CAMSStatServer::GetTimeInUS(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return(ts.tv_sec*1000000 + ts.tv_nsec/1000);
+}
+
+//------------------------------------------------------------------------------
 
-    if( sql_query.ExecuteQueryOnce() == true ){
-        // key exists - return its value
-        return(sql_query.GetOutputItem(0)->GetInt());
+void CAMSStatServer::WriteMetrics(std::string& out)
+{
+    // counters are read without locking, they are updated by single threads
+    long int received = 0;
+    long int invalid = 0;
+    long int packets = 0;
+    long int packet_records = 0;
+    long int bad_checksum = 0;
+    long int unauthorized = 0;
+    long int duplicates = 0;
+    long int accepted = 0;
+    long int dropped = 0;
+    long int kernel_drops = 0;
+    long int rcvbuf = 0;
+    long int recv_allocations = 0;
+    for(size_t i=0; i < Receivers.size(); i++) {
+        received += Receivers[i]->GetNumOfRecvDatagrams();
+        invalid += Receivers[i]->GetNumOfInvalid();
+        packets += Receivers[i]->GetNumOfPackets();
+        packet_records += Receivers[i]->GetNumOfPacketRecords();
+        bad_checksum += Receivers[i]->GetNumOfBadChecksum();
+        unauthorized += Receivers[i]->GetNumOfUnauthorized();
+        duplicates += Receivers[i]->GetNumOfDuplicates();
+        accepted += Receivers[i]->GetNumOfAccepted();
+        dropped += Receivers[i]->GetNumOfDropped();
+        kernel_drops += Receivers[i]->GetNumOfKernelDrops();
+        rcvbuf = Receivers[i]->GetReceiveBuffer();
+        recv_allocations += Receivers[i]->GetNumOfAllocations();
     }
 
-    // create new key
+    long int committed = 0;
+    long int db_failed = 0;
+    long int batches = 0;
+    long int failed_batches = 0;
+    long int depth = 0;
+    long int capacity = 0;
+    long int high_water = 0;
+    long int writer_allocations = 0;
+    long int connected = 0;
+    long int outage = 0;
+    long int outages = 0;
+    long int retry_depth = 0;
+    long int retry_capacity = 0;
+    for(size_t i=0; i < Writers.size(); i++) {
+        committed += Writers[i]->GetNumOfSuccessful();
+        db_failed += Writers[i]->GetNumOfFailed();
+        batches += Writers[i]->GetNumOfBatches();
+        failed_batches += Writers[i]->GetNumOfFailedBatches();
+        depth += Writers[i]->GetRingDepth();
+        capacity += Writers[i]->GetRingCapacity();
+        if( high_water < Writers[i]->GetRingHighWaterMark() ) high_water = Writers[i]->GetRingHighWaterMark();
+        writer_allocations += Writers[i]->GetNumOfAllocations();
+        if( Writers[i]->IsConnected() ) connected++;
+        if( outage < Writers[i]->GetOutageTime() ) outage = Writers[i]->GetOutageTime();
+        outages += Writers[i]->GetNumOfOutages();
+        retry_depth += Writers[i]->GetRetryQueueDepth();
+        retry_capacity += Writers[i]->GetRetryQueueCapacity();
+    }
+    if( SpoolEnabled ) {
+        depth = Spool.GetBacklog();
+    }
 
-    CFirebirdExecuteSQL sql_exec;
-    sql_exec.AssignToTransaction(&Transaction);
+    KeyMutex.Lock();
+    long int keys = KeyCache.GetSize();
+    long int key_hits = KeyCache.GetNumOfHits();
+    long int key_misses = KeyCache.GetNumOfMisses();
+    long int key_failures = NumOfKeyFailures;
+    KeyMutex.Unlock();
+
+    AddMetric(out,"uptime_seconds","gauge","time since the pipeline was started",(GetTimeInMS() - StartTime)/1000.0);
+    AddMetric(out,"received_total","counter","received datagrams",received);
+    AddMetric(out,"invalid_total","counter","datagrams with wrong size",invalid);
+    AddMetric(out,"packets_total","counter","received v2 multi-record packets",packets);
+    AddMetric(out,"packet_records_total","counter","records carried by v2 packets",packet_records);
+    AddMetric(out,"bad_checksum_total","counter","datagrams with wrong checksum",bad_checksum);
+    AddMetric(out,"unauthorized_total","counter","datagrams from unauthorized clients",unauthorized);
+    if( RateLimitEnabled ) {
+        AddMetric(out,"rate_limited_total","counter","datagrams dropped by the client rate limit",RateLimiter.GetNumOfDropped());
+        AddMetric(out,"rate_limited_clients","gauge","clients tracked by the rate limit",RateLimiter.GetNumOfClients());
+        std::vector<SStatLimitedClient> clients;
+        RateLimiter.GetTopClients(clients,20);
+        if( clients.empty() == false ) {
+            out += "# HELP ams_isoftstat_client_rate_limited_total datagrams dropped by the rate limit per client\n";
+            out += "# TYPE ams_isoftstat_client_rate_limited_total counter\n";
+        }
+        for(size_t i=0; i < clients.size(); i++) {
+            char buffer[256];
+            snprintf(buffer,sizeof(buffer),"ams_isoftstat_client_rate_limited_total{client=\"%s\"} %ld\n",
+                     clients[i].Address.c_str(),clients[i].NumOfDropped);
+            out += buffer;
+        }
+    }
+    if( DedupEnabled ) {
+        AddMetric(out,"duplicates_total","counter","retransmitted datagrams dropped by deduplication",duplicates);
+        AddMetric(out,"dedup_filter_inserted","gauge","datagrams in the current generation of the filter",Dedup.GetNumOfInserted());
+    }
+    AddMetric(out,"accepted_total","counter","datagrams passed to the writers",accepted);
+    if( SpoolEnabled ) {
+        AddMetric(out,"spool_failures_total","counter","datagrams that could not be spooled",Spool.GetNumOfFailed());
+        AddMetric(out,"spool_overflows_total","counter","datagrams rejected by the full spool",Spool.GetNumOfOverflows());
+        AddMetric(out,"spool_damaged_total","counter","damaged spool records skipped by the replay",Spool.GetNumOfDamaged());
+    }
+    if( RelayEnabled ) {
+        AddMetric(out,"relay_forwarded_total","counter","datagrams acknowledged by the upstream",Relay.GetNumOfForwarded());
+        AddMetric(out,"relay_batches_total","counter","batches acknowledged by the upstream",Relay.GetNumOfBatches());
+        AddMetric(out,"relay_failures_total","counter","failed connections and sends to the upstream",Relay.GetNumOfFailures());
+        AddMetric(out,"relay_sent_bytes_total","counter","compressed bytes sent to the upstream",Relay.GetNumOfSentBytes());
+        AddMetric(out,"relay_payload_bytes_total","counter","uncompressed payload bytes sent to the upstream",Relay.GetNumOfPayloadBytes());
+        AddMetric(out,"relay_connected","gauge","is the upstream connected",Relay.IsConnected() ? 1 : 0);
+        AddMetric(out,"relay_outage_seconds","gauge","duration of the current upstream outage",Relay.GetOutageTime()/1000.0);
+    }
+    if( StreamEnabled ) {
+        AddMetric(out,"stream_connections_total","counter","accepted stream connections",StreamListener.GetNumOfConnections());
+        AddMetric(out,"stream_unauthorized_total","counter","stream connections from unauthorized clients",StreamListener.GetNumOfUnauthorized());
+        AddMetric(out,"stream_batches_total","counter","acknowledged stream batches",StreamListener.GetNumOfBatches());
+        AddMetric(out,"stream_bad_batches_total","counter","malformed stream batches",StreamListener.GetNumOfBadBatches());
+        AddMetric(out,"stream_records_total","counter","stream records passed to the writers",StreamListener.GetNumOfAccepted());
+    }
+    AddMetric(out,"kernel_drops_total","counter","datagrams dropped by the kernel (socket buffer full)",kernel_drops);
+    AddMetric(out,"dropped_total","counter","datagrams dropped by full rings or spool failures",dropped);
+    AddMetric(out,"receive_buffer_bytes","gauge","receive buffer of receiver sockets",rcvbuf);
+    AddMetric(out,"committed_total","counter","datagrams committed to the database",committed);
+    AddMetric(out,"db_failed_total","counter","datagrams that could not be written to the database",db_failed);
+    AddMetric(out,"batches_total","counter","flushed batches",batches);
+    AddMetric(out,"failed_batches_total","counter","batches retried record by record",failed_batches);
+    AddMetric(out,"queue_depth","gauge","datagrams waiting for the writers",depth);
+    if( SpoolEnabled == false ) {
+        AddMetric(out,"queue_capacity","gauge","capacity of the writer rings",capacity);
+        AddMetric(out,"queue_high_water","gauge","maximum number of datagrams in one ring",high_water);
+    }
+    if( RelayEnabled == false ) {
+        AddMetric(out,"db_connected_writers","gauge","writers connected to the database",connected);
+        AddMetric(out,"db_outage_seconds","gauge","duration of the current database outage",outage/1000.0);
+        AddMetric(out,"db_outages_total","counter","lost database connections",outages);
+    }
+    if( retry_capacity > 0 ) {
+        AddMetric(out,"retry_queue_depth","gauge","datagrams kept in memory during database outage",retry_depth);
+        AddMetric(out,"retry_queue_capacity","gauge","capacity of the retry queues",retry_capacity);
+    }
+    AddMetric(out,"keys_cached","gauge","keys in the key cache",keys);
+    AddMetric(out,"key_cache_hits_total","counter","key cache hits",key_hits);
+    AddMetric(out,"key_cache_misses_total","counter","key cache misses",key_misses);
+    AddMetric(out,"key_failures_total","counter","keys that could not be found or created",key_failures);
+    if( CStatAllocCounter::IsEnabled() ) {
+        AddMetric(out,"receiver_allocations_total","counter","heap allocations of receiver threads",recv_allocations);
+        AddMetric(out,"writer_allocations_total","counter","heap allocations of writer threads",writer_allocations);
+        if( StreamEnabled ) {
+            AddMetric(out,"stream_allocations_total","counter","heap allocations of the stream listener",StreamListener.GetNumOfAllocations());
+        }
+    }
 
-    if( sql_exec.AllocateInputItems(1) == false ) {
-        ES_ERROR("unable to allocate items for ExecuteSQL");
-        return(false);
+    out += "# HELP ams_isoftstat_errors_total errors of the ingest loop per class\n";
+    out += "# TYPE ams_isoftstat_errors_total counter\n";
+    for(int i=0; i < STAT_ERROR_NUM_OF_CLASSES; i++) {
+        char buffer[256];
+        snprintf(buffer,sizeof(buffer),"ams_isoftstat_errors_total{class=\"%s\"} %ld\n",
+                 CStatErrorLog::GetName((EStatError)i),ErrorLog.GetNumOfErrors((EStatError)i));
+        out += buffer;
     }
 
-    // set items
-    sql_exec.GetInputItem(0)->SetString(key);
+    BatchSizeHistogram.Print(out,"ams_isoftstat_batch_size","datagrams per flushed batch",1.0);
+    BatchWaitHistogram.Print(out,"ams_isoftstat_batch_wait_seconds","age of batch when it is flushed",1000000.0);
+    BatchWriteHistogram.Print(out,"ams_isoftstat_db_write_seconds","time to write batch to the database",1000000.0);
+    KeyCreateHistogram.Print(out,"ams_isoftstat_key_create_seconds","time to find or create uncached key",1000000.0);
+}
 
-    sql = "INSERT INTO \"KEYS\" (\"Key\") VALUES(?)";
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
 
-    // execute SQL statement
-    if( sql_exec.ExecuteSQL(sql) == false ) {
-        ES_ERROR("unable to execute SQL statement");
-        return(false);
+int CAMSStatServer::GetKeyID(const CSmallString& key)
+{
+    // called by all writers, cached keys are shared for reading
+    int id = -1;
+
+    pthread_rwlock_rdlock(&KeyCacheLock);
+    bool found = KeyCache.Find(key,id);
+    pthread_rwlock_unlock(&KeyCacheLock);
+
+    if( found ) return(id);
+
+    // the key is not cached - find it in the database or create it,
+    // new keys are created one at a time, a key created meanwhile
+    // by another writer is found in the database
+    KeyMutex.Lock();
+
+    long int start = GetTimeInUS();
+    id = Storage->CreateKey(key);
+    KeyCreateHistogram.Observe(GetTimeInUS() - start);
+    if( id >= 0 ) {
+        pthread_rwlock_wrlock(&KeyCacheLock);
+        KeyCache.Add(key,id);
+        pthread_rwlock_unlock(&KeyCacheLock);
+    } else if( Storage->IsConnected() ) {
+        // a lost connection is handled by the writer as database outage
+        NumOfKeyFailures++;
+        ReportError(STAT_ERROR_KEY);
     }
 
-    // get key value
-    sql = "SELECT \"ID\" FROM \"KEYS\" WHERE \"Key\" = ?";
+    KeyMutex.Unlock();
 
-    if( sql_query.PrepareQuery(sql) == false ){
-        ES_ERROR("unable to prepare sql query");
-        return(false);
-    }
+    return(id);
+}
 
-    sql_query.GetInputItem(0)->SetString(key);
+//------------------------------------------------------------------------------
 
-    if( sql_query.ExecuteQueryOnce() == false ){
-        // key exists - return its value
-        CSmallString error;
-        error << "unable to create key '" << key << "'";
-        ES_ERROR(error);
-        return(-1);
-    }
+bool CAMSStatServer::IsStorageConnected(void)
+{
+    KeyMutex.Lock();
+    bool connected = Storage->IsConnected();
+    KeyMutex.Unlock();
+
+    return(connected);
+}
+
+//------------------------------------------------------------------------------
 
-    return(sql_query.GetOutputItem(0)->GetInt());
+bool CAMSStatServer::ReconnectStorage(void)
+{
+    // called by each reconnecting writer, the key connection is shared
+    // and it is opened again only if it was lost
+    KeyMutex.Lock();
+    bool result = Storage->IsConnected() || Storage->Reconnect();
+    KeyMutex.Unlock();
+
+    return(result);
 }
 
 //==============================================================================
@@ -476,7 +1126,10 @@ int CAMSStatServer::GetKeyID(const CSmallString& key)
 bool CAMSStatServer::ShutdownServer(void)
 {
     Terminated = true;
-    close(Socket);
+    if( WakeupFD >= 0 ) {
+        uint64_t value = 1;
+        if( write(WakeupFD,&value,sizeof(value)) != sizeof(value) ) return(false);
+    }
     return(true);
 }
 
@@ -484,49 +1137,223 @@ bool CAMSStatServer::ShutdownServer(void)
 //------------------------------------------------------------------------------
 //==============================================================================
 
-bool CAMSStatServer::IsClientAuthorized(const char* p_name)
+bool CAMSStatServer::OpenEventLoop(void)
 {
-    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/clients");
-    if( p_ele == NULL ) {
-        // no clients -> everything is allowed
-        return(true);
+    EpollFD = epoll_create1(EPOLL_CLOEXEC);
+    if( EpollFD == -1 ) {
+        ES_ERROR("unable to create epoll instance");
+        return(false);
+    }
+
+    // signals are blocked in Run()
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask,SIGINT);
+    sigaddset(&mask,SIGTERM);
+    sigaddset(&mask,SIGHUP);
+    SignalFD = signalfd(-1,&mask,SFD_NONBLOCK | SFD_CLOEXEC);
+    if( SignalFD == -1 ) {
+        ES_ERROR("unable to create signalfd");
+        return(false);
+    }
+
+    WakeupFD = eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC);
+    if( WakeupFD == -1 ) {
+        ES_ERROR("unable to create eventfd");
+        return(false);
+    }
+
+    // zero timeout means that the batch is flushed only when it is full
+    if( GetBatchTimeout() > 0 ) {
+        BatchTimerFD = CreateTimer(GetBatchTimeout());
+        if( BatchTimerFD == -1 ) {
+            ES_ERROR("unable to create batch timer");
+            return(false);
+        }
     }
 
-    CXMLIterator I(p_ele);
-    CXMLElement* p_cele;
+    if( RollupEnabled ) {
+        long int interval = GetRollupFlushInterval();
+        if( interval < 1 ) interval = 1;
+        RollupTimerFD = CreateTimer(interval*1000);
+        if( RollupTimerFD == -1 ) {
+            ES_ERROR("unable to create rollup timer");
+            return(false);
+        }
+    }
+
+    // pending errors are logged at most once per interval
+    long int error_interval = GetErrorLogInterval();
+    if( error_interval < 1 ) error_interval = 1;
+    ErrorTimerFD = CreateTimer(error_interval*1000);
+    if( ErrorTimerFD == -1 ) {
+        ES_ERROR("unable to create error log timer");
+        return(false);
+    }
 
-    while((p_cele = I.GetNextChildElement("client")) != NULL ) {
-        CSmallString mask;
-        if( p_cele->GetAttribute("name",mask) == true ) {
-            if( fnmatch(mask,p_name,0) == 0 ) return(true);
+    int fds[] = { SignalFD, WakeupFD, BatchTimerFD, RollupTimerFD, ErrorTimerFD };
+    for(size_t i=0; i < sizeof(fds)/sizeof(fds[0]); i++) {
+        if( fds[i] == -1 ) continue;
+        struct epoll_event event;
+        memset(&event,0,sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = fds[i];
+        if( epoll_ctl(EpollFD,EPOLL_CTL_ADD,fds[i],&event) == -1 ) {
+            ES_ERROR("unable to register descriptor in epoll instance");
+            return(false);
         }
     }
 
-    return(false);
+    return(true);
 }
 
 //------------------------------------------------------------------------------
 
-const CSmallString CAMSStatServer::GetDatabaseName(void)
+bool CAMSStatServer::RunEventLoop(void)
 {
-    CSmallString setup = "local:ams_stat.fdb";
-    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config");
-    if( p_ele == NULL ) {
-        ES_ERROR("unable to open config path");
-        return(setup);
-    }
-    if( p_ele->GetAttribute("database",setup) == false ) {
-        ES_ERROR("unable to get setup item");
-        return(setup);
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+
+    while( Terminated == false ) {
+        int nevents = epoll_wait(EpollFD,events,EVENT_LOOP_MAX_EVENTS,-1);
+        if( nevents == -1 ) {
+            if( errno == EINTR ) continue;
+            ES_ERROR("epoll_wait failed");
+            return(false);
+        }
+
+        for(int i=0; i < nevents; i++) {
+            int fd = events[i].data.fd;
+            if( fd == SignalFD ) {
+                ProcessSignals();
+            } else if( fd == WakeupFD ) {
+                ReadTimer(WakeupFD);    // eventfd counter has the same format
+            } else if( fd == BatchTimerFD ) {
+                ReadTimer(BatchTimerFD);
+                for(size_t j=0; j < Writers.size(); j++) {
+                    Writers[j]->RequestFlush();
+                }
+                if( RelayEnabled ) Relay.RequestFlush();
+            } else if( fd == RollupTimerFD ) {
+                ReadTimer(RollupTimerFD);
+                Rollup.RequestFlush();
+            } else if( fd == ErrorTimerFD ) {
+                ReadTimer(ErrorTimerFD);
+                ErrorLog.Flush(vout);
+            }
+        }
     }
-    return(setup);
+
+    return(true);
 }
 
 //------------------------------------------------------------------------------
 
-const CSmallString CAMSStatServer::GetDatabaseUser(void)
+void CAMSStatServer::CloseEventLoop(void)
 {
-    CSmallString setup = "ams";
+    int* fds[] = { &EpollFD, &SignalFD, &WakeupFD, &BatchTimerFD, &RollupTimerFD, &ErrorTimerFD };
+    for(size_t i=0; i < sizeof(fds)/sizeof(fds[0]); i++) {
+        if( *fds[i] != -1 ) close(*fds[i]);
+        *fds[i] = -1;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CAMSStatServer::ProcessSignals(void)
+{
+    struct signalfd_siginfo info;
+
+    while( read(SignalFD,&info,sizeof(info)) == sizeof(info) ) {
+        if( info.ssi_signo == SIGHUP ) {
+            vout << low;
+            vout << "SIGHUP signal received - flushing batches and rollups ..." << endl;
+            FlushPipeline();
+            continue;
+        }
+        vout << low;
+        vout << endl;
+        vout << "Signal " << info.ssi_signo << " received." << endl;
+        vout << "   Initiating server shutdown ... " << endl;
+        vout << "Waiting for server finalization ... " << endl;
+        Terminated = true;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CAMSStatServer::FlushPipeline(void)
+{
+    for(size_t i=0; i < Writers.size(); i++) {
+        Writers[i]->RequestFlush();
+    }
+    if( RelayEnabled ) Relay.RequestFlush();
+    if( RollupEnabled ) Rollup.RequestFlush();
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::CreateTimer(long int interval)
+{
+    int fd = timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK | TFD_CLOEXEC);
+    if( fd == -1 ) return(-1);
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = interval / 1000;
+    spec.it_interval.tv_nsec = (interval % 1000) * 1000000;
+    spec.it_value = spec.it_interval;
+    if( timerfd_settime(fd,0,&spec,NULL) == -1 ) {
+        close(fd);
+        return(-1);
+    }
+
+    return(fd);
+}
+
+//------------------------------------------------------------------------------
+
+void CAMSStatServer::ReadTimer(int fd)
+{
+    uint64_t expirations;
+    // nonblocking descriptor, EAGAIN means that the event was already consumed
+    if( read(fd,&expirations,sizeof(expirations)) != sizeof(expirations) ) return;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CAMSStatServer::IsPeerAuthorized(const struct sockaddr* p_addr,socklen_t addr_len)
+{
+    if( ClientACL.IsEnabled() == false ) {
+        // no clients -> everything is allowed
+        return(true);
+    }
+
+    return(PeerCache.IsAuthorized(p_addr,addr_len));
+}
+
+//------------------------------------------------------------------------------
+
+const CSmallString CAMSStatServer::GetDatabaseName(void)
+{
+    CSmallString setup = "local:ams_stat.fdb";
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config");
+    if( p_ele == NULL ) {
+        ES_ERROR("unable to open config path");
+        return(setup);
+    }
+    if( p_ele->GetAttribute("database",setup) == false ) {
+        ES_ERROR("unable to get setup item");
+        return(setup);
+    }
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+const CSmallString CAMSStatServer::GetDatabaseUser(void)
+{
+    CSmallString setup = "ams";
     CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config");
     if( p_ele == NULL ) {
         ES_ERROR("unable to open config path");
@@ -573,6 +1400,554 @@ int CAMSStatServer::GetPortNumber(void)
     return(setup);
 }
 
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetBatchSize(void)
+{
+    int setup = 1;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/batch");
+    if( p_ele == NULL ) {
+        // no batch -> one transaction per datagram
+        return(setup);
+    }
+    p_ele->GetAttribute("size",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetBatchTimeout(void)
+{
+    int setup = 1000;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/batch");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("timeout",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetBatchBlockRows(void)
+{
+    int setup = 1;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/batch");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("rows",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetKeyCacheSize(void)
+{
+    int setup = 100000;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/keys");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("cache",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetReceiveBatchSize(void)
+{
+    int setup = 1;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/receive");
+    if( p_ele == NULL ) {
+        // no receive -> one datagram per recvfrom call
+        return(setup);
+    }
+    p_ele->GetAttribute("batch",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetNumOfReceivers(void)
+{
+    int setup = 1;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/receive");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("receivers",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetReceiveBufferSize(void)
+{
+    int setup = 0;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/receive");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("buffer",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+bool CAMSStatServer::GetReceiveAllFamilies(void)
+{
+    bool setup = false;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/receive");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("allfamilies",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetNumOfWriters(void)
+{
+    int setup = 1;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/pipeline");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("writers",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetRingSize(void)
+{
+    int setup = 16384;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/pipeline");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("ring",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+const CSmallString CAMSStatServer::GetStorageBackend(void)
+{
+    CSmallString setup = "firebird";
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/storage");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("backend",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+const CSmallString CAMSStatServer::GetStoragePath(void)
+{
+    CSmallString setup = "/var/lib/ams-isoftstat/stat.db";
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/storage");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("path",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+bool CAMSStatServer::GetSpoolEnabled(void)
+{
+    bool setup = false;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/spool");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("enabled",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+const CSmallString CAMSStatServer::GetSpoolPath(void)
+{
+    CSmallString setup = "/var/spool/ams-isoftstat";
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/spool");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("path",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetSpoolSegmentSize(void)
+{
+    int setup = 64;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/spool");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("segment",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetSpoolLimit(void)
+{
+    int setup = 0;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/spool");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("limit",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+bool CAMSStatServer::GetRateLimitEnabled(void)
+{
+    bool setup = false;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/ratelimit");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("enabled",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetRateLimitRate(void)
+{
+    int setup = 100;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/ratelimit");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("rate",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetRateLimitBurst(void)
+{
+    int setup = 1000;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/ratelimit");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("burst",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetRateLimitClients(void)
+{
+    int setup = 10000;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/ratelimit");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("clients",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+bool CAMSStatServer::GetDedupEnabled(void)
+{
+    bool setup = false;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/dedup");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("enabled",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetDedupWindow(void)
+{
+    int setup = 60;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/dedup");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("window",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetDedupMemory(void)
+{
+    int setup = 8;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/dedup");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("memory",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+bool CAMSStatServer::GetRollupEnabled(void)
+{
+    bool setup = false;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/rollup");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("enabled",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetRollupFlushInterval(void)
+{
+    int setup = 60;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/rollup");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("flush",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+bool CAMSStatServer::GetMetricsEnabled(void)
+{
+    bool setup = false;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/metrics");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("enabled",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+const CSmallString CAMSStatServer::GetMetricsAddress(void)
+{
+    CSmallString setup = "127.0.0.1";
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/metrics");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("address",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetMetricsPort(void)
+{
+    int setup = 32598;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/metrics");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("port",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+bool CAMSStatServer::GetRelayEnabled(void)
+{
+    bool setup = false;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/relay");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("enabled",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+const CSmallString CAMSStatServer::GetRelayUpstream(void)
+{
+    CSmallString setup = "localhost";
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/relay");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("upstream",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetRelayPort(void)
+{
+    int setup = STAT_STREAM_PORT;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/relay");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("port",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetRelayBatchSize(void)
+{
+    int setup = 1000;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/relay");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("batch",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+bool CAMSStatServer::GetStreamEnabled(void)
+{
+    bool setup = false;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/stream");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("enabled",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+const CSmallString CAMSStatServer::GetStreamAddress(void)
+{
+    CSmallString setup = "0.0.0.0";
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/stream");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("address",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetStreamPort(void)
+{
+    int setup = STAT_STREAM_PORT;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/stream");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("port",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+const CSmallString CAMSStatServer::GetStreamUnixPath(void)
+{
+    CSmallString setup = "";
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/stream");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("unix",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetErrorRingSize(void)
+{
+    int setup = 64;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/errors");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("ring",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetErrorLogInterval(void)
+{
+    int setup = 60;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/errors");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("interval",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetRetryQueueSize(void)
+{
+    int setup = 10000;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/reconnect");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("queue",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetReconnectMaxDelay(void)
+{
+    int setup = 60;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/reconnect");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("delay",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetPeerCacheTTL(void)
+{
+    int setup = 300;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/peers");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("ttl",setup); // optional
+    return(setup);
+}
+
+//------------------------------------------------------------------------------
+
+int CAMSStatServer::GetPeerCacheSize(void)
+{
+    int setup = 10000;
+    CXMLElement* p_ele = ServerConfig.GetChildElementByPath("config/peers");
+    if( p_ele == NULL ) {
+        return(setup);
+    }
+    p_ele->GetAttribute("cache",setup); // optional
+    return(setup);
+}
+
 //==============================================================================
 //------------------------------------------------------------------------------
 //==============================================================================
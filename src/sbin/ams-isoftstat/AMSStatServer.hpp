@@ -21,14 +21,30 @@
 // =============================================================================
 
 #include <AMSMainHeader.hpp>
-#include <FirebirdDatabase.hpp>
-#include <FirebirdTransaction.hpp>
 #include <XMLDocument.hpp>
 #include <VerboseStr.hpp>
 #include <TerminalStr.hpp>
 #include <SoftStat.hpp>
 #include <ServerWatcher.hpp>
 #include "AMSStatServerOptions.hpp"
+#include "StatKeyCache.hpp"
+#include "StatStorage.hpp"
+#include "StatReceiver.hpp"
+#include "StatWriter.hpp"
+#include "StatPeerCache.hpp"
+#include "StatSpool.hpp"
+#include "StatRollup.hpp"
+#include "StatMetrics.hpp"
+#include "StatHistogram.hpp"
+#include "StatDedup.hpp"
+#include "StatRateLimiter.hpp"
+#include "StatRelay.hpp"
+#include "StatStreamListener.hpp"
+#include "StatErrorLog.hpp"
+#include <SimpleMutex.hpp>
+#include <pthread.h>
+#include <vector>
+#include <string>
 
 //------------------------------------------------------------------------------
 
@@ -55,6 +71,9 @@ public:
     //! init server, e.g. open database
     bool InitServer(void);
 
+    //! open statistics database and load keys
+    bool OpenStorage(void);
+
 // information methods ---------------------------------------------------------
     //! return the name of database
     const CSmallString GetDatabaseName(void);
@@ -65,39 +84,274 @@ public:
     //! return the password for access to the database
     const CSmallString GetDatabasePassword(void);
 
+    //! return the storage backend (firebird or sqlite)
+    const CSmallString GetStorageBackend(void);
+
+    //! return the database file of the sqlite backend
+    const CSmallString GetStoragePath(void);
+
     //! return the port number to listen on
     int GetPortNumber(void);
 
+    //! return the maximum number of datagrams written in one transaction
+    int GetBatchSize(void);
+
+    //! return the maximum time in ms the datagrams are kept in the batch
+    int GetBatchTimeout(void);
+
+    //! return the number of rows inserted by one EXECUTE BLOCK statement
+    int GetBatchBlockRows(void);
+
+    //! return the maximum number of datagrams received by one call
+    int GetReceiveBatchSize(void);
+
+    //! return the number of receiver threads
+    int GetNumOfReceivers(void);
+
+    //! should receivers bind to all address families?
+    bool GetReceiveAllFamilies(void);
+
+    //! return SO_RCVBUF of receiver sockets in bytes, 0 means system default
+    int GetReceiveBufferSize(void);
+
+    //! return the lifetime of cached authorization decisions in seconds
+    int GetPeerCacheTTL(void);
+
+    //! return the maximum number of cached peer addresses
+    int GetPeerCacheSize(void);
+
+    //! return the maximum number of keys kept in memory
+    int GetKeyCacheSize(void);
+
+    //! return the number of database writers
+    int GetNumOfWriters(void);
+
+    //! return the capacity of the writer ring
+    int GetRingSize(void);
+
+    //! should accepted datagrams be spooled before database insertion?
+    bool GetSpoolEnabled(void);
+
+    //! return the spool directory
+    const CSmallString GetSpoolPath(void);
+
+    //! return the size of spool segment in MB
+    int GetSpoolSegmentSize(void);
+
+    //! return the maximum size of the spool on the disk in MB (0 = unlimited)
+    int GetSpoolLimit(void);
+
+    //! should datagrams of each client be rate limited?
+    bool GetRateLimitEnabled(void);
+
+    //! return the number of datagrams per second allowed for one client
+    int GetRateLimitRate(void);
+
+    //! return the number of datagrams one client can send at once
+    int GetRateLimitBurst(void);
+
+    //! return the maximum number of tracked clients
+    int GetRateLimitClients(void);
+
+    //! should retransmitted datagrams be dropped?
+    bool GetDedupEnabled(void);
+
+    //! return the deduplication window in s
+    int GetDedupWindow(void);
+
+    //! return the memory of the deduplication filter in MB
+    int GetDedupMemory(void);
+
+    //! should hourly and daily rollups be maintained?
+    bool GetRollupEnabled(void);
+
+    //! return the interval in s between rollup flushes
+    int GetRollupFlushInterval(void);
+
+    //! should the metrics endpoint be started?
+    bool GetMetricsEnabled(void);
+
+    //! return the address of the metrics endpoint
+    const CSmallString GetMetricsAddress(void);
+
+    //! return the port of the metrics endpoint
+    int GetMetricsPort(void);
+
+    //! should accepted datagrams be forwarded to the central instance?
+    bool GetRelayEnabled(void);
+
+    //! return the host of the central instance
+    const CSmallString GetRelayUpstream(void);
+
+    //! return the stream port of the central instance
+    int GetRelayPort(void);
+
+    //! return the maximum number of records forwarded in one batch
+    int GetRelayBatchSize(void);
+
+    //! should the stream listener be started?
+    bool GetStreamEnabled(void);
+
+    //! return the address of the stream listener
+    const CSmallString GetStreamAddress(void);
+
+    //! return the port of the stream listener, 0 = no TCP listener
+    int GetStreamPort(void);
+
+    //! return the Unix socket of the stream listener, empty = none
+    const CSmallString GetStreamUnixPath(void);
+
+    //! return the number of distinct errors kept in the error ring
+    int GetErrorRingSize(void);
+
+    //! return the interval in s between error log flushes
+    int GetErrorLogInterval(void);
+
+    //! return the number of datagrams kept by each writer during database outage
+    int GetRetryQueueSize(void);
+
+    //! return the maximum delay in s between database reconnect attempts
+    int GetReconnectMaxDelay(void);
+
 // execute server --------------------------------------------------------------
     //! execute server
     bool ExecuteServer(void);
 
-    //! terminate server
+    //! terminate server, it can be called from any thread
     bool ShutdownServer(void);
 
+// pipeline methods ------------------------------------------------------------
+    //! is peer authorized to write data to database? (receiver threads)
+    bool IsPeerAuthorized(const struct sockaddr* p_addr,socklen_t addr_len);
+
+    //! has the client a token for the datagram? (receiver threads)
+    bool IsWithinRateLimit(const struct sockaddr* p_addr);
+
+    //! was the same datagram received within the window? (receiver threads)
+    bool IsDuplicate(const CAddStatDatagram& datagram);
+
+    //! pass validated datagram to a writer (receiver thread)
+    bool DispatchDatagram(int receiver,const CAddStatDatagram& datagram);
+
+    //! can count datagrams be passed to the spool at once? (stream listener)
+    bool CanDispatchBatch(size_t count);
+
+    //! get key id, create the key if it does not exist (writer threads)
+    int GetKeyID(const CSmallString& key);
+
+    //! is the key connection alive? (writer threads)
+    bool IsStorageConnected(void);
+
+    //! open the key connection again if it was lost (writer threads)
+    bool ReconnectStorage(void);
+
+    //! record error of the ingest loop, the peer is optional (any thread)
+    void ReportError(EStatError error,const struct sockaddr* p_peer=NULL,socklen_t peer_len=0);
+
+    //! record size, age (us) and write time (us) of flushed batch (writer threads)
+    void ObserveBatch(size_t size,long int wait,long int write);
+
+    //! write current metrics in text exposition format (metrics thread)
+    void WriteMetrics(std::string& out);
+
+    //! get monotonic time in ms
+    static long int GetTimeInMS(void);
+
+    //! get monotonic time in us
+    static long int GetTimeInUS(void);
+
 // section of private data -----------------------------------------------------
 private:
     CAMSStatServerOptions   Options;
     CTerminalStr            Console;
     CVerboseStr             vout;
     CXMLDocument            ServerConfig;
-    CFirebirdDatabase       Database;
-    CFirebirdTransaction    Transaction;
-    bool                    Terminated;
-    int                     Socket;
+    CStatStorage*           Storage;
+    volatile bool           Terminated;
     CServerWatcher          Watcher;
 
-    //! is client authorized to write data to database?
-    bool IsClientAuthorized(const char* p_name);
+    // event loop of the main thread
+    int                     EpollFD;
+    int                     SignalFD;       // SIGINT, SIGTERM, SIGHUP
+    int                     BatchTimerFD;   // partial batch flush
+    int                     RollupTimerFD;  // rollup emission
+    int                     ErrorTimerFD;   // error log flush
+    int                     WakeupFD;       // ShutdownServer
 
-    //! interuption handler
-    static void CtrlCSignalHandler(int signal);
+    // pipeline
+    std::vector<CStatReceiver*> Receivers;
+    std::vector<CStatWriter*>   Writers;
 
-    //! write datagram to database
-    bool WriteDataToDatabase(CAddStatDatagram& datagram);
+    // write-ahead spool
+    bool                    SpoolEnabled;
+    CStatSpool              Spool;
 
-    //! get key id
-    int GetKeyID(const CSmallString& key);
+    // relay mode - datagrams are forwarded instead of written
+    bool                    RelayEnabled;
+    CStatRelay              Relay;
+
+    // batches from relays
+    bool                    StreamEnabled;
+    CStatStreamListener     StreamListener;
+
+    // per-client rate limit
+    bool                    RateLimitEnabled;
+    CStatRateLimiter        RateLimiter;
+
+    // deduplication of retransmitted datagrams
+    bool                    DedupEnabled;
+    CStatDedup              Dedup;
+
+    // hourly and daily rollups
+    bool                    RollupEnabled;
+    CStatRollup             Rollup;
+
+    // live metrics
+    bool                    MetricsEnabled;
+    CStatMetrics            Metrics;
+    long int                StartTime;      // ms
+    CStatHistogram          BatchSizeHistogram;
+    CStatHistogram          BatchWaitHistogram;
+    CStatHistogram          BatchWriteHistogram;
+    CStatHistogram          KeyCreateHistogram;
+
+    // errors of the ingest loop
+    CStatErrorLog           ErrorLog;
+
+    // client authorization
+    CStatClientACL          ClientACL;
+    CStatPeerCache          PeerCache;
+
+    // keys - cache hits take only the read lock, KeyMutex serializes
+    // key creation and the key connection of the storage
+    CSimpleMutex            KeyMutex;
+    pthread_rwlock_t        KeyCacheLock;
+    CStatKeyCache           KeyCache;
+    long int                NumOfKeyFailures;
+
+    //! create epoll instance, signalfd, timerfds and wakeup eventfd
+    bool OpenEventLoop(void);
+
+    //! wait for signals and timers until the server is terminated
+    bool RunEventLoop(void);
+
+    //! close event loop descriptors
+    void CloseEventLoop(void);
+
+    //! handle pending signals
+    void ProcessSignals(void);
+
+    //! flush partial batches and rollups now
+    void FlushPipeline(void);
+
+    //! create periodic monotonic timer
+    static int CreateTimer(long int interval);
+
+    //! read the number of timer expirations
+    static void ReadTimer(int fd);
+
+    //! hash of the datagram site (writer selection)
+    static size_t GetSiteHash(const CAddStatDatagram& datagram);
 };
 
 // -----------------------------------------------------------------------------
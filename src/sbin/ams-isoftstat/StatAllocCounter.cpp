@@ -0,0 +1,93 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include "StatAllocCounter.hpp"
+#include <new>
+#include <stdlib.h>
+
+//------------------------------------------------------------------------------
+
+// counters of the calling thread, no locking is needed
+static __thread long int NumOfThreadAllocations = 0;
+static __thread long int NumOfThreadBytes = 0;
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+#ifdef STAT_COUNT_ALLOCATIONS
+
+// array and nothrow forms of the standard library call these two,
+// the new handler is not called (diagnostic build only)
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+    if( size == 0 ) size = 1;
+
+    void* p_mem = malloc(size);
+    if( p_mem == NULL ) throw std::bad_alloc();
+
+    NumOfThreadAllocations++;
+    NumOfThreadBytes += size;
+
+    return(p_mem);
+}
+
+//------------------------------------------------------------------------------
+
+void operator delete(void* p_mem) throw()
+{
+    free(p_mem);
+}
+
+#endif
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatAllocCounter::IsEnabled(void)
+{
+#ifdef STAT_COUNT_ALLOCATIONS
+    return(true);
+#else
+    return(false);
+#endif
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatAllocCounter::GetNumOfAllocations(void)
+{
+    return(NumOfThreadAllocations);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatAllocCounter::GetNumOfAllocatedBytes(void)
+{
+    return(NumOfThreadBytes);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
@@ -0,0 +1,50 @@
+#ifndef StatAllocCounterH
+#define StatAllocCounterH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+//------------------------------------------------------------------------------
+
+/// heap allocations of the calling thread
+/*! when built with STAT_COUNT_ALLOCATIONS=ON the server replaces global
+    operator new and counts allocations per thread, pipeline threads publish
+    their counters so that it can be checked that the steady-state receive
+    path does not allocate, memory taken directly by malloc() (e.g. in C
+    libraries) is not counted, the counters are zero otherwise
+*/
+
+class CStatAllocCounter {
+public:
+// information methods ---------------------------------------------------------
+    //! are allocations counted?
+    static bool IsEnabled(void);
+
+    //! number of allocations done by the calling thread
+    static long int GetNumOfAllocations(void);
+
+    //! number of bytes allocated by the calling thread
+    static long int GetNumOfAllocatedBytes(void);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
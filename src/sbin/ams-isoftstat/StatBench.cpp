@@ -0,0 +1,576 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include "StatBench.hpp"
+#include "StatPacket.hpp"
+#include <ErrorSystem.hpp>
+#include <SmallTimeAndDate.hpp>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+
+// interval between database polls (us)
+#define POLLER_IDLE_TIME 10000
+
+// interval between checks while waiting for commits (us)
+#define BENCH_WAIT_TIME 100000
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+CStatBench Bench;
+
+MAIN_ENTRY_OBJECT(Bench)
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatBenchPoller::CStatBenchPoller(CStatBench* p_bench)
+{
+    Bench = p_bench;
+    Terminated = false;
+    Session = NULL;
+    NumOfCommitted = 0;
+}
+
+//------------------------------------------------------------------------------
+
+CStatBenchPoller::~CStatBenchPoller(void)
+{
+    ClosePoller();
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatBenchPoller::InitPoller(CStatStorage* p_storage,const CSmallString& site)
+{
+    Site = site;
+
+    Session = p_storage->CreateSession();
+    if( Session == NULL ) {
+        ES_ERROR("unable to create storage session");
+        return(false);
+    }
+
+    if( Session->PrepareCount() == false ) {
+        ES_ERROR("unable to prepare STATISTICS count");
+        return(false);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatBenchPoller::ShutdownPoller(void)
+{
+    Terminated = true;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatBenchPoller::ClosePoller(void)
+{
+    if( Session != NULL ) delete Session;
+    Session = NULL;
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatBenchPoller::GetNumOfCommitted(void)
+{
+    return(NumOfCommitted);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatBenchPoller::ExecuteThread(void)
+{
+    while( Terminated == false ) {
+        // zero until the server creates the site key
+        long int count = Session->CountRecords(Site);
+        long int now = CStatBench::GetTimeInUS();
+
+        // commit order is not known, datagrams are assumed to be committed
+        // in the order they were sent
+        long int sent = Bench->GetNumOfSent();
+        if( count > sent ) count = sent;
+        for(long int i = NumOfCommitted; i < count; i++) {
+            Bench->SetCommitted(i,now);
+        }
+        if( count > NumOfCommitted ) NumOfCommitted = count;
+
+        usleep(POLLER_IDLE_TIME);
+    }
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatBench::CStatBench(void)
+    : Poller(this)
+{
+    Socket = -1;
+    Seed = 0;
+    NumOfSent = 0;
+    NumOfSendErrors = 0;
+    Storage = NULL;
+}
+
+//------------------------------------------------------------------------------
+
+CStatBench::~CStatBench(void)
+{
+    // the session must be released before the storage
+    Poller.ClosePoller();
+    if( Storage != NULL ) delete Storage;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+int CStatBench::Init(int argc, char* argv[])
+{
+    // encode program options, all check procedures are done inside of CABFIntOpts
+    int result = Options.ParseCmdLine(argc,argv);
+
+    // should we exit or was it error?
+    if( result != SO_CONTINUE ) return(result);
+
+    // attach verbose stream to terminal stream and set desired verbosity level
+    Console.Attach(stdout);
+    vout.Attach(Console);
+    if( Options.GetOptVerbose() ) {
+        vout.Verbosity(CVerboseStr::high);
+    } else {
+        vout.Verbosity(CVerboseStr::low);
+    }
+
+    CSmallTimeAndDate dt;
+    dt.GetActualTimeAndDate();
+
+    vout << low;
+    vout << endl;
+    vout << "# ==============================================================================" << endl;
+    vout << "# ams-isoftstat-bench (AMS utility) started at " << dt.GetSDateAndTime() << endl;
+    vout << "# ==============================================================================" << endl;
+    vout << "# Server      : " << Options.GetOptServer() << ":" << Options.GetOptPort() << endl;
+    vout << "# Datagrams   : " << Options.GetOptCount() << endl;
+    if( Options.GetOptRate() > 0 ) {
+        vout << "# Rate        : " << Options.GetOptRate() << " datagrams/s" << endl;
+    } else {
+        vout << "# Rate        : maximum" << endl;
+    }
+    if( Options.GetOptRecords() > 1 ) {
+        vout << "# Records     : " << Options.GetOptRecords() << " per datagram (v2 packets)" << endl;
+    }
+    vout << "# Key mix     : " << Options.GetOptModules() << " modules, " << Options.GetOptUsers()
+         << " users, " << Options.GetOptHosts() << " hosts" << endl;
+    vout << "# Database    : " << Options.GetOptDatabase() << " (" << Options.GetOptBackend() << ")" << endl;
+    vout << "# ------------------------------------------------------------------------------" << endl;
+
+    return(SO_CONTINUE);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatBench::Run(void)
+{
+    // unique site identifies datagrams of this run
+    Seed = getpid() ^ time(NULL);
+    Site << "{BENCH:" << (int)getpid() << "." << (long int)time(NULL) << "}";
+
+    // the database written by the server, an sqlite database is a file
+    Storage = CStatStorage::Create(Options.GetOptBackend());
+    if( Storage == NULL ) {
+        ES_ERROR("unsupported storage backend");
+        return(false);
+    }
+    if( Storage->Open(Options.GetOptDatabase(),Options.GetOptUser(),Options.GetOptPassword()) == false ) {
+        ES_ERROR("unable to open the database");
+        return(false);
+    }
+
+    if( Poller.InitPoller(Storage,Site) == false ) {
+        ES_ERROR("unable to init poller");
+        Storage->Close();
+        return(false);
+    }
+
+    if( OpenSocket() == false ) {
+        ES_ERROR("unable to open socket");
+        Storage->Close();
+        return(false);
+    }
+
+    SendTimes.resize(Options.GetOptCount(),0);
+    Latencies.resize(Options.GetOptCount(),-1);
+
+    long int received = 0;
+    long int rcvbuf_errors = 0;
+    GetUDPCounters(received,rcvbuf_errors);
+
+    Poller.StartThread();
+
+    // send datagrams
+    long int start = GetTimeInUS();
+    if( Options.GetOptRecords() > 1 ) {
+        SendPackets();
+    } else {
+        SendDatagrams();
+    }
+    long int elapsed = GetTimeInUS() - start;
+
+    // wait for commits
+    long int wait_start = GetTimeInUS();
+    while( (Poller.GetNumOfCommitted() < NumOfSent) &&
+           (GetTimeInUS() - wait_start < (long int)Options.GetOptWait()*1000000) ) {
+        usleep(BENCH_WAIT_TIME);
+    }
+
+    Poller.ShutdownPoller();
+    Poller.WaitForThread();
+
+    long int received_end = 0;
+    long int rcvbuf_errors_end = 0;
+    if( GetUDPCounters(received_end,rcvbuf_errors_end) == true ) {
+        received = received_end - received;
+        rcvbuf_errors = rcvbuf_errors_end - rcvbuf_errors;
+    } else {
+        received = -1;
+        rcvbuf_errors = -1;
+    }
+
+    PrintResults(elapsed,received,rcvbuf_errors);
+
+    close(Socket);
+    Storage->Close();
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatBench::Finalize(void)
+{
+    CSmallTimeAndDate dt;
+    dt.GetActualTimeAndDate();
+
+    vout << low;
+    vout << endl;
+    vout << "# ==============================================================================" << endl;
+    vout << "# ams-isoftstat-bench (AMS utility) terminated at " << dt.GetSDateAndTime() << endl;
+    vout << "# ==============================================================================" << endl;
+
+    if( ErrorSystem.IsError() || Options.GetOptVerbose() ){
+        ErrorSystem.PrintErrors(vout);
+    }
+
+    vout << endl;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatBench::OpenSocket(void)
+{
+    struct addrinfo hints;
+    struct addrinfo* result;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    int s = getaddrinfo(Options.GetOptServer(),CSmallString(Options.GetOptPort()),&hints,&result);
+    if( s != 0 ) {
+        CSmallString error;
+        error << "getaddrinfo: " << gai_strerror(s);
+        ES_ERROR(error);
+        return(false);
+    }
+
+    // connected socket - send() does not resolve the address again
+    struct addrinfo* rp;
+    for(rp = result; rp != NULL; rp = rp->ai_next) {
+        Socket = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+        if( Socket == -1 ) continue;
+        if( connect(Socket, rp->ai_addr, rp->ai_addrlen) == 0 ) break;
+        close(Socket);
+        Socket = -1;
+    }
+    freeaddrinfo(result);
+
+    if( Socket == -1 ) {
+        ES_ERROR("unable to connect to the server");
+        return(false);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatBench::SendDatagrams(void)
+{
+    long int count = Options.GetOptCount();
+    long int rate = Options.GetOptRate();
+    long int start = GetTimeInUS();
+
+    CAddStatDatagram datagram;
+
+    for(long int i=0; i < count; i++) {
+        // fixed rate - wait for the slot of the datagram
+        if( rate > 0 ) {
+            long int slot = start + i*1000000/rate;
+            long int now = GetTimeInUS();
+            if( slot > now ) usleep(slot - now);
+        }
+
+        ForgeDatagram(datagram);
+
+        SendTimes[i] = GetTimeInUS();
+        if( send(Socket,&datagram,sizeof(datagram),0) != sizeof(datagram) ) {
+            NumOfSendErrors++;
+            // keep the index - the datagram is sent again
+            i--;
+            if( errno != ENOBUFS ) break;
+            continue;
+        }
+        NumOfSent++;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CStatBench::SendPackets(void)
+{
+    long int count = Options.GetOptCount();
+    long int rate = Options.GetOptRate();
+    long int records = Options.GetOptRecords();
+    long int start = GetTimeInUS();
+
+    CAddStatDatagram datagram;
+    CStatPacket      packet;
+
+    long int i = 0;
+    while( i < count ) {
+        // fixed rate of records - wait for the slot of the first one
+        if( rate > 0 ) {
+            long int slot = start + i*1000000/rate;
+            long int now = GetTimeInUS();
+            if( slot > now ) usleep(slot - now);
+        }
+
+        packet.Clear();
+        long int n = 0;
+        while( (n < records) && (i + n < count) ) {
+            ForgeDatagram(datagram);
+            if( packet.AddRecord(datagram) == false ) break;    // packet is full
+            n++;
+        }
+        packet.Finish();
+
+        long int now = GetTimeInUS();
+        for(long int j=i; j < i + n; j++) {
+            SendTimes[j] = now;
+        }
+        if( send(Socket,packet.GetData(),packet.GetSize(),0) != (ssize_t)packet.GetSize() ) {
+            NumOfSendErrors++;
+            // keep the index - the packet is forged and sent again
+            if( errno != ENOBUFS ) break;
+            continue;
+        }
+        NumOfSent += n;
+        i += n;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CStatBench::ForgeDatagram(CAddStatDatagram& datagram)
+{
+    static const char* archs[] = { "x86_64", "noarch", "x86_64-avx2", "x86_64-avx512" };
+    static const char* modes[] = { "single", "para", "gpu", "mpi" };
+
+    int module = GetSkewedIndex(Options.GetOptModules());
+    int version = GetSkewedIndex(4);
+
+    CSmallString name;
+    CSmallString vers;
+    CSmallString user;
+    CSmallString host;
+
+    name << "module" << module;
+    vers << version + 1 << "." << module % 10;
+    user << "user" << GetSkewedIndex(Options.GetOptUsers());
+    host << "node" << GetSkewedIndex(Options.GetOptHosts());
+
+    datagram.SetSite(Site);
+    datagram.SetModuleName(name);
+    datagram.SetModuleVers(vers);
+    datagram.SetModuleArch(archs[GetSkewedIndex(4)]);
+    datagram.SetModuleMode(modes[GetSkewedIndex(4)]);
+    datagram.SetUser(user);
+    datagram.SetHostName(host);
+    datagram.SetNCPUs(1 << GetSkewedIndex(6));
+    datagram.SetNumOfHostCPUs(64);
+    datagram.SetNGPUs(0);
+    datagram.SetNumOfHostGPUs(0);
+    datagram.SetNumOfNodes(1);
+    datagram.SetFlags(0);
+
+    CSmallTimeAndDate dt;
+    dt.GetActualTimeAndDate();
+    datagram.SetTimeAndDate(dt);
+
+    datagram.Finish();
+}
+
+//------------------------------------------------------------------------------
+
+int CStatBench::GetSkewedIndex(int n)
+{
+    // cubic skew - about half of the records use the first 12 % of items
+    double r = (double)rand_r(&Seed)/((double)RAND_MAX + 1.0);
+    int index = (int)(n*r*r*r);
+    if( index >= n ) index = n - 1;
+    return(index);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatBench::GetUDPCounters(long int& received,long int& rcvbuf_errors)
+{
+    FILE* p_fin = fopen("/proc/net/snmp","r");
+    if( p_fin == NULL ) return(false);
+
+    // the Udp: header line is followed by the Udp: value line
+    char header[1024];
+    char values[1024];
+    bool found = false;
+
+    while( fgets(header,sizeof(header),p_fin) != NULL ) {
+        if( strncmp(header,"Udp:",4) != 0 ) continue;
+        if( fgets(values,sizeof(values),p_fin) == NULL ) break;
+        found = true;
+        break;
+    }
+    fclose(p_fin);
+
+    if( found == false ) return(false);
+
+    char* p_hsave = NULL;
+    char* p_vsave = NULL;
+    char* p_name = strtok_r(header," \n",&p_hsave);
+    char* p_value = strtok_r(values," \n",&p_vsave);
+
+    while( (p_name != NULL) && (p_value != NULL) ) {
+        if( strcmp(p_name,"InDatagrams") == 0 ) received = atol(p_value);
+        if( strcmp(p_name,"RcvbufErrors") == 0 ) rcvbuf_errors = atol(p_value);
+        p_name = strtok_r(NULL," \n",&p_hsave);
+        p_value = strtok_r(NULL," \n",&p_vsave);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatBench::PrintResults(long int elapsed,long int received,long int rcvbuf_errors)
+{
+    long int sent = NumOfSent;
+    long int committed = Poller.GetNumOfCommitted();
+
+    vout << endl;
+    vout << "Sent datagrams      : " << sent << endl;
+    vout << "Send errors         : " << NumOfSendErrors << endl;
+    if( elapsed > 0 ) {
+        vout << "Send rate           : " << (double)sent*1000000.0/elapsed << " datagrams/s" << endl;
+    }
+    if( received >= 0 ) {
+        // system-wide counters, they include other UDP traffic
+        vout << "Received (kernel)   : " << received << endl;
+        vout << "Socket buffer drops : " << rcvbuf_errors << endl;
+    }
+    vout << "Committed datagrams : " << committed << endl;
+    if( sent > 0 ) {
+        vout << "Loss                : " << (double)(sent - committed)*100.0/sent << " %" << endl;
+    }
+
+    // latency percentiles
+    std::vector<long int> latencies;
+    for(long int i=0; i < committed; i++) {
+        if( Latencies[i] >= 0 ) latencies.push_back(Latencies[i]);
+    }
+    if( latencies.empty() ) return;
+
+    sort(latencies.begin(),latencies.end());
+    size_t n = latencies.size();
+
+    vout << "Commit latency p50  : " << latencies[n*50/100]/1000.0 << " ms" << endl;
+    vout << "Commit latency p90  : " << latencies[n*90/100]/1000.0 << " ms" << endl;
+    vout << "Commit latency p99  : " << latencies[n*99/100]/1000.0 << " ms" << endl;
+    vout << "Commit latency max  : " << latencies[n-1]/1000.0 << " ms" << endl;
+    vout << "Latency resolution  : " << POLLER_IDLE_TIME/1000 << " ms" << endl;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+long int CStatBench::GetNumOfSent(void)
+{
+    return(NumOfSent);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatBench::SetCommitted(long int index,long int time)
+{
+    Latencies[index] = time - SendTimes[index];
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatBench::GetTimeInUS(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return(ts.tv_sec*1000000 + ts.tv_nsec/1000);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
@@ -0,0 +1,144 @@
+#ifndef StatBenchH
+#define StatBenchH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <AMSMainHeader.hpp>
+#include <VerboseStr.hpp>
+#include <TerminalStr.hpp>
+#include <SoftStat.hpp>
+#include <SmallThread.hpp>
+#include "StatBenchOptions.hpp"
+#include "StatStorage.hpp"
+#include <boost/atomic.hpp>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class CStatBench;
+
+/// watches the number of committed datagrams and records commit latency
+
+class CStatBenchPoller : public CSmallThread {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatBenchPoller(CStatBench* p_bench);
+    ~CStatBenchPoller(void);
+
+// setup methods ---------------------------------------------------------------
+    //! open storage session and prepare statements
+    bool InitPoller(CStatStorage* p_storage,const CSmallString& site);
+
+    //! request poller termination
+    void ShutdownPoller(void);
+
+    //! release storage session, the thread must not run
+    void ClosePoller(void);
+
+// information methods ---------------------------------------------------------
+    //! number of committed datagrams
+    long int GetNumOfCommitted(void);
+
+// section of private data -----------------------------------------------------
+private:
+    CStatBench*             Bench;
+    volatile bool           Terminated;
+    CStatStorageSession*    Session;
+    CSmallString            Site;
+    boost::atomic<long int> NumOfCommitted;
+
+    //! poller loop
+    virtual void ExecuteThread(void);
+
+};
+
+//------------------------------------------------------------------------------
+
+/// ingest benchmark of ams-isoftstat
+
+class CStatBench {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatBench(void);
+    ~CStatBench(void);
+
+// main methods ----------------------------------------------------------------
+    /// init options
+    int Init(int argc,char* argv[]);
+
+    /// main part of program
+    bool Run(void);
+
+    /// finalize
+    void Finalize(void);
+
+// information methods ---------------------------------------------------------
+    //! number of datagrams sent so far
+    long int GetNumOfSent(void);
+
+    //! record commit of datagram index (poller thread)
+    void SetCommitted(long int index,long int time);
+
+    //! get monotonic time in us
+    static long int GetTimeInUS(void);
+
+// section of private data -----------------------------------------------------
+private:
+    CStatBenchOptions       Options;
+    CTerminalStr            Console;
+    CVerboseStr             vout;
+    CStatStorage*           Storage;
+    CStatBenchPoller        Poller;
+    CSmallString            Site;
+    int                     Socket;
+    unsigned int            Seed;
+
+    // send and commit times (us)
+    std::vector<long int>   SendTimes;
+    std::vector<long int>   Latencies;
+    boost::atomic<long int> NumOfSent;
+    long int                NumOfSendErrors;
+
+    //! open socket connected to the server
+    bool OpenSocket(void);
+
+    //! send all datagrams
+    void SendDatagrams(void);
+
+    //! send all records in v2 packets
+    void SendPackets(void);
+
+    //! forge datagram with realistic key mix
+    void ForgeDatagram(CAddStatDatagram& datagram);
+
+    //! random index skewed towards low values (popular items)
+    int GetSkewedIndex(int n);
+
+    //! read UDP counters from /proc/net/snmp
+    static bool GetUDPCounters(long int& received,long int& rcvbuf_errors);
+
+    //! print results
+    void PrintResults(long int elapsed,long int received,long int rcvbuf_errors);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
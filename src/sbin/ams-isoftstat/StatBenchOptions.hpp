@@ -0,0 +1,220 @@
+#ifndef StatBenchOptionsH
+#define StatBenchOptionsH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <SimpleOptions.hpp>
+
+//------------------------------------------------------------------------------
+
+class CStatBenchOptions : public CSimpleOptions {
+public:
+    // constructor - tune option setup
+    CStatBenchOptions(void);
+
+    // program name and description -----------------------------------------------
+    CSO_PROG_NAME_BEGIN
+    "ams-isoftstat-bench"
+    CSO_PROG_NAME_END
+
+    CSO_PROG_DESC_BEGIN
+    "It sends forged module-add-stat datagrams to ams-isoftstat and measures how many of them are committed "
+    "to the database and how long it takes. Use it only with a disposable database."
+    CSO_PROG_DESC_END
+
+    // list of all options and arguments ------------------------------------------
+    CSO_LIST_BEGIN
+    // options ------------------------------
+    CSO_OPT(CSmallString,Server)
+    CSO_OPT(int,Port)
+    CSO_OPT(int,Count)
+    CSO_OPT(int,Rate)
+    CSO_OPT(int,Records)
+    CSO_OPT(int,Modules)
+    CSO_OPT(int,Users)
+    CSO_OPT(int,Hosts)
+    CSO_OPT(CSmallString,Backend)
+    CSO_OPT(CSmallString,Database)
+    CSO_OPT(CSmallString,User)
+    CSO_OPT(CSmallString,Password)
+    CSO_OPT(int,Wait)
+    CSO_OPT(bool,Help)
+    CSO_OPT(bool,Version)
+    CSO_OPT(bool,Verbose)
+    CSO_LIST_END
+
+    CSO_MAP_BEGIN
+    // description of options --------------------------------------------------
+    CSO_MAP_OPT(CSmallString,                   /* option type */
+                Server,                         /* option name */
+                "localhost",                    /* default value */
+                false,                          /* is option mandatory */
+                's',                           /* short option name */
+                "server",                       /* long option name */
+                "NAME",                         /* parametr name */
+                "name of host running ams-isoftstat")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(int,                            /* option type */
+                Port,                           /* option name */
+                32597,                          /* default value */
+                false,                          /* is option mandatory */
+                'p',                           /* short option name */
+                "port",                         /* long option name */
+                "NUMBER",                       /* parametr name */
+                "port ams-isoftstat listens on")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(int,                            /* option type */
+                Count,                          /* option name */
+                100000,                         /* default value */
+                false,                          /* is option mandatory */
+                'n',                           /* short option name */
+                "count",                        /* long option name */
+                "NUMBER",                       /* parametr name */
+                "number of datagrams to send")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(int,                            /* option type */
+                Rate,                           /* option name */
+                0,                              /* default value */
+                false,                          /* is option mandatory */
+                'r',                           /* short option name */
+                "rate",                         /* long option name */
+                "NUMBER",                       /* parametr name */
+                "datagrams per second, 0 means maximum rate")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(int,                            /* option type */
+                Records,                        /* option name */
+                1,                              /* default value */
+                false,                          /* is option mandatory */
+                'k',                           /* short option name */
+                "records",                      /* long option name */
+                "NUMBER",                       /* parametr name */
+                "records per datagram, more than one sends v2 multi-record packets")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(int,                            /* option type */
+                Modules,                        /* option name */
+                200,                            /* default value */
+                false,                          /* is option mandatory */
+                'm',                           /* short option name */
+                "modules",                      /* long option name */
+                "NUMBER",                       /* parametr name */
+                "number of distinct modules")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(int,                            /* option type */
+                Users,                          /* option name */
+                500,                            /* default value */
+                false,                          /* is option mandatory */
+                '\0',                           /* short option name */
+                "users",                        /* long option name */
+                "NUMBER",                       /* parametr name */
+                "number of distinct users")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(int,                            /* option type */
+                Hosts,                          /* option name */
+                100,                            /* default value */
+                false,                          /* is option mandatory */
+                '\0',                           /* short option name */
+                "hosts",                        /* long option name */
+                "NUMBER",                       /* parametr name */
+                "number of distinct hosts")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(CSmallString,                   /* option type */
+                Backend,                        /* option name */
+                "firebird",                     /* default value */
+                false,                          /* is option mandatory */
+                'b',                           /* short option name */
+                "backend",                      /* long option name */
+                "NAME",                         /* parametr name */
+                "storage backend of ams-isoftstat (firebird or sqlite)")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(CSmallString,                   /* option type */
+                Database,                       /* option name */
+                "localhost:ams_stat_bench.fdb", /* default value */
+                false,                          /* is option mandatory */
+                'd',                           /* short option name */
+                "database",                     /* long option name */
+                "NAME",                         /* parametr name */
+                "disposable database written by ams-isoftstat, a file name for sqlite")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(CSmallString,                   /* option type */
+                User,                           /* option name */
+                "ams",                          /* default value */
+                false,                          /* is option mandatory */
+                'u',                           /* short option name */
+                "user",                         /* long option name */
+                "NAME",                         /* parametr name */
+                "database user")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(CSmallString,                   /* option type */
+                Password,                       /* option name */
+                "",                             /* default value */
+                false,                          /* is option mandatory */
+                'w',                           /* short option name */
+                "password",                     /* long option name */
+                "PASSWORD",                     /* parametr name */
+                "database password")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(int,                            /* option type */
+                Wait,                           /* option name */
+                30,                             /* default value */
+                false,                          /* is option mandatory */
+                't',                           /* short option name */
+                "wait",                         /* long option name */
+                "SECONDS",                      /* parametr name */
+                "how long to wait for commits after the last datagram was sent")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(bool,                           /* option type */
+                Verbose,                        /* option name */
+                false,                          /* default value */
+                false,                          /* is option mandatory */
+                'v',                           /* short option name */
+                "verbose",                      /* long option name */
+                NULL,                           /* parametr name */
+                "increase output verbosity")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(bool,                           /* option type */
+                Version,                        /* option name */
+                false,                          /* default value */
+                false,                          /* is option mandatory */
+                '\0',                           /* short option name */
+                "version",                      /* long option name */
+                NULL,                           /* parametr name */
+                "output version information and exit")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(bool,                           /* option type */
+                Help,                        /* option name */
+                false,                          /* default value */
+                false,                          /* is option mandatory */
+                'h',                           /* short option name */
+                "help",                      /* long option name */
+                NULL,                           /* parametr name */
+                "display this help and exit")   /* option description */
+    CSO_MAP_END
+
+    // final operation with options ------------------------------------------------
+private:
+    virtual int CheckOptions(void);
+    virtual int FinalizeOptions(void);
+    virtual int CheckArguments(void);
+};
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,287 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include "StatClientACL.hpp"
+#include <ErrorSystem.hpp>
+#include <XMLIterator.hpp>
+#include <fnmatch.h>
+#include <string.h>
+#include <stdlib.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatClientACL::CStatClientACL(void)
+{
+    Enabled = false;
+    NumOfDefaultDenied = 0;
+}
+
+//------------------------------------------------------------------------------
+
+CStatClientACL::~CStatClientACL(void)
+{
+    Clear();
+}
+
+//------------------------------------------------------------------------------
+
+void CStatClientACL::Clear(void)
+{
+    for(size_t i=0; i < Rules.size(); i++) {
+        delete Rules[i];
+    }
+    Rules.clear();
+    AddressRules.clear();
+    PatternRules.clear();
+    ExactRules.clear();
+    Enabled = false;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatClientACL::Compile(CXMLElement* p_clients)
+{
+    Clear();
+
+    if( p_clients == NULL ) {
+        // no clients -> everything is allowed
+        return(true);
+    }
+    Enabled = true;
+
+    CXMLIterator I(p_clients);
+    CXMLElement* p_cele;
+
+    while((p_cele = I.GetNextChildElement("client")) != NULL ) {
+        SRule* p_rule = new SRule;
+        p_rule->Allow = true;
+        p_rule->Family = 0;
+        p_rule->Prefix = 0;
+        memset(p_rule->Addr,0,sizeof(p_rule->Addr));
+        p_rule->NumOfMatches = 0;
+
+        CSmallString action;
+        if( p_cele->GetAttribute("action",action) == true ) {
+            if( action == "deny" ) {
+                p_rule->Allow = false;
+            } else if( action != "allow" ) {
+                CSmallString error;
+                error << "unsupported client action '" << action << "'";
+                ES_ERROR(error);
+                delete p_rule;
+                return(false);
+            }
+        }
+
+        CSmallString mask;
+        CSmallString cidr;
+
+        if( p_cele->GetAttribute("cidr",cidr) == true ) {
+            if( ParseCIDR(cidr,p_rule) == false ) {
+                CSmallString error;
+                error << "unable to parse client cidr '" << cidr << "'";
+                ES_ERROR(error);
+                delete p_rule;
+                return(false);
+            }
+            p_rule->Text << "cidr=" << cidr;
+            AddressRules.push_back(Rules.size());
+        } else if( p_cele->GetAttribute("name",mask) == true ) {
+            p_rule->Text << "name=" << mask;
+            p_rule->Name = mask;
+            if( strpbrk(mask,"*?[") != NULL ) {
+                PatternRules.push_back(Rules.size());
+            } else {
+                // the first rule wins for duplicates
+                ExactRules.insert(make_pair(string(mask.GetBuffer()),(int)Rules.size()));
+            }
+        } else {
+            ES_ERROR("client element without name or cidr attribute");
+            delete p_rule;
+            return(false);
+        }
+
+        if( p_rule->Allow == false ) p_rule->Text << " (deny)";
+        Rules.push_back(p_rule);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatClientACL::ParseCIDR(const CSmallString& cidr,SRule* p_rule)
+{
+    string  text(cidr.GetBuffer());
+    string  addr = text;
+    int     prefix = -1;
+
+    size_t slash = text.find('/');
+    if( slash != string::npos ) {
+        addr = text.substr(0,slash);
+        char* p_end = NULL;
+        prefix = strtol(text.c_str() + slash + 1,&p_end,10);
+        if( (p_end == NULL) || (*p_end != '\0') || (prefix < 0) ) return(false);
+    }
+
+    if( inet_pton(AF_INET,addr.c_str(),p_rule->Addr) == 1 ) {
+        p_rule->Family = AF_INET;
+        if( prefix < 0 ) prefix = 32;
+        if( prefix > 32 ) return(false);
+    } else if( inet_pton(AF_INET6,addr.c_str(),p_rule->Addr) == 1 ) {
+        p_rule->Family = AF_INET6;
+        if( prefix < 0 ) prefix = 128;
+        if( prefix > 128 ) return(false);
+    } else {
+        return(false);
+    }
+
+    p_rule->Prefix = prefix;
+    return(true);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatClientACL::IsEnabled(void) const
+{
+    return(Enabled);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatClientACL::HasNameRules(void) const
+{
+    return( (ExactRules.empty() == false) || (PatternRules.empty() == false) );
+}
+
+//------------------------------------------------------------------------------
+
+int CStatClientACL::MatchAddress(const struct sockaddr* p_addr) const
+{
+    if( AddressRules.empty() ) return(ACL_NO_MATCH);
+
+    int                     family = p_addr->sa_family;
+    const unsigned char*    p_bytes = NULL;
+
+    if( family == AF_INET ) {
+        p_bytes = (const unsigned char*)&((const struct sockaddr_in*)p_addr)->sin_addr;
+    } else if( family == AF_INET6 ) {
+        const struct in6_addr* p_in6 = &((const struct sockaddr_in6*)p_addr)->sin6_addr;
+        p_bytes = (const unsigned char*)p_in6;
+        // IPv4 client on dual-stack socket
+        if( IN6_IS_ADDR_V4MAPPED(p_in6) ) {
+            family = AF_INET;
+            p_bytes += 12;
+        }
+    } else {
+        return(ACL_NO_MATCH);
+    }
+
+    int allow = ACL_NO_MATCH;
+    for(size_t i=0; i < AddressRules.size(); i++) {
+        const SRule* p_rule = Rules[AddressRules[i]];
+        if( MatchCIDR(p_rule,family,p_bytes) == false ) continue;
+        if( p_rule->Allow == false ) return(AddressRules[i]);
+        if( allow == ACL_NO_MATCH ) allow = AddressRules[i];
+    }
+
+    return(allow);
+}
+
+//------------------------------------------------------------------------------
+
+int CStatClientACL::MatchName(const char* p_name) const
+{
+    int allow = ACL_NO_MATCH;
+
+    boost::unordered_map<string,int>::const_iterator it = ExactRules.find(string(p_name));
+    if( it != ExactRules.end() ) {
+        if( Rules[it->second]->Allow == false ) return(it->second);
+        allow = it->second;
+    }
+
+    for(size_t i=0; i < PatternRules.size(); i++) {
+        const SRule* p_rule = Rules[PatternRules[i]];
+        if( fnmatch(p_rule->Name,p_name,0) != 0 ) continue;
+        if( p_rule->Allow == false ) return(PatternRules[i]);
+        if( allow == ACL_NO_MATCH ) allow = PatternRules[i];
+    }
+
+    return(allow);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatClientACL::MatchCIDR(const SRule* p_rule,int family,const unsigned char* p_addr)
+{
+    if( p_rule->Family != family ) return(false);
+
+    int full = p_rule->Prefix / 8;
+    int rest = p_rule->Prefix % 8;
+
+    if( memcmp(p_rule->Addr,p_addr,full) != 0 ) return(false);
+    if( rest == 0 ) return(true);
+
+    unsigned char mask = (unsigned char)(0xFF << (8 - rest));
+    return( (p_rule->Addr[full] & mask) == (p_addr[full] & mask) );
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatClientACL::Decide(int rule)
+{
+    if( rule == ACL_NO_MATCH ) {
+        NumOfDefaultDenied.fetch_add(1,boost::memory_order_relaxed);
+        return(false);
+    }
+    Rules[rule]->NumOfMatches.fetch_add(1,boost::memory_order_relaxed);
+    return(Rules[rule]->Allow);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatClientACL::PrintStatistics(CVerboseStr& vout)
+{
+    if( Enabled == false ) return;
+
+    for(size_t i=0; i < Rules.size(); i++) {
+        vout << "Client rule #" << i+1 << "      : " << Rules[i]->NumOfMatches.load()
+             << " " << (Rules[i]->Allow ? "allowed" : "denied")
+             << " [" << Rules[i]->Text << "]" << endl;
+    }
+    vout << "Client default deny : " << NumOfDefaultDenied.load() << endl;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
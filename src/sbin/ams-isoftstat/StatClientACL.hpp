@@ -0,0 +1,115 @@
+#ifndef StatClientACLH
+#define StatClientACLH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <SmallString.hpp>
+#include <XMLElement.hpp>
+#include <VerboseStr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/atomic.hpp>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+//------------------------------------------------------------------------------
+
+// no rule matched
+#define ACL_NO_MATCH    -1
+
+//------------------------------------------------------------------------------
+
+/// client access list compiled from the config/clients element
+/*!
+    <client name="host"/>           - exact host name (hash set)
+    <client name="*.domain"/>       - glob pattern (fnmatch)
+    <client cidr="10.0.0.0/8"/>     - numeric address, IPv4 or IPv6, no DNS
+    action="deny"                   - deny instead of allow
+
+    address rules are tried first, name rules are used only if no address
+    rule matched; deny rules take precedence over allow rules of the same
+    kind; the client is denied if no rule matched
+*/
+
+class CStatClientACL {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatClientACL(void);
+    ~CStatClientACL(void);
+
+// setup methods ---------------------------------------------------------------
+    //! compile rules from the clients element (NULL - everything is allowed)
+    bool Compile(CXMLElement* p_clients);
+
+// executive methods -----------------------------------------------------------
+    //! is the access list in use?
+    bool IsEnabled(void) const;
+
+    //! are there rules that need client name?
+    bool HasNameRules(void) const;
+
+    //! find rule matching the numeric peer address
+    int MatchAddress(const struct sockaddr* p_addr) const;
+
+    //! find rule matching the peer name
+    int MatchName(const char* p_name) const;
+
+    //! count decision of the rule, return true if the client is allowed
+    bool Decide(int rule);
+
+// information methods ---------------------------------------------------------
+    //! print rules with their counters
+    void PrintStatistics(CVerboseStr& vout);
+
+// section of private data -----------------------------------------------------
+private:
+    struct SRule {
+        CSmallString                Text;       // rule as in config
+        bool                        Allow;
+        // name rule
+        CSmallString                Name;
+        // cidr rule
+        int                         Family;
+        unsigned char               Addr[16];
+        int                         Prefix;
+        boost::atomic<long int>     NumOfMatches;
+    };
+
+    bool                                        Enabled;
+    std::vector<SRule*>                         Rules;
+    std::vector<int>                            AddressRules;
+    std::vector<int>                            PatternRules;
+    boost::unordered_map<std::string,int>       ExactRules;
+    boost::atomic<long int>                     NumOfDefaultDenied;
+
+    //! parse cidr rule
+    bool ParseCIDR(const CSmallString& cidr,SRule* p_rule);
+
+    //! does the address match the cidr rule?
+    static bool MatchCIDR(const SRule* p_rule,int family,const unsigned char* p_addr);
+
+    //! remove all rules
+    void Clear(void);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
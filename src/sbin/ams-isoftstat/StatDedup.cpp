@@ -0,0 +1,189 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include "StatDedup.hpp"
+#include "AMSStatServer.hpp"
+#include <string.h>
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+
+// words of one block (one cache line)
+#define DEDUP_BLOCK_WORDS 8
+
+// bits set per hash, 9 bits address one bit of the block
+#define DEDUP_NUM_OF_BITS 6
+
+// multiplier of MurmurHash64A
+#define DEDUP_HASH_M 0xc6a4a7935bd1e995ULL
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatDedup::CStatDedup(void)
+{
+    Window = 0;
+    NumOfBlocks = 0;
+    Current = 0;
+    RotationTime = 0;
+    NumOfRotations = 0;
+    NumOfInserted = 0;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatDedup::SetFilter(int window,size_t memory)
+{
+    if( window < 1 ) window = 1;
+    Window = window*1000;
+
+    NumOfBlocks = memory / (2*DEDUP_BLOCK_WORDS*sizeof(uint64_t));
+    if( NumOfBlocks < 1 ) NumOfBlocks = 1;
+
+    for(int i=0; i < 2; i++) {
+        Generations[i].assign(NumOfBlocks*DEDUP_BLOCK_WORDS,0);
+    }
+    Current = 0;
+    RotationTime = CAMSStatServer::GetTimeInMS();
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatDedup::IsDuplicate(const void* p_data,size_t size)
+{
+    // hash and bit mask are prepared outside of the lock
+    uint64_t h = HashData(p_data,size);
+    size_t   block = h % NumOfBlocks;
+    uint64_t bits = Mix(h ^ DEDUP_HASH_M);
+    uint64_t mask[DEDUP_BLOCK_WORDS];
+
+    memset(mask,0,sizeof(mask));
+    for(int i=0; i < DEDUP_NUM_OF_BITS; i++) {
+        int pos = bits & 511;
+        bits >>= 9;
+        mask[pos >> 6] |= 1ULL << (pos & 63);
+    }
+
+    Mutex.Lock();
+
+    // rotate generations, both are stale after two windows
+    long int now = CAMSStatServer::GetTimeInMS();
+    if( now - RotationTime >= Window ) {
+        if( now - RotationTime >= 2*Window ) {
+            std::fill(Generations[Current].begin(),Generations[Current].end(),0);
+        }
+        Current ^= 1;
+        std::fill(Generations[Current].begin(),Generations[Current].end(),0);
+        RotationTime = now;
+        NumOfRotations++;
+        NumOfInserted = 0;
+    }
+
+    uint64_t* p_cur = &Generations[Current][block*DEDUP_BLOCK_WORDS];
+    uint64_t* p_old = &Generations[Current^1][block*DEDUP_BLOCK_WORDS];
+    bool      in_cur = true;
+    bool      in_old = true;
+
+    for(int i=0; i < DEDUP_BLOCK_WORDS; i++) {
+        if( (p_cur[i] & mask[i]) != mask[i] ) in_cur = false;
+        if( (p_old[i] & mask[i]) != mask[i] ) in_old = false;
+        // repeated retransmissions stay in the current generation
+        p_cur[i] |= mask[i];
+    }
+    if( in_cur == false ) NumOfInserted++;
+
+    Mutex.Unlock();
+
+    return(in_cur || in_old);
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t CStatDedup::HashData(const void* p_data,size_t size)
+{
+    // MurmurHash64A
+    const unsigned char*    p_bytes = (const unsigned char*)p_data;
+    uint64_t                h = 0x9e3779b97f4a7c15ULL ^ (size * DEDUP_HASH_M);
+    size_t                  i = 0;
+
+    for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t k;
+        memcpy(&k,p_bytes + i,sizeof(k));
+        k *= DEDUP_HASH_M;
+        k ^= k >> 47;
+        k *= DEDUP_HASH_M;
+        h ^= k;
+        h *= DEDUP_HASH_M;
+    }
+
+    if( i < size ) {
+        uint64_t k = 0;
+        memcpy(&k,p_bytes + i,size - i);
+        h ^= k;
+        h *= DEDUP_HASH_M;
+    }
+
+    return(Mix(h));
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t CStatDedup::Mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return(h);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+size_t CStatDedup::GetMemoryUsage(void) const
+{
+    return(2*NumOfBlocks*DEDUP_BLOCK_WORDS*sizeof(uint64_t));
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatDedup::GetNumOfRotations(void) const
+{
+    return(NumOfRotations);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatDedup::GetNumOfInserted(void) const
+{
+    return(NumOfInserted);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
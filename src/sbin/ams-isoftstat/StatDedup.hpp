@@ -0,0 +1,83 @@
+#ifndef StatDedupH
+#define StatDedupH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <SimpleMutex.hpp>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+//------------------------------------------------------------------------------
+
+/// recently seen datagrams - rotating Bloom filter with fixed memory
+/*! the filter has two generations of equal size, hashes are inserted into
+    the current one and looked up in both, the older generation is cleared
+    and becomes the current one every window seconds, thus duplicates are
+    found at least window seconds (and at most twice as long) back,
+    all bits of one hash lie in one cache line, false positives (dropped
+    unique datagrams) grow with the number of datagrams per window
+*/
+
+class CStatDedup {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatDedup(void);
+
+// setup methods ---------------------------------------------------------------
+    //! set window (s) and memory used by both generations (bytes)
+    void SetFilter(int window,size_t memory);
+
+// executive methods -----------------------------------------------------------
+    //! was the payload seen within the window? it is remembered (receiver threads)
+    bool IsDuplicate(const void* p_data,size_t size);
+
+// information methods ---------------------------------------------------------
+    //! memory used by the filter in bytes
+    size_t GetMemoryUsage(void) const;
+
+    //! number of generation rotations
+    long int GetNumOfRotations(void) const;
+
+    //! number of hashes inserted into the current generation
+    long int GetNumOfInserted(void) const;
+
+// section of private data -----------------------------------------------------
+private:
+    CSimpleMutex            Mutex;
+    int                     Window;         // ms
+    size_t                  NumOfBlocks;    // per generation
+    std::vector<uint64_t>   Generations[2];
+    int                     Current;
+    long int                RotationTime;   // ms
+    long int                NumOfRotations;
+    long int                NumOfInserted;
+
+    //! hash payload
+    static uint64_t HashData(const void* p_data,size_t size);
+
+    //! final mix of 64-bit hash
+    static uint64_t Mix(uint64_t h);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,317 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include "StatErrorLog.hpp"
+#include <SmallTimeAndDate.hpp>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+//------------------------------------------------------------------------------
+
+// number of distinct errors kept by default
+#define ERROR_LOG_RING_SIZE 64
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+static const char* ErrorNames[STAT_ERROR_NUM_OF_CLASSES] = {
+    "bad_checksum",
+    "bad_packet",
+    "unauthorized",
+    "stream_unauthorized",
+    "bad_batch",
+    "db_write",
+    "db_unavailable",
+    "relay",
+    "dns",
+    "key",
+    "rollup"
+};
+
+static const char* ErrorDescriptions[STAT_ERROR_NUM_OF_CLASSES] = {
+    "datagram is not valid (checksum error)",
+    "packet is not valid (malformed or checksum error)",
+    "client is not authorized",
+    "stream client is not authorized",
+    "batch is not valid (malformed packet or checksum error)",
+    "database transaction was rolled back",
+    "database is not available",
+    "unable to forward batch to the upstream",
+    "unable to resolve client hostname",
+    "unable to create key",
+    "unable to flush rollup counters"
+};
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatErrorLog::CStatErrorLog(void)
+{
+    Head = 0;
+    NumOfEntries = 0;
+    for(int i=0; i < STAT_ERROR_NUM_OF_CLASSES; i++) {
+        NumOfErrors[i] = 0;
+        NumOfPending[i] = 0;
+        LastEntry[i] = 0;
+    }
+    LastFlush = time(NULL);
+    BucketMask = 0;
+    ResetRing(ERROR_LOG_RING_SIZE);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatErrorLog::SetRingSize(size_t size)
+{
+    if( size < 1 ) size = 1;
+
+    Mutex.Lock();
+    ResetRing(size);
+    Mutex.Unlock();
+}
+
+//------------------------------------------------------------------------------
+
+void CStatErrorLog::ResetRing(size_t size)
+{
+    Ring.resize(size);
+    Head = 0;
+    NumOfEntries = 0;
+
+    // at least two buckets per entry, chains stay short
+    size_t nbuckets = 1;
+    while( nbuckets < 2*size ) nbuckets <<= 1;
+    Buckets.assign(nbuckets,-1);
+    BucketMask = nbuckets - 1;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatErrorLog::Report(EStatError error,const struct sockaddr* p_peer,socklen_t peer_len)
+{
+    NumOfErrors[error]++;
+
+    if( (p_peer == NULL) || (peer_len > sizeof(struct sockaddr_storage)) ) peer_len = 0;
+    long int now = time(NULL);
+    size_t   hash = GetHash(error,p_peer,peer_len);
+
+    Mutex.Lock();
+
+    NumOfPending[error]++;
+
+    // repeated error only updates its entry
+    for(int i = Buckets[hash & BucketMask]; i >= 0; i = Ring[i].Next) {
+        SEntry& entry = Ring[i];
+        if( (entry.Hash != hash) || (entry.Class != error) ) continue;
+        if( (entry.PeerLen == 0) != (peer_len == 0) ) continue;
+        if( (peer_len > 0) && (IsSameAddress((struct sockaddr*)&entry.Peer,p_peer) == false) ) continue;
+        entry.Count++;
+        entry.Last = now;
+        LastEntry[error] = i;
+        Mutex.Unlock();
+        return;
+    }
+
+    // new error replaces the oldest one, which leaves its bucket
+    SEntry& entry = Ring[Head];
+    if( NumOfEntries == Ring.size() ) {
+        int* p_link = &Buckets[entry.Hash & BucketMask];
+        while( *p_link != (int)Head ) p_link = &Ring[*p_link].Next;
+        *p_link = entry.Next;
+    }
+
+    entry.Class = error;
+    entry.PeerLen = peer_len;
+    if( peer_len > 0 ) memcpy(&entry.Peer,p_peer,peer_len);
+    entry.First = now;
+    entry.Last = now;
+    entry.Count = 1;
+    entry.Hash = hash;
+    entry.Next = Buckets[hash & BucketMask];
+    Buckets[hash & BucketMask] = Head;
+    LastEntry[error] = Head;
+
+    Head = (Head + 1) % Ring.size();
+    if( NumOfEntries < Ring.size() ) NumOfEntries++;
+
+    Mutex.Unlock();
+}
+
+//------------------------------------------------------------------------------
+
+void CStatErrorLog::Flush(CVerboseStr& vout)
+{
+    long int    pending[STAT_ERROR_NUM_OF_CLASSES];
+    SEntry      last[STAT_ERROR_NUM_OF_CLASSES];
+    long int    now = time(NULL);
+
+    // formatting is done outside of the lock
+    Mutex.Lock();
+    for(int i=0; i < STAT_ERROR_NUM_OF_CLASSES; i++) {
+        pending[i] = NumOfPending[i];
+        NumOfPending[i] = 0;
+        last[i].PeerLen = 0;
+        if( (pending[i] > 0) && (LastEntry[i] < NumOfEntries) && (Ring[LastEntry[i]].Class == i) ) last[i] = Ring[LastEntry[i]];
+    }
+    long int interval = now - LastFlush;
+    LastFlush = now;
+    Mutex.Unlock();
+
+    CSmallTimeAndDate dt;
+    dt.GetActualTimeAndDate();
+
+    for(int i=0; i < STAT_ERROR_NUM_OF_CLASSES; i++) {
+        if( pending[i] == 0 ) continue;
+        vout << low;
+        vout << dt.GetSDateAndTime() << " " << ErrorDescriptions[i] << " : "
+             << pending[i] << " time(s) in " << interval << " s";
+        if( last[i].PeerLen > 0 ) {
+            vout << ", last from " << GetAddress(last[i]);
+        }
+        vout << endl;
+    }
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+long int CStatErrorLog::GetNumOfErrors(EStatError error) const
+{
+    return(NumOfErrors[error]);
+}
+
+//------------------------------------------------------------------------------
+
+const char* CStatErrorLog::GetName(EStatError error)
+{
+    return(ErrorNames[error]);
+}
+
+//------------------------------------------------------------------------------
+
+const char* CStatErrorLog::GetDescription(EStatError error)
+{
+    return(ErrorDescriptions[error]);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatErrorLog::PrintStatistics(CVerboseStr& vout)
+{
+    for(int i=0; i < STAT_ERROR_NUM_OF_CLASSES; i++) {
+        if( NumOfErrors[i] == 0 ) continue;
+        vout << "Errors              : " << NumOfErrors[i] << " [" << ErrorDescriptions[i] << "]" << endl;
+    }
+
+    Mutex.Lock();
+    std::vector<SEntry> entries;
+    entries.reserve(NumOfEntries);
+    // from the most recent one
+    for(size_t i=0; i < NumOfEntries; i++) {
+        entries.push_back(Ring[(Head + Ring.size() - 1 - i) % Ring.size()]);
+    }
+    Mutex.Unlock();
+
+    for(size_t i=0; i < entries.size(); i++) {
+        CSmallTimeAndDate first(entries[i].First);
+        CSmallTimeAndDate last(entries[i].Last);
+        vout << "Recent error #" << i+1 << "     : " << entries[i].Count << " x "
+             << ErrorDescriptions[entries[i].Class];
+        if( entries[i].PeerLen > 0 ) {
+            vout << " (" << GetAddress(entries[i]) << ")";
+        }
+        vout << " from " << first.GetSDateAndTime() << " to " << last.GetSDateAndTime() << endl;
+    }
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+size_t CStatErrorLog::GetHash(EStatError error,const struct sockaddr* p_peer,socklen_t peer_len)
+{
+    // FNV-1a over the class and the same address bytes as IsSameAddress
+    const unsigned char*    p_data = NULL;
+    size_t                  len = 0;
+
+    if( peer_len > 0 ) {
+        if( p_peer->sa_family == AF_INET ) {
+            p_data = (const unsigned char*)&((const struct sockaddr_in*)p_peer)->sin_addr;
+            len = sizeof(struct in_addr);
+        } else if( p_peer->sa_family == AF_INET6 ) {
+            p_data = (const unsigned char*)&((const struct sockaddr_in6*)p_peer)->sin6_addr;
+            len = sizeof(struct in6_addr);
+        }
+    }
+
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ (uint32_t)error) * 16777619u;
+    hash = (hash ^ (uint32_t)(peer_len > 0 ? p_peer->sa_family + 1 : 0)) * 16777619u;
+    for(size_t i=0; i < len; i++) {
+        hash = (hash ^ p_data[i]) * 16777619u;
+    }
+    return(hash);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatErrorLog::IsSameAddress(const struct sockaddr* p_left,const struct sockaddr* p_right)
+{
+    if( p_left->sa_family != p_right->sa_family ) return(false);
+
+    if( p_left->sa_family == AF_INET ) {
+        return( ((const struct sockaddr_in*)p_left)->sin_addr.s_addr ==
+                ((const struct sockaddr_in*)p_right)->sin_addr.s_addr );
+    }
+    if( p_left->sa_family == AF_INET6 ) {
+        return( memcmp(&((const struct sockaddr_in6*)p_left)->sin6_addr,
+                       &((const struct sockaddr_in6*)p_right)->sin6_addr,
+                       sizeof(struct in6_addr)) == 0 );
+    }
+
+    // other families are not told apart
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+const std::string CStatErrorLog::GetAddress(const SEntry& entry)
+{
+    char host[NI_MAXHOST];
+    memset(host,0,NI_MAXHOST);
+    getnameinfo((const struct sockaddr*)&entry.Peer,entry.PeerLen,host,NI_MAXHOST-1,NULL,0,NI_NUMERICHOST);
+    return(host);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
@@ -0,0 +1,130 @@
+#ifndef StatErrorLogH
+#define StatErrorLogH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include <SimpleMutex.hpp>
+#include <VerboseStr.hpp>
+#include <boost/atomic.hpp>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+//------------------------------------------------------------------------------
+
+/// classes of errors raised by the ingest loop
+enum EStatError {
+    STAT_ERROR_BAD_CHECKSUM = 0,        // v1 datagram with wrong checksum
+    STAT_ERROR_BAD_PACKET,              // malformed v2 packet
+    STAT_ERROR_UNAUTHORIZED,            // datagram from unauthorized client
+    STAT_ERROR_STREAM_UNAUTHORIZED,     // stream connection from unauthorized client
+    STAT_ERROR_BAD_BATCH,               // malformed stream batch
+    STAT_ERROR_DB_WRITE,                // transaction rolled back by the database
+    STAT_ERROR_DB_UNAVAILABLE,          // transaction could not be started
+    STAT_ERROR_RELAY,                   // batch not forwarded to the upstream
+    STAT_ERROR_DNS,                     // reverse lookup of client address failed
+    STAT_ERROR_KEY,                     // key not found or created in the database
+    STAT_ERROR_ROLLUP,                  // rollup counters not flushed
+    STAT_ERROR_NUM_OF_CLASSES
+};
+
+//------------------------------------------------------------------------------
+
+/// bounded log of ingest errors
+/*! errors are counted per class, the most recent distinct errors (class and
+    peer address) are kept in a fixed ring with their counts and they are
+    found by a hash index over the ring, nothing is formatted when an error
+    is reported, pending errors are written to the log at most once per
+    flush interval as one line per class
+*/
+
+class CStatErrorLog {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatErrorLog(void);
+
+// setup methods ---------------------------------------------------------------
+    //! set number of distinct errors kept in the ring
+    void SetRingSize(size_t size);
+
+// executive methods -----------------------------------------------------------
+    //! record error, the peer address is optional (any thread)
+    void Report(EStatError error,const struct sockaddr* p_peer=NULL,socklen_t peer_len=0);
+
+    //! write errors reported since the last flush to the log (main thread)
+    void Flush(CVerboseStr& vout);
+
+// information methods ---------------------------------------------------------
+    //! number of errors of given class
+    long int GetNumOfErrors(EStatError error) const;
+
+    //! name of error class used in metrics
+    static const char* GetName(EStatError error);
+
+    //! description of error class
+    static const char* GetDescription(EStatError error);
+
+    //! print totals and the ring
+    void PrintStatistics(CVerboseStr& vout);
+
+// section of private data -----------------------------------------------------
+private:
+    struct SEntry {
+        int                     Class;
+        struct sockaddr_storage Peer;
+        socklen_t               PeerLen;
+        long int                First;      // s
+        long int                Last;       // s
+        long int                Count;
+        size_t                  Hash;       // of class and address
+        int                     Next;       // next entry in the bucket, -1 = none
+    };
+
+    CSimpleMutex                Mutex;
+    std::vector<SEntry>         Ring;
+    size_t                      Head;       // next entry to be overwritten
+    size_t                      NumOfEntries;
+    std::vector<int>            Buckets;    // first entry in the bucket, -1 = none
+    size_t                      BucketMask;
+
+    // per class
+    boost::atomic<long int>     NumOfErrors[STAT_ERROR_NUM_OF_CLASSES];
+    long int                    NumOfPending[STAT_ERROR_NUM_OF_CLASSES];
+    size_t                      LastEntry[STAT_ERROR_NUM_OF_CLASSES];
+    long int                    LastFlush;  // s
+
+    //! clear the ring and its index
+    void ResetRing(size_t size);
+
+    //! hash of error class and address, the port is ignored
+    static size_t GetHash(EStatError error,const struct sockaddr* p_peer,socklen_t peer_len);
+
+    //! compare addresses, the port is ignored
+    static bool IsSameAddress(const struct sockaddr* p_left,const struct sockaddr* p_right);
+
+    //! format address of entry
+    static const std::string GetAddress(const SEntry& entry);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,481 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include "StatFirebirdStorage.hpp"
+#include <ErrorSystem.hpp>
+#include <FirebirdItem.hpp>
+
+//------------------------------------------------------------------------------
+
+// number of input items of one STATISTICS row
+#define FIREBIRD_ROW_ITEMS 14
+
+// column list of STATISTICS insert
+#define FIREBIRD_STAT_COLUMNS \
+    "\"Site\",\"ModuleName\",\"ModuleVers\",\"ModuleArch\",\"ModuleMode\",\"User\",\"HostName\"," \
+    "\"NCPUS\",\"NHostCPUS\",\"NGPUS\",\"NHostGPUS\",\"NNODES\",\"Flags\",\"Time\""
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatFirebirdSession::CStatFirebirdSession(void)
+{
+    BlockRows = 1;
+}
+
+//------------------------------------------------------------------------------
+
+CStatFirebirdSession::~CStatFirebirdSession(void)
+{
+    if( Database.IsLogged() ) Database.Logout();
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatFirebirdSession::Login(const CSmallString& name,const CSmallString& user,
+                                 const CSmallString& password)
+{
+    Database.SetDatabaseName(name);
+
+    // silent - it is repeated by each reconnect attempt, callers report it
+    if( Database.Login(user,password) == false ) return(false);
+
+    Transaction.AssignToDatabase(&Database);
+
+    return(true);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatFirebirdSession::PrepareInsert(int& block_rows)
+{
+    // input items are allocated once per connection and then only
+    // set with new parameters, prepare errors are reported by the caller
+    // (silent - it is repeated by each reconnect attempt)
+
+    InsertSQL.AssignToTransaction(&Transaction);
+    if( InsertSQL.AllocateInputItems(FIREBIRD_ROW_ITEMS) == false ) return(false);
+
+    InsertText = "INSERT INTO \"STATISTICS\" (" FIREBIRD_STAT_COLUMNS ") VALUES(?,?,?,?,?,?,?,?,?,?,?,?,?,?)";
+
+    // multi-row insert - block_rows rows by one statement
+    if( block_rows > STORAGE_MAX_BLOCK_ROWS ) block_rows = STORAGE_MAX_BLOCK_ROWS;
+    if( block_rows > 1 ) {
+        BlockSQL.AssignToTransaction(&Transaction);
+
+        BlockText = "EXECUTE BLOCK (";
+        for(int r=0; r < block_rows; r++) {
+            for(int c=0; c < FIREBIRD_ROW_ITEMS; c++) {
+                if( (r > 0) || (c > 0) ) BlockText << ",";
+                BlockText << "P" << r << "_" << c;
+                BlockText << (c == FIREBIRD_ROW_ITEMS-1 ? " TIMESTAMP = ?" : " INTEGER = ?");
+            }
+        }
+        BlockText << ") AS BEGIN ";
+        for(int r=0; r < block_rows; r++) {
+            BlockText << "INSERT INTO \"STATISTICS\" (" FIREBIRD_STAT_COLUMNS ") VALUES(";
+            for(int c=0; c < FIREBIRD_ROW_ITEMS; c++) {
+                if( c > 0 ) BlockText << ",";
+                BlockText << ":P" << r << "_" << c;
+            }
+            BlockText << "); ";
+        }
+        BlockText << "END";
+
+        // single-row inserts are still available
+        if( BlockSQL.AllocateInputItems(block_rows*FIREBIRD_ROW_ITEMS) == false ) block_rows = 1;
+    }
+    BlockRows = block_rows;
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatFirebirdSession::PrepareRollup(void)
+{
+    // counters are added, distinct counts are kept at maximum
+    const char* p_tables[2] = { "STATISTICS_HOURLY", "STATISTICS_DAILY" };
+    CFirebirdExecuteSQL* p_sqls[2] = { &HourlySQL, &DailySQL };
+    CSmallString* p_texts[2] = { &HourlyText, &DailyText };
+
+    for(int i=0; i < 2; i++) {
+        p_sqls[i]->AssignToTransaction(&Transaction);
+        if( p_sqls[i]->AllocateInputItems(9) == false ) return(false);
+
+        CSmallString& sql = *p_texts[i];
+        sql = "";
+        sql << "MERGE INTO \"" << p_tables[i] << "\" r USING (SELECT "
+               "DATEADD(SECOND,CAST(? AS INTEGER),TIMESTAMP '1970-01-01 00:00:00') AS \"Period\","
+               "CAST(? AS INTEGER) AS \"Site\",CAST(? AS INTEGER) AS \"ModuleName\","
+               "CAST(? AS INTEGER) AS \"ModuleVers\",CAST(? AS INTEGER) AS \"ModuleArch\","
+               "CAST(? AS INTEGER) AS \"ModuleMode\",CAST(? AS INTEGER) AS \"NumOfRecords\","
+               "CAST(? AS INTEGER) AS \"NumOfUsers\",CAST(? AS INTEGER) AS \"NumOfHosts\" "
+               "FROM RDB$DATABASE) s "
+               "ON (r.\"Period\" = s.\"Period\" AND r.\"Site\" = s.\"Site\" AND "
+               "r.\"ModuleName\" = s.\"ModuleName\" AND r.\"ModuleVers\" = s.\"ModuleVers\" AND "
+               "r.\"ModuleArch\" = s.\"ModuleArch\" AND r.\"ModuleMode\" = s.\"ModuleMode\") "
+               "WHEN MATCHED THEN UPDATE SET "
+               "\"NumOfRecords\" = r.\"NumOfRecords\" + s.\"NumOfRecords\","
+               "\"NumOfUsers\" = MAXVALUE(r.\"NumOfUsers\",s.\"NumOfUsers\"),"
+               "\"NumOfHosts\" = MAXVALUE(r.\"NumOfHosts\",s.\"NumOfHosts\") "
+               "WHEN NOT MATCHED THEN INSERT (\"Period\",\"Site\",\"ModuleName\",\"ModuleVers\","
+               "\"ModuleArch\",\"ModuleMode\",\"NumOfRecords\",\"NumOfUsers\",\"NumOfHosts\") "
+               "VALUES (s.\"Period\",s.\"Site\",s.\"ModuleName\",s.\"ModuleVers\",s.\"ModuleArch\","
+               "s.\"ModuleMode\",s.\"NumOfRecords\",s.\"NumOfUsers\",s.\"NumOfHosts\")";
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatFirebirdSession::PrepareCount(void)
+{
+    // the query is prepared by each count
+    return(true);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatFirebirdSession::StartTransaction(void)
+{
+    return(Transaction.StartTransaction());
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatFirebirdSession::CommitTransaction(void)
+{
+    return(Transaction.CommitTransaction());
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatFirebirdSession::RollbackTransaction(void)
+{
+    return(Transaction.RollbackTransaction());
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatFirebirdSession::InsertRecord(const SStatRecord& record)
+{
+    SetRowItems(InsertSQL,0,record);
+    return(InsertSQL.ExecuteSQL(InsertText));
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatFirebirdSession::InsertBlock(const SStatRecord* p_records)
+{
+    for(int r=0; r < BlockRows; r++) {
+        SetRowItems(BlockSQL,r*FIREBIRD_ROW_ITEMS,p_records[r]);
+    }
+    return(BlockSQL.ExecuteSQL(BlockText));
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatFirebirdSession::MergeRollup(const SStatRollupRow& row)
+{
+    CFirebirdExecuteSQL* p_sql = row.Length == ROLLUP_HOUR ? &HourlySQL : &DailySQL;
+
+    p_sql->GetInputItem(0)->SetInt(row.Period);
+    p_sql->GetInputItem(1)->SetInt(row.Site);
+    p_sql->GetInputItem(2)->SetInt(row.ModuleName);
+    p_sql->GetInputItem(3)->SetInt(row.ModuleVers);
+    p_sql->GetInputItem(4)->SetInt(row.ModuleArch);
+    p_sql->GetInputItem(5)->SetInt(row.ModuleMode);
+    p_sql->GetInputItem(6)->SetInt(row.NumOfRecords);
+    p_sql->GetInputItem(7)->SetInt(row.NumOfUsers);
+    p_sql->GetInputItem(8)->SetInt(row.NumOfHosts);
+
+    return(p_sql->ExecuteSQL(row.Length == ROLLUP_HOUR ? HourlyText : DailyText));
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatFirebirdSession::CountRecords(const CSmallString& site)
+{
+    // new transaction for each count to see recent commits
+    if( Transaction.StartTransaction() == false ) {
+        ES_ERROR("unable to start database transaction");
+        return(-1);
+    }
+
+    CFirebirdQuerySQL sql_query;
+    sql_query.AssignToTransaction(&Transaction);
+
+    CSmallString sql;
+
+    sql = "SELECT COUNT(*) FROM \"STATISTICS\" s JOIN \"KEYS\" k ON s.\"Site\" = k.\"ID\" "
+          "WHERE k.\"Key\" = ?";
+
+    if( sql_query.PrepareQuery(sql) == false ) {
+        ES_ERROR("unable to prepare STATISTICS count");
+        Transaction.RollbackTransaction();
+        return(-1);
+    }
+
+    sql_query.GetInputItem(0)->SetString(site);
+    if( sql_query.ExecuteQueryOnce() == false ) {
+        ES_ERROR("unable to count STATISTICS rows");
+        Transaction.RollbackTransaction();
+        return(-1);
+    }
+    long int count = sql_query.GetOutputItem(0)->GetInt();
+
+    Transaction.CommitTransaction();
+
+    return(count);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatFirebirdSession::SetRowItems(CFirebirdExecuteSQL& sql,int first,const SStatRecord& record)
+{
+    for(int i=0; i < STORAGE_NUM_OF_KEYS; i++) {
+        sql.GetInputItem(first+i)->SetInt(record.Keys[i]);
+    }
+    sql.GetInputItem(first+7)->SetInt(record.NCPUs);
+    sql.GetInputItem(first+8)->SetInt(record.NHostCPUs);
+    sql.GetInputItem(first+9)->SetInt(record.NGPUs);
+    sql.GetInputItem(first+10)->SetInt(record.NHostGPUs);
+    sql.GetInputItem(first+11)->SetInt(record.NNodes);
+    sql.GetInputItem(first+12)->SetInt(record.Flags);
+    sql.GetInputItem(first+13)->SetTimeAndDate(record.Time);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatFirebirdStorage::CStatFirebirdStorage(void)
+{
+    KeyConnected = false;
+}
+
+//------------------------------------------------------------------------------
+
+CStatFirebirdStorage::~CStatFirebirdStorage(void)
+{
+    Close();
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatFirebirdStorage::Open(const CSmallString& name,const CSmallString& user,
+                                const CSmallString& password)
+{
+    // sessions open their own connections
+    Name = name;
+    User = user;
+    Password = password;
+
+    Database.SetDatabaseName(name);
+
+    if( Database.Login(user,password) == false ) {
+        ES_ERROR("unable to login to the database");
+        return(false);
+    };
+
+    KeyTransaction.AssignToDatabase(&Database);
+
+    if( PrepareStatements() == false ) {
+        ES_ERROR("unable to allocate SQL statements");
+        return(false);
+    }
+    KeyConnected = true;
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatFirebirdStorage::Close(void)
+{
+    if( Database.IsLogged() ) Database.Logout();
+}
+
+//------------------------------------------------------------------------------
+
+CStatStorageSession* CStatFirebirdStorage::CreateSession(void)
+{
+    // one connection per session - writers do not wait for each other
+    // in the client library
+    CStatFirebirdSession* p_session = new CStatFirebirdSession;
+    if( p_session->Login(Name,User,Password) == false ) {
+        delete p_session;
+        return(NULL);
+    }
+    return(p_session);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatFirebirdStorage::PrepareStatements(void)
+{
+    // silent - it is repeated by each reconnect attempt, callers report it
+    KeyInsertSQL.AssignToTransaction(&KeyTransaction);
+    return(KeyInsertSQL.AllocateInputItems(1));
+}
+
+//------------------------------------------------------------------------------
+
+int CStatFirebirdStorage::FindKey(const CSmallString& key)
+{
+    // prepared in the running key transaction, key lookups in the database
+    // are done only for keys missing in the cache
+    CFirebirdQuerySQL sql_query;
+    sql_query.AssignToTransaction(&KeyTransaction);
+
+    CSmallString sql;
+
+    sql = "SELECT \"ID\" FROM \"KEYS\" WHERE \"Key\" = ?";
+
+    if( sql_query.PrepareQuery(sql) == false ) return(-1);
+
+    sql_query.GetInputItem(0)->SetString(key);
+
+    if( sql_query.ExecuteQueryOnce() == false ) return(-1);
+
+    return(sql_query.GetOutputItem(0)->GetInt());
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatFirebirdStorage::LoadKeys(CStatKeyCache& cache)
+{
+    cache.Clear();
+
+    if( KeyTransaction.StartTransaction() == false ) {
+        ES_ERROR("unable to start database transaction");
+        return(false);
+    }
+
+    CFirebirdQuerySQL sql_query;
+    sql_query.AssignToTransaction(&KeyTransaction);
+
+    CSmallString sql;
+
+    sql = "SELECT \"ID\",\"Key\" FROM \"KEYS\"";
+
+    if( sql_query.PrepareQuery(sql) == false ){
+        ES_ERROR("unable to prepare sql query");
+        KeyTransaction.RollbackTransaction();
+        return(false);
+    }
+
+    if( sql_query.ExecuteQuery() == false ){
+        ES_ERROR("unable to execute sql query");
+        KeyTransaction.RollbackTransaction();
+        return(false);
+    }
+
+    while( sql_query.QueryRecord() == true ) {
+        int id = sql_query.GetOutputItem(0)->GetInt();
+        if( cache.Add(sql_query.GetOutputItem(1)->GetString(),id) == false ) break;
+    }
+
+    sql_query.CloseQuery();
+    KeyTransaction.CommitTransaction();
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+int CStatFirebirdStorage::CreateKey(const CSmallString& key)
+{
+    // new keys are committed in their own transaction, thus a cached key id
+    // is never invalidated by rollback of the datagram transaction
+
+    // the transaction cannot be started only if the connection is lost,
+    // statement errors fail just the key, errors are reported by the caller
+    if( KeyTransaction.StartTransaction() == false ) {
+        KeyConnected = false;
+        return(-1);
+    }
+
+    // find key id, it can be in the database if the cache is full
+    int id = FindKey(key);
+    if( id >= 0 ) {
+        KeyTransaction.CommitTransaction();
+        return(id);
+    }
+
+    // create new key and read its id back
+    KeyInsertSQL.GetInputItem(0)->SetString(key);
+
+    if( KeyInsertSQL.ExecuteSQL("INSERT INTO \"KEYS\" (\"Key\") VALUES(?)") == false ){
+        KeyTransaction.RollbackTransaction();
+        return(-1);
+    }
+
+    id = FindKey(key);
+    if( id < 0 ) {
+        KeyTransaction.RollbackTransaction();
+        return(-1);
+    }
+
+    if( KeyTransaction.CommitTransaction() == false ) {
+        KeyTransaction.RollbackTransaction();
+        return(-1);
+    }
+
+    return(id);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatFirebirdStorage::Reconnect(void)
+{
+    // statements of the lost connection are allocated again, failures
+    // are reported by the caller once per reconnect attempt
+    if( Database.IsLogged() ) Database.Logout();
+
+    if( Database.Login(User,Password) == false ) return(false);
+    if( PrepareStatements() == false ) return(false);
+
+    KeyConnected = true;
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatFirebirdStorage::IsConnected(void)
+{
+    return(KeyConnected);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
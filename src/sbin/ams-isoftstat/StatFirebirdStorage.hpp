@@ -0,0 +1,127 @@
+#ifndef StatFirebirdStorageH
+#define StatFirebirdStorageH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <FirebirdDatabase.hpp>
+#include <FirebirdTransaction.hpp>
+#include <FirebirdQuerySQL.hpp>
+#include <FirebirdExecuteSQL.hpp>
+#include "StatStorage.hpp"
+
+//------------------------------------------------------------------------------
+
+/// Firebird session - each session has its own connection and transaction
+/*! DML statements are executed by CFirebirdExecuteSQL with their input
+    items allocated once per session, queries are prepared in the
+    transaction that executes them, no statement handle outlives its
+    transaction
+*/
+
+class CStatFirebirdSession : public CStatStorageSession {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatFirebirdSession(void);
+    ~CStatFirebirdSession(void);
+
+// setup methods ---------------------------------------------------------------
+    //! open connection of the session
+    bool Login(const CSmallString& name,const CSmallString& user,
+               const CSmallString& password);
+
+    virtual bool PrepareInsert(int& block_rows);
+    virtual bool PrepareRollup(void);
+    virtual bool PrepareCount(void);
+
+// executive methods -----------------------------------------------------------
+    virtual bool StartTransaction(void);
+    virtual bool CommitTransaction(void);
+    virtual bool RollbackTransaction(void);
+    virtual bool InsertRecord(const SStatRecord& record);
+    virtual bool InsertBlock(const SStatRecord* p_records);
+    virtual bool MergeRollup(const SStatRollupRow& row);
+    virtual long int CountRecords(const CSmallString& site);
+
+// section of private data -----------------------------------------------------
+private:
+    CFirebirdDatabase       Database;
+    CFirebirdTransaction    Transaction;
+    CFirebirdExecuteSQL     InsertSQL;
+    CSmallString            InsertText;
+    CFirebirdExecuteSQL     BlockSQL;
+    CSmallString            BlockText;
+    int                     BlockRows;
+    CFirebirdExecuteSQL     HourlySQL;
+    CSmallString            HourlyText;
+    CFirebirdExecuteSQL     DailySQL;
+    CSmallString            DailyText;
+
+    //! set input items of one STATISTICS row starting at the item first
+    static void SetRowItems(CFirebirdExecuteSQL& sql,int first,const SStatRecord& record);
+};
+
+//------------------------------------------------------------------------------
+
+/// Firebird storage - KEYS are maintained by a dedicated connection
+/*! new keys are committed before they are used by any session, thus
+    all connections see the same KEYS dictionary
+*/
+
+class CStatFirebirdStorage : public CStatStorage {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatFirebirdStorage(void);
+    ~CStatFirebirdStorage(void);
+
+// setup methods ---------------------------------------------------------------
+    virtual bool Open(const CSmallString& name,const CSmallString& user,
+                      const CSmallString& password);
+    virtual void Close(void);
+    virtual CStatStorageSession* CreateSession(void);
+
+// executive methods -----------------------------------------------------------
+    virtual bool LoadKeys(CStatKeyCache& cache);
+    virtual int CreateKey(const CSmallString& key);
+    virtual bool Reconnect(void);
+
+// information methods ---------------------------------------------------------
+    virtual bool IsConnected(void);
+
+// section of private data -----------------------------------------------------
+private:
+    CSmallString            Name;
+    CSmallString            User;
+    CSmallString            Password;
+    CFirebirdDatabase       Database;
+    CFirebirdTransaction    KeyTransaction;
+    CFirebirdExecuteSQL     KeyInsertSQL;
+    bool                    KeyConnected;
+
+    //! allocate SQL statements used by the key lookup
+    bool PrepareStatements(void);
+
+    //! find id of the key in the current key transaction, -1 if not found
+    int FindKey(const CSmallString& key);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
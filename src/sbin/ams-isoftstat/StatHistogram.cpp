@@ -0,0 +1,107 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include "StatHistogram.hpp"
+#include <stdio.h>
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatHistogram::CStatHistogram(const long int* p_bounds,int nbounds)
+{
+    for(int i=0; i < nbounds; i++) {
+        Bounds.push_back(p_bounds[i]);
+    }
+    for(int i=0; i <= nbounds; i++) {
+        Buckets.push_back(new boost::atomic<long int>(0));
+    }
+    Count = 0;
+    Sum = 0;
+}
+
+//------------------------------------------------------------------------------
+
+CStatHistogram::~CStatHistogram(void)
+{
+    for(size_t i=0; i < Buckets.size(); i++) {
+        delete Buckets[i];
+    }
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatHistogram::Observe(long int value)
+{
+    size_t i = 0;
+    while( (i < Bounds.size()) && (value > Bounds[i]) ) i++;
+
+    Buckets[i]->fetch_add(1,boost::memory_order_relaxed);
+    Count.fetch_add(1,boost::memory_order_relaxed);
+    Sum.fetch_add(value,boost::memory_order_relaxed);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+long int CStatHistogram::GetCount(void) const
+{
+    return(Count.load(boost::memory_order_relaxed));
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatHistogram::GetSum(void) const
+{
+    return(Sum.load(boost::memory_order_relaxed));
+}
+
+//------------------------------------------------------------------------------
+
+void CStatHistogram::Print(std::string& out,const char* p_name,const char* p_help,double scale) const
+{
+    char buffer[256];
+
+    snprintf(buffer,sizeof(buffer),"# HELP %s %s\n# TYPE %s histogram\n",p_name,p_help,p_name);
+    out += buffer;
+
+    // buckets are cumulative
+    long int cumulative = 0;
+    for(size_t i=0; i < Buckets.size(); i++) {
+        cumulative += Buckets[i]->load(boost::memory_order_relaxed);
+        if( i < Bounds.size() ) {
+            snprintf(buffer,sizeof(buffer),"%s_bucket{le=\"%g\"} %ld\n",p_name,Bounds[i]/scale,cumulative);
+        } else {
+            snprintf(buffer,sizeof(buffer),"%s_bucket{le=\"+Inf\"} %ld\n",p_name,cumulative);
+        }
+        out += buffer;
+    }
+
+    snprintf(buffer,sizeof(buffer),"%s_sum %g\n%s_count %ld\n",p_name,GetSum()/scale,p_name,GetCount());
+    out += buffer;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
@@ -0,0 +1,63 @@
+#ifndef StatHistogramH
+#define StatHistogramH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <boost/atomic.hpp>
+#include <vector>
+#include <string>
+
+//------------------------------------------------------------------------------
+
+/// lock-free histogram with fixed bucket bounds
+
+class CStatHistogram {
+public:
+// constructor and destructors -------------------------------------------------
+    //! bounds are upper inclusive limits in ascending order
+    CStatHistogram(const long int* p_bounds,int nbounds);
+    ~CStatHistogram(void);
+
+// executive methods -----------------------------------------------------------
+    //! add observation
+    void Observe(long int value);
+
+// information methods ---------------------------------------------------------
+    //! number of observations
+    long int GetCount(void) const;
+
+    //! sum of observations
+    long int GetSum(void) const;
+
+    //! append histogram in text exposition format, values are divided by scale
+    void Print(std::string& out,const char* p_name,const char* p_help,double scale) const;
+
+// section of private data -----------------------------------------------------
+private:
+    std::vector<long int>                   Bounds;
+    std::vector<boost::atomic<long int>*>   Buckets;    // last bucket is +Inf
+    boost::atomic<long int>                 Count;
+    boost::atomic<long int>                 Sum;
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
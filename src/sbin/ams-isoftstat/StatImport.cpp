@@ -0,0 +1,487 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include "StatImport.hpp"
+#include <ErrorSystem.hpp>
+#include <SmallTimeAndDate.hpp>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+//------------------------------------------------------------------------------
+
+// timeout for stream operations (ms), the server may hold the ack while
+// its rings are full
+#define IMPORT_IO_TIMEOUT 60000
+
+// number of fields in the archive line
+#define IMPORT_NUM_OF_FIELDS 14
+
+// only the first bad lines are reported
+#define IMPORT_MAX_REPORTED 10
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+CStatImport Import;
+
+MAIN_ENTRY_OBJECT(Import)
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatImport::CStatImport(void)
+{
+    NumOfBatchRecords = 0;
+    Sequence = 0;
+    NumOfLines = 0;
+    NumOfBadLines = 0;
+    NumOfRecords = 0;
+    NumOfBatches = 0;
+    NumOfAcknowledged = 0;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+int CStatImport::Init(int argc, char* argv[])
+{
+    // encode program options, all check procedures are done inside of CABFIntOpts
+    int result = Options.ParseCmdLine(argc,argv);
+
+    // should we exit or was it error?
+    if( result != SO_CONTINUE ) return(result);
+
+    // attach verbose stream to terminal stream and set desired verbosity level
+    Console.Attach(stdout);
+    vout.Attach(Console);
+    if( Options.GetOptVerbose() ) {
+        vout.Verbosity(CVerboseStr::high);
+    } else {
+        vout.Verbosity(CVerboseStr::low);
+    }
+
+    CSmallTimeAndDate dt;
+    dt.GetActualTimeAndDate();
+
+    vout << low;
+    vout << endl;
+    vout << "# ==============================================================================" << endl;
+    vout << "# ams-isoftstat-import (AMS utility) started at " << dt.GetSDateAndTime() << endl;
+    vout << "# ==============================================================================" << endl;
+    if( Options.GetOptSocket() != NULL ) {
+        vout << "# Server      : " << Options.GetOptSocket() << " (unix socket)" << endl;
+    } else {
+        vout << "# Server      : " << Options.GetOptServer() << ":" << Options.GetOptPort() << endl;
+    }
+    vout << "# Batch       : " << Options.GetOptBatch() << " records" << endl;
+    vout << "# Window      : " << Options.GetOptWindow() << " batches" << endl;
+    vout << "# Compression : " << (Options.GetOptCompress() ? "zlib" : "none") << endl;
+    vout << "# ------------------------------------------------------------------------------" << endl;
+
+    return(SO_CONTINUE);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatImport::Run(void)
+{
+    if( Connect() == false ) {
+        ES_ERROR("unable to connect to the server");
+        return(false);
+    }
+
+    long int start = GetTimeInUS();
+
+    bool result = true;
+    if( Options.GetNumberOfProgArgs() == 0 ) {
+        result = ImportFile("-");
+    } else {
+        for(int i=0; i < Options.GetNumberOfProgArgs(); i++) {
+            if( ImportFile(Options.GetProgArg(i)) == false ) {
+                result = false;
+                break;
+            }
+        }
+    }
+
+    // the rest of records and all outstanding acks
+    if( result == true ) {
+        result = SendBatch();
+    }
+    while( (result == true) && (InFlight.empty() == false) ) {
+        result = WaitForAck();
+    }
+
+    long int elapsed = GetTimeInUS() - start;
+
+    Stream.Close();
+
+    PrintResults(elapsed);
+
+    if( NumOfBadLines > 0 ) {
+        CSmallString error;
+        error << NumOfBadLines << " line(s) were skipped";
+        ES_ERROR(error);
+    }
+
+    return(result);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatImport::Finalize(void)
+{
+    CSmallTimeAndDate dt;
+    dt.GetActualTimeAndDate();
+
+    vout << low;
+    vout << endl;
+    vout << "# ==============================================================================" << endl;
+    vout << "# ams-isoftstat-import (AMS utility) terminated at " << dt.GetSDateAndTime() << endl;
+    vout << "# ==============================================================================" << endl;
+
+    if( ErrorSystem.IsError() || Options.GetOptVerbose() ){
+        ErrorSystem.PrintErrors(vout);
+    }
+
+    vout << endl;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatImport::Connect(void)
+{
+    bool result;
+    if( Options.GetOptSocket() != NULL ) {
+        result = Stream.ConnectUnix(Options.GetOptSocket());
+    } else {
+        result = Stream.Connect(Options.GetOptServer(),Options.GetOptPort(),IMPORT_IO_TIMEOUT);
+    }
+    if( result == false ) return(false);
+
+    Stream.SetTimeout(IMPORT_IO_TIMEOUT);
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatImport::ImportFile(const CSmallString& name)
+{
+    if( name == "-" ) {
+        return(ImportStream(stdin,"stdin"));
+    }
+
+    FILE* p_fin = fopen(name,"r");
+    if( p_fin == NULL ) {
+        CSmallString error;
+        error << "unable to open '" << name << "' (" << strerror(errno) << ")";
+        ES_ERROR(error);
+        return(false);
+    }
+
+    bool result = ImportStream(p_fin,name);
+    fclose(p_fin);
+
+    return(result);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatImport::ImportStream(FILE* p_fin,const CSmallString& name)
+{
+    char*   p_line = NULL;
+    size_t  len = 0;
+    long int lineno = 0;
+    bool    result = true;
+
+    CAddStatDatagram datagram;
+
+    while( getline(&p_line,&len,p_fin) != -1 ) {
+        lineno++;
+        NumOfLines++;
+
+        // skip empty lines and comments
+        char* p_beg = p_line;
+        while( (*p_beg == ' ') || (*p_beg == '\t') ) p_beg++;
+        if( (*p_beg == '\0') || (*p_beg == '\n') || (*p_beg == '\r') || (*p_beg == '#') ) continue;
+
+        if( ParseLine(p_beg,datagram) == false ) {
+            NumOfBadLines++;
+            if( NumOfBadLines <= IMPORT_MAX_REPORTED ) {
+                CSmallString error;
+                error << "malformed record at " << name << ":" << lineno;
+                ES_ERROR(error);
+            }
+            continue;
+        }
+
+        NumOfRecords++;
+        if( AddRecord(datagram) == false ) {
+            result = false;
+            break;
+        }
+    }
+
+    if( (result == true) && ferror(p_fin) ) {
+        CSmallString error;
+        error << "unable to read '" << name << "'";
+        ES_ERROR(error);
+        result = false;
+    }
+
+    free(p_line);
+    return(result);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatImport::ParseLine(char* p_line,CAddStatDatagram& datagram)
+{
+    // strip the line ending
+    size_t len = strlen(p_line);
+    while( (len > 0) && ((p_line[len-1] == '\n') || (p_line[len-1] == '\r')) ) {
+        p_line[--len] = '\0';
+    }
+
+    // split into fields
+    const char* fields[IMPORT_NUM_OF_FIELDS];
+    int nfields = 0;
+    char* p_beg = p_line;
+    for(;;) {
+        if( nfields == IMPORT_NUM_OF_FIELDS ) return(false);
+        fields[nfields++] = p_beg;
+        char* p_sep = strchr(p_beg,';');
+        if( p_sep == NULL ) break;
+        *p_sep = '\0';
+        p_beg = p_sep + 1;
+    }
+    if( nfields != IMPORT_NUM_OF_FIELDS ) return(false);
+
+    // strings are limited by the packet string table
+    for(int i=1; i <= 7; i++) {
+        size_t slen = strlen(fields[i]);
+        if( (slen == 0) || (slen > STAT_PACKET_MAX_STRING) ) return(false);
+    }
+
+    time_t  time;
+    int     ncpus,nhostcpus,ngpus,nhostgpus,nnodes,flags;
+
+    if( ParseTime(fields[0],time) == false ) return(false);
+    if( ParseNumber(fields[8],ncpus) == false ) return(false);
+    if( ParseNumber(fields[9],nhostcpus) == false ) return(false);
+    if( ParseNumber(fields[10],ngpus) == false ) return(false);
+    if( ParseNumber(fields[11],nhostgpus) == false ) return(false);
+    if( ParseNumber(fields[12],nnodes) == false ) return(false);
+    if( ParseNumber(fields[13],flags) == false ) return(false);
+
+    datagram.SetSite(fields[1]);
+    datagram.SetModuleName(fields[2]);
+    datagram.SetModuleVers(fields[3]);
+    datagram.SetModuleArch(fields[4]);
+    datagram.SetModuleMode(fields[5]);
+    datagram.SetUser(fields[6]);
+    datagram.SetHostName(fields[7]);
+    datagram.SetNCPUs(ncpus);
+    datagram.SetNumOfHostCPUs(nhostcpus);
+    datagram.SetNGPUs(ngpus);
+    datagram.SetNumOfHostGPUs(nhostgpus);
+    datagram.SetNumOfNodes(nnodes);
+    datagram.SetFlags(flags);
+
+    CSmallTimeAndDate dt(time);
+    datagram.SetTimeAndDate(dt);
+
+    datagram.Finish();
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatImport::ParseTime(const char* p_str,time_t& time)
+{
+    // epoch seconds
+    char* p_end = NULL;
+    errno = 0;
+    long long value = strtoll(p_str,&p_end,10);
+    if( (p_end != p_str) && (*p_end == '\0') ) {
+        if( (errno != 0) || (value < 0) ) return(false);
+        time = (time_t)value;
+        return(true);
+    }
+
+    // local time
+    struct tm tm;
+    memset(&tm,0,sizeof(tm));
+    const char* p_rest = strptime(p_str,"%Y-%m-%d %H:%M:%S",&tm);
+    if( (p_rest == NULL) || (*p_rest != '\0') ) return(false);
+    tm.tm_isdst = -1;
+    time = mktime(&tm);
+    if( time == (time_t)-1 ) return(false);
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatImport::ParseNumber(const char* p_str,int& value)
+{
+    char* p_end = NULL;
+    errno = 0;
+    long int number = strtol(p_str,&p_end,10);
+    if( (p_end == p_str) || (*p_end != '\0') ) return(false);
+    // packet fields are at most 32 bits wide
+    if( (errno != 0) || (number < 0) || (number > 0x7FFFFFFF) ) return(false);
+    value = number;
+    return(true);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatImport::AddRecord(const CAddStatDatagram& datagram)
+{
+    if( Packet.AddRecord(datagram) == false ) {
+        // the packet is full - move it to the batch
+        Packet.Finish();
+        CStatStream::AddPacket(Payload,Packet.GetData(),Packet.GetSize());
+        Packet.Clear();
+        if( Packet.AddRecord(datagram) == false ) {
+            ES_ERROR("unable to add record to the packet");
+            return(false);
+        }
+    }
+    NumOfBatchRecords++;
+
+    // keep the payload well below the stream limit
+    if( (NumOfBatchRecords >= Options.GetOptBatch()) ||
+        (Payload.size() + STAT_PACKET_MAX_SIZE > STAT_STREAM_MAX_PAYLOAD/2) ) {
+        return(SendBatch());
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatImport::SendBatch(void)
+{
+    if( NumOfBatchRecords == 0 ) return(true);
+
+    if( Packet.GetNumOfRecords() > 0 ) {
+        Packet.Finish();
+        CStatStream::AddPacket(Payload,Packet.GetData(),Packet.GetSize());
+        Packet.Clear();
+    }
+
+    Sequence++;
+    if( Stream.WriteBatch(Sequence,Payload,Options.GetOptCompress()) == false ) {
+        CSmallString error;
+        error << "unable to send batch " << Sequence;
+        ES_ERROR(error);
+        return(false);
+    }
+    NumOfBatches++;
+
+    SBatch batch;
+    batch.Sequence = Sequence;
+    batch.NumOfRecords = NumOfBatchRecords;
+    InFlight.push_back(batch);
+
+    Payload.clear();
+    NumOfBatchRecords = 0;
+
+    // keep at most window batches unacknowledged
+    while( (int)InFlight.size() >= Options.GetOptWindow() ) {
+        if( WaitForAck() == false ) return(false);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatImport::WaitForAck(void)
+{
+    uint32_t seq = 0;
+    uint32_t nrecs = 0;
+    if( Stream.ReadAck(seq,nrecs) == false ) {
+        CSmallString error;
+        error << "no acknowledgement for batch " << InFlight.front().Sequence;
+        ES_ERROR(error);
+        return(false);
+    }
+
+    // batches are acknowledged in order
+    const SBatch& batch = InFlight.front();
+    if( (seq != batch.Sequence) || ((int)nrecs != batch.NumOfRecords) ) {
+        CSmallString error;
+        error << "unexpected acknowledgement " << (int)seq << "/" << (int)nrecs
+              << " (expected " << (int)batch.Sequence << "/" << batch.NumOfRecords << ")";
+        ES_ERROR(error);
+        return(false);
+    }
+
+    NumOfAcknowledged += nrecs;
+    InFlight.pop_front();
+
+    return(true);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatImport::PrintResults(long int elapsed)
+{
+    vout << endl;
+    vout << "Lines               : " << NumOfLines << endl;
+    vout << "Skipped lines       : " << NumOfBadLines << endl;
+    vout << "Records             : " << NumOfRecords << endl;
+    vout << "Batches             : " << NumOfBatches << endl;
+    vout << "Acknowledged        : " << NumOfAcknowledged << endl;
+    vout << "Sent bytes          : " << Stream.GetNumOfSentBytes() << endl;
+    if( elapsed > 0 ) {
+        vout << "Import rate         : " << (double)NumOfAcknowledged*1000000.0/elapsed << " records/s" << endl;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatImport::GetTimeInUS(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return(ts.tv_sec*1000000 + ts.tv_nsec/1000);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
@@ -0,0 +1,125 @@
+#ifndef StatImportH
+#define StatImportH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include <AMSMainHeader.hpp>
+#include <VerboseStr.hpp>
+#include <TerminalStr.hpp>
+#include <SoftStat.hpp>
+#include "StatImportOptions.hpp"
+#include "StatStream.hpp"
+#include "StatPacket.hpp"
+#include <vector>
+#include <deque>
+#include <stdio.h>
+
+//------------------------------------------------------------------------------
+
+/// bulk import of archived records into ams-isoftstat
+/*! records are sent in batches over the stream listener, up to window
+    batches are sent before the oldest one must be acknowledged, the server
+    acknowledges a batch when its records are in its spool, the records are
+    written into the database later
+*/
+
+class CStatImport {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatImport(void);
+
+// main methods ----------------------------------------------------------------
+    /// init options
+    int Init(int argc,char* argv[]);
+
+    /// main part of program
+    bool Run(void);
+
+    /// finalize
+    void Finalize(void);
+
+// information methods ---------------------------------------------------------
+    //! get monotonic time in us
+    static long int GetTimeInUS(void);
+
+// section of private data -----------------------------------------------------
+private:
+    struct SBatch {
+        uint32_t    Sequence;
+        int         NumOfRecords;
+    };
+
+    CStatImportOptions      Options;
+    CTerminalStr            Console;
+    CVerboseStr             vout;
+    CStatStream             Stream;
+
+    // batch being built
+    CStatPacket             Packet;
+    std::vector<uint8_t>    Payload;
+    int                     NumOfBatchRecords;
+    uint32_t                Sequence;
+
+    // batches waiting for acknowledgement
+    std::deque<SBatch>      InFlight;
+
+    // statistics
+    long int                NumOfLines;
+    long int                NumOfBadLines;
+    long int                NumOfRecords;
+    long int                NumOfBatches;
+    long int                NumOfAcknowledged;
+
+    //! connect to the stream listener
+    bool Connect(void);
+
+    //! import one archive
+    bool ImportFile(const CSmallString& name);
+
+    //! import archive from opened file
+    bool ImportStream(FILE* p_fin,const CSmallString& name);
+
+    //! decode line of archive
+    static bool ParseLine(char* p_line,CAddStatDatagram& datagram);
+
+    //! decode record time
+    static bool ParseTime(const char* p_str,time_t& time);
+
+    //! decode number
+    static bool ParseNumber(const char* p_str,int& value);
+
+    //! add record to the batch, the batch is sent when it is full
+    bool AddRecord(const CAddStatDatagram& datagram);
+
+    //! send the batch
+    bool SendBatch(void);
+
+    //! wait for acknowledgement of the oldest batch
+    bool WaitForAck(void);
+
+    //! print results
+    void PrintResults(long int elapsed);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
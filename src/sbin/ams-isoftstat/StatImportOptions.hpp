@@ -0,0 +1,160 @@
+#ifndef StatImportOptionsH
+#define StatImportOptionsH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <SimpleOptions.hpp>
+
+//------------------------------------------------------------------------------
+
+class CStatImportOptions : public CSimpleOptions {
+public:
+    // constructor - tune option setup
+    CStatImportOptions(void);
+
+    // program name and description -----------------------------------------------
+    CSO_PROG_NAME_BEGIN
+    "ams-isoftstat-import"
+    CSO_PROG_NAME_END
+
+    CSO_PROG_DESC_BEGIN
+    "It loads archived module-add-stat records into ams-isoftstat over the stream listener. "
+    "Each line of an archive holds one record: time;site;module;version;arch;mode;user;host;"
+    "ncpus;nhostcpus;ngpus;nhostgpus;nnodes;flags, where time is in seconds since the epoch "
+    "or in the YYYY-MM-DD HH:MM:SS format (local time). Empty lines and lines starting with # are skipped."
+    CSO_PROG_DESC_END
+
+    CSO_PROG_ARGS_SHORT_DESC_BEGIN
+    "[FILE]..."
+    CSO_PROG_ARGS_SHORT_DESC_END
+
+    CSO_PROG_ARGS_LONG_DESC_BEGIN
+    "archives to load, the standard input is read if no file is given or the file is -"
+    CSO_PROG_ARGS_LONG_DESC_END
+
+    // list of all options and arguments ------------------------------------------
+    CSO_LIST_BEGIN
+    // options ------------------------------
+    CSO_OPT(CSmallString,Server)
+    CSO_OPT(int,Port)
+    CSO_OPT(CSmallString,Socket)
+    CSO_OPT(int,Batch)
+    CSO_OPT(int,Window)
+    CSO_OPT(bool,Compress)
+    CSO_OPT(bool,Help)
+    CSO_OPT(bool,Version)
+    CSO_OPT(bool,Verbose)
+    CSO_LIST_END
+
+    CSO_MAP_BEGIN
+    // description of options --------------------------------------------------
+    CSO_MAP_OPT(CSmallString,                   /* option type */
+                Server,                         /* option name */
+                "localhost",                    /* default value */
+                false,                          /* is option mandatory */
+                's',                           /* short option name */
+                "server",                       /* long option name */
+                "NAME",                         /* parametr name */
+                "name of host running ams-isoftstat")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(int,                            /* option type */
+                Port,                           /* option name */
+                32599,                          /* default value */
+                false,                          /* is option mandatory */
+                'p',                           /* short option name */
+                "port",                         /* long option name */
+                "NUMBER",                       /* parametr name */
+                "port of the stream listener")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(CSmallString,                   /* option type */
+                Socket,                         /* option name */
+                "",                             /* default value */
+                false,                          /* is option mandatory */
+                'u',                           /* short option name */
+                "socket",                       /* long option name */
+                "PATH",                         /* parametr name */
+                "Unix socket of the stream listener, it is used instead of server and port")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(int,                            /* option type */
+                Batch,                          /* option name */
+                5000,                           /* default value */
+                false,                          /* is option mandatory */
+                'b',                           /* short option name */
+                "batch",                        /* long option name */
+                "NUMBER",                       /* parametr name */
+                "number of records in one acknowledged batch")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(int,                            /* option type */
+                Window,                         /* option name */
+                4,                              /* default value */
+                false,                          /* is option mandatory */
+                'w',                           /* short option name */
+                "window",                       /* long option name */
+                "NUMBER",                       /* parametr name */
+                "number of batches sent before an acknowledgement is awaited")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(bool,                           /* option type */
+                Compress,                       /* option name */
+                false,                          /* default value */
+                false,                          /* is option mandatory */
+                'c',                           /* short option name */
+                "compress",                     /* long option name */
+                NULL,                           /* parametr name */
+                "compress batches (slow links)")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(bool,                           /* option type */
+                Verbose,                        /* option name */
+                false,                          /* default value */
+                false,                          /* is option mandatory */
+                'v',                           /* short option name */
+                "verbose",                      /* long option name */
+                NULL,                           /* parametr name */
+                "increase output verbosity")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(bool,                           /* option type */
+                Version,                        /* option name */
+                false,                          /* default value */
+                false,                          /* is option mandatory */
+                '\0',                           /* short option name */
+                "version",                      /* long option name */
+                NULL,                           /* parametr name */
+                "output version information and exit")   /* option description */
+    //----------------------------------------------------------------------
+    CSO_MAP_OPT(bool,                           /* option type */
+                Help,                        /* option name */
+                false,                          /* default value */
+                false,                          /* is option mandatory */
+                'h',                           /* short option name */
+                "help",                      /* long option name */
+                NULL,                           /* parametr name */
+                "display this help and exit")   /* option description */
+    CSO_MAP_END
+
+    // final operation with options ------------------------------------------------
+private:
+    virtual int CheckOptions(void);
+    virtual int FinalizeOptions(void);
+    virtual int CheckArguments(void);
+};
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,140 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+#include "StatKeyCache.hpp"
+
+//------------------------------------------------------------------------------
+
+// approximate per-entry overhead of the hash map (node, bucket, string)
+#define KEY_ENTRY_OVERHEAD 64
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatKeyCache::CStatKeyCache(void)
+{
+    MaxSize = 100000;
+    KeySizes = 0;
+    NumOfHits = 0;
+    NumOfMisses = 0;
+    NumOfOverflows = 0;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatKeyCache::SetMaxSize(size_t max_size)
+{
+    MaxSize = max_size;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatKeyCache::Clear(void)
+{
+    Keys.clear();
+    KeySizes = 0;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatKeyCache::Find(const CSmallString& key,int& id) const
+{
+    // the key is compared in place
+    SStatStringView view;
+    view.Data = key.GetBuffer();
+    view.Length = key.GetLength();
+
+    TKeys::const_iterator it = Keys.find(view,SStatStringHash(),SStatStringEqual());
+    if( it == Keys.end() ) {
+        NumOfMisses++;
+        return(false);
+    }
+    id = it->second;
+    NumOfHits++;
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatKeyCache::Add(const CSmallString& key,int id)
+{
+    if( Keys.size() >= MaxSize ) {
+        NumOfOverflows++;
+        return(false);
+    }
+    std::pair<TKeys::iterator,bool> ret;
+    ret = Keys.insert(std::make_pair(std::string(key.GetBuffer(),key.GetLength()),id));
+    if( ret.second == true ) KeySizes += key.GetLength();
+    return(true);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+size_t CStatKeyCache::GetSize(void) const
+{
+    return(Keys.size());
+}
+
+//------------------------------------------------------------------------------
+
+size_t CStatKeyCache::GetMaxSize(void) const
+{
+    return(MaxSize);
+}
+
+//------------------------------------------------------------------------------
+
+size_t CStatKeyCache::GetMemoryUsage(void) const
+{
+    return(KeySizes + Keys.size()*KEY_ENTRY_OVERHEAD
+           + Keys.bucket_count()*sizeof(void*));
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatKeyCache::GetNumOfHits(void) const
+{
+    return(NumOfHits);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatKeyCache::GetNumOfMisses(void) const
+{
+    return(NumOfMisses);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatKeyCache::GetNumOfOverflows(void) const
+{
+    return(NumOfOverflows);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
@@ -0,0 +1,88 @@
+#ifndef StatKeyCacheH
+#define StatKeyCacheH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+#include <SmallString.hpp>
+#include "StatStringPool.hpp"
+#include <boost/unordered_map.hpp>
+#include <boost/atomic.hpp>
+#include <string>
+
+//------------------------------------------------------------------------------
+
+/// in-memory copy of the KEYS table (key -> ID)
+/*! Find can be called by several threads at once, Add must be exclusive
+*/
+
+class CStatKeyCache {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatKeyCache(void);
+
+// setup methods ---------------------------------------------------------------
+    //! set the maximum number of cached keys
+    void SetMaxSize(size_t max_size);
+
+    //! remove all keys
+    void Clear(void);
+
+// executive methods -----------------------------------------------------------
+    //! find key, return true if the key is cached (no allocation)
+    bool Find(const CSmallString& key,int& id) const;
+
+    //! add key, return false if the cache is full
+    bool Add(const CSmallString& key,int id);
+
+// information methods ---------------------------------------------------------
+    //! number of cached keys
+    size_t GetSize(void) const;
+
+    //! maximum number of cached keys
+    size_t GetMaxSize(void) const;
+
+    //! approximate memory occupied by the cache in bytes
+    size_t GetMemoryUsage(void) const;
+
+    //! number of successful lookups
+    long int GetNumOfHits(void) const;
+
+    //! number of failed lookups
+    long int GetNumOfMisses(void) const;
+
+    //! number of keys rejected because the cache was full
+    long int GetNumOfOverflows(void) const;
+
+// section of private data -----------------------------------------------------
+private:
+    typedef boost::unordered_map<std::string,int,
+                                 SStatStringHash,SStatStringEqual> TKeys;
+
+    TKeys                                   Keys;
+    size_t                                  MaxSize;
+    size_t                                  KeySizes;
+    mutable boost::atomic<long int>         NumOfHits;      // updated by readers
+    mutable boost::atomic<long int>         NumOfMisses;    // updated by readers
+    long int                                NumOfOverflows;
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,192 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include "StatMetrics.hpp"
+#include "AMSStatServer.hpp"
+#include <ErrorSystem.hpp>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+//------------------------------------------------------------------------------
+
+// poll timeout of the metrics thread (ms)
+#define METRICS_POLL_TIMEOUT 500
+
+// receive timeout of client request (s)
+#define METRICS_CLIENT_TIMEOUT 2
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatMetrics::CStatMetrics(void)
+{
+    Socket = -1;
+    Terminated = false;
+    NumOfRequests = 0;
+}
+
+//------------------------------------------------------------------------------
+
+CStatMetrics::~CStatMetrics(void)
+{
+    if( Socket != -1 ) close(Socket);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatMetrics::OpenSocket(const CSmallString& address,int port)
+{
+    struct addrinfo hints;
+    struct addrinfo* result;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    int s = getaddrinfo(address,CSmallString(port),&hints,&result);
+    if( s != 0 ) {
+        CSmallString error;
+        error << "getaddrinfo: " << gai_strerror(s);
+        ES_ERROR(error);
+        return(false);
+    }
+
+    struct addrinfo* rp;
+    for(rp = result; rp != NULL; rp = rp->ai_next) {
+        Socket = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+        if( Socket == -1 ) continue;
+        int on = 1;
+        setsockopt(Socket,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+        if( (bind(Socket, rp->ai_addr, rp->ai_addrlen) == 0) && (listen(Socket,16) == 0) ) break;
+        close(Socket);
+        Socket = -1;
+    }
+    freeaddrinfo(result);
+
+    if( Socket == -1 ) {
+        CSmallString error;
+        error << "unable to bind metrics endpoint " << address << ":" << port;
+        ES_ERROR(error);
+        return(false);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatMetrics::ShutdownMetrics(void)
+{
+    Terminated = true;
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatMetrics::GetNumOfRequests(void) const
+{
+    return(NumOfRequests);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatMetrics::ExecuteThread(void)
+{
+    struct pollfd pfd;
+    pfd.fd = Socket;
+    pfd.events = POLLIN;
+
+    while( Terminated == false ) {
+        pfd.revents = 0;
+        if( poll(&pfd,1,METRICS_POLL_TIMEOUT) <= 0 ) continue;
+
+        int client = accept(Socket,NULL,NULL);
+        if( client == -1 ) continue;
+
+        ServeClient(client);
+        close(client);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CStatMetrics::ServeClient(int client)
+{
+    // slow clients cannot block the thread for long
+    struct timeval tv;
+    tv.tv_sec = METRICS_CLIENT_TIMEOUT;
+    tv.tv_usec = 0;
+    setsockopt(client,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+    setsockopt(client,SOL_SOCKET,SO_SNDTIMEO,&tv,sizeof(tv));
+
+    // read request header
+    char    request[2048];
+    size_t  len = 0;
+    while( len < sizeof(request) - 1 ) {
+        ssize_t nread = recv(client,request + len,sizeof(request) - 1 - len,0);
+        if( nread <= 0 ) break;
+        len += nread;
+        request[len] = '\0';
+        if( strstr(request,"\r\n\r\n") != NULL ) break;
+    }
+    request[len] = '\0';
+
+    NumOfRequests++;
+
+    std::string response;
+    if( (strncmp(request,"GET /metrics ",13) == 0) || (strncmp(request,"GET / ",6) == 0) ) {
+        std::string body;
+        Server.WriteMetrics(body);
+
+        char header[256];
+        snprintf(header,sizeof(header),"HTTP/1.0 200 OK\r\n"
+                 "Content-Type: text/plain; version=0.0.4\r\n"
+                 "Content-Length: %lu\r\n"
+                 "Connection: close\r\n\r\n",(unsigned long)body.size());
+        response = header;
+        response += body;
+    } else {
+        response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    }
+
+    size_t sent = 0;
+    while( sent < response.size() ) {
+        ssize_t nsent = send(client,response.data() + sent,response.size() - sent,MSG_NOSIGNAL);
+        if( nsent <= 0 ) break;
+        sent += nsent;
+    }
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
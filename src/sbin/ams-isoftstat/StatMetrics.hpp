@@ -0,0 +1,66 @@
+#ifndef StatMetricsH
+#define StatMetricsH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <SmallString.hpp>
+#include <SmallThread.hpp>
+
+//------------------------------------------------------------------------------
+
+/// local HTTP endpoint serving metrics in text exposition format
+/*! requests are served one by one by the metrics thread, the content is
+    produced by CAMSStatServer::WriteMetrics
+*/
+
+class CStatMetrics : public CSmallThread {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatMetrics(void);
+    ~CStatMetrics(void);
+
+// setup methods ---------------------------------------------------------------
+    //! open listening TCP socket
+    bool OpenSocket(const CSmallString& address,int port);
+
+    //! request metrics thread termination
+    void ShutdownMetrics(void);
+
+// information methods ---------------------------------------------------------
+    //! number of served requests
+    long int GetNumOfRequests(void) const;
+
+// section of private data -----------------------------------------------------
+private:
+    int             Socket;
+    volatile bool   Terminated;
+    long int        NumOfRequests;
+
+    //! metrics loop
+    virtual void ExecuteThread(void);
+
+    //! read request and send response
+    void ServeClient(int client);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,324 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include "StatPacket.hpp"
+#include <string.h>
+#include <arpa/inet.h>
+
+//------------------------------------------------------------------------------
+
+#define STAT_PACKET_MAGIC           0x414D5332  // "AMS2"
+#define STAT_PACKET_VERSION         2
+#define STAT_PACKET_HEADER_SIZE     16
+#define STAT_PACKET_RECORD_SIZE     40
+
+// one zero byte is appended so that the size differs from v1 datagram
+#define STAT_PACKET_FLAG_PADDED     0x01
+
+// FNV-1a
+#define STAT_PACKET_FNV_BASIS       2166136261U
+#define STAT_PACKET_FNV_PRIME       16777619U
+
+//------------------------------------------------------------------------------
+
+static inline void PutUInt16(uint8_t* p_dest,uint16_t value)
+{
+    value = htons(value);
+    memcpy(p_dest,&value,sizeof(value));
+}
+
+//------------------------------------------------------------------------------
+
+static inline void PutUInt32(uint8_t* p_dest,uint32_t value)
+{
+    value = htonl(value);
+    memcpy(p_dest,&value,sizeof(value));
+}
+
+//------------------------------------------------------------------------------
+
+static inline uint16_t GetUInt16(const uint8_t* p_src)
+{
+    uint16_t value;
+    memcpy(&value,p_src,sizeof(value));
+    return(ntohs(value));
+}
+
+//------------------------------------------------------------------------------
+
+static inline uint32_t GetUInt32(const uint8_t* p_src)
+{
+    uint32_t value;
+    memcpy(&value,p_src,sizeof(value));
+    return(ntohl(value));
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatPacket::CStatPacket(void)
+{
+    SourceRecords = NULL;
+    NumOfRecords = 0;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatPacket::Clear(void)
+{
+    StringIndex.clear();
+    StringTable.clear();
+    Records.clear();
+    Data.clear();
+    NumOfRecords = 0;
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatPacket::AddRecord(const CAddStatDatagram& datagram)
+{
+    CSmallString strings[7];
+    strings[0] = datagram.GetSite();
+    strings[1] = datagram.GetModuleName();
+    strings[2] = datagram.GetModuleVers();
+    strings[3] = datagram.GetModuleArch();
+    strings[4] = datagram.GetModuleMode();
+    strings[5] = datagram.GetUser();
+    strings[6] = datagram.GetHostName();
+
+    // one byte is reserved for padding
+    size_t needed = STAT_PACKET_RECORD_SIZE;
+    for(int i=0; i < 7; i++) {
+        needed += GetNewStringSize(strings[i]);
+    }
+    size_t used = STAT_PACKET_HEADER_SIZE + StringTable.size() + Records.size();
+    if( used + needed > STAT_PACKET_MAX_SIZE - 1 ) return(false);
+
+    uint8_t record[STAT_PACKET_RECORD_SIZE];
+    for(int i=0; i < 7; i++) {
+        PutUInt16(&record[2*i],AddString(strings[i]));
+    }
+    PutUInt16(&record[14],datagram.GetFlags());
+    PutUInt32(&record[16],datagram.GetNCPUs());
+    PutUInt32(&record[20],datagram.GetNumOfHostCPUs());
+    PutUInt16(&record[24],datagram.GetNGPUs());
+    PutUInt16(&record[26],datagram.GetNumOfHostGPUs());
+    PutUInt16(&record[28],datagram.GetNumOfNodes());
+    PutUInt16(&record[30],0);
+    uint64_t time = datagram.GetTimeAndDate().GetSecondsFromBeginning();
+    PutUInt32(&record[32],time >> 32);
+    PutUInt32(&record[36],time & 0xFFFFFFFF);
+
+    Records.insert(Records.end(),record,record + STAT_PACKET_RECORD_SIZE);
+    NumOfRecords++;
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatPacket::Finish(void)
+{
+    size_t size = STAT_PACKET_HEADER_SIZE + StringTable.size() + Records.size();
+    uint8_t flags = 0;
+    if( size == sizeof(CAddStatDatagram) ) {
+        flags |= STAT_PACKET_FLAG_PADDED;
+        size++;
+    }
+
+    Data.assign(size,0);
+    PutUInt32(&Data[0],STAT_PACKET_MAGIC);
+    Data[4] = STAT_PACKET_VERSION;
+    Data[5] = flags;
+    PutUInt16(&Data[6],StringIndex.size());
+    PutUInt16(&Data[8],NumOfRecords);
+    PutUInt16(&Data[10],StringTable.size());
+    if( StringTable.empty() == false ) {
+        memcpy(&Data[STAT_PACKET_HEADER_SIZE],&StringTable[0],StringTable.size());
+    }
+    if( Records.empty() == false ) {
+        memcpy(&Data[STAT_PACKET_HEADER_SIZE + StringTable.size()],&Records[0],Records.size());
+    }
+    PutUInt32(&Data[12],GetChecksum(&Data[0],size));
+}
+
+//------------------------------------------------------------------------------
+
+const void* CStatPacket::GetData(void) const
+{
+    return(&Data[0]);
+}
+
+//------------------------------------------------------------------------------
+
+size_t CStatPacket::GetSize(void) const
+{
+    return(Data.size());
+}
+
+//------------------------------------------------------------------------------
+
+size_t CStatPacket::GetNewStringSize(const CSmallString& str) const
+{
+    std::string key(str.GetBuffer(),str.GetLength());
+    if( key.size() > STAT_PACKET_MAX_STRING ) key.resize(STAT_PACKET_MAX_STRING);
+    if( StringIndex.find(key) != StringIndex.end() ) return(0);
+    return(1 + key.size());
+}
+
+//------------------------------------------------------------------------------
+
+uint16_t CStatPacket::AddString(const CSmallString& str)
+{
+    std::string key(str.GetBuffer(),str.GetLength());
+    if( key.size() > STAT_PACKET_MAX_STRING ) key.resize(STAT_PACKET_MAX_STRING);
+
+    std::map<std::string,uint16_t>::iterator it = StringIndex.find(key);
+    if( it != StringIndex.end() ) return(it->second);
+
+    uint16_t index = StringIndex.size();
+    StringIndex[key] = index;
+    StringTable.push_back(key.size());
+    StringTable.insert(StringTable.end(),key.begin(),key.end());
+    return(index);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatPacket::IsPacket(const void* p_data,size_t size)
+{
+    if( size < STAT_PACKET_HEADER_SIZE ) return(false);
+    const uint8_t* p_src = (const uint8_t*)p_data;
+    return( (GetUInt32(p_src) == STAT_PACKET_MAGIC) && (p_src[4] == STAT_PACKET_VERSION) );
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatPacket::Parse(const void* p_data,size_t size)
+{
+    SourceRecords = NULL;
+    NumOfRecords = 0;
+    Strings.clear();
+
+    if( IsPacket(p_data,size) == false ) return(false);
+    if( size > STAT_PACKET_MAX_SIZE ) return(false);
+
+    const uint8_t* p_src = (const uint8_t*)p_data;
+    uint8_t  flags = p_src[5];
+    size_t   nstrings = GetUInt16(&p_src[6]);
+    size_t   nrecords = GetUInt16(&p_src[8]);
+    size_t   table_size = GetUInt16(&p_src[10]);
+    uint32_t checksum = GetUInt32(&p_src[12]);
+
+    size_t expected = STAT_PACKET_HEADER_SIZE + table_size + nrecords*STAT_PACKET_RECORD_SIZE;
+    if( flags & STAT_PACKET_FLAG_PADDED ) expected++;
+    if( expected != size ) return(false);
+
+    if( GetChecksum(p_src,size) != checksum ) return(false);
+
+    // string table - pooled strings are looked up in place, the pool
+    // is cleared only between packets
+    if( StringPool.IsFull() ) StringPool.Clear();
+    const uint8_t* p_str = p_src + STAT_PACKET_HEADER_SIZE;
+    const uint8_t* p_end = p_str + table_size;
+    Strings.reserve(nstrings);
+    for(size_t i=0; i < nstrings; i++) {
+        if( p_str >= p_end ) return(false);
+        size_t len = *p_str++;
+        if( p_str + len > p_end ) return(false);
+        Strings.push_back(StringPool.Get((const char*)p_str,len));
+        p_str += len;
+    }
+    if( p_str != p_end ) return(false);
+
+    // all string indexes must be valid
+    const uint8_t* p_rec = p_end;
+    for(size_t i=0; i < nrecords; i++) {
+        for(int j=0; j < 7; j++) {
+            if( GetUInt16(&p_rec[i*STAT_PACKET_RECORD_SIZE + 2*j]) >= nstrings ) return(false);
+        }
+    }
+
+    SourceRecords = p_rec;
+    NumOfRecords = nrecords;
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatPacket::GetRecord(int index,CAddStatDatagram& datagram) const
+{
+    const uint8_t* p_rec = SourceRecords + index*STAT_PACKET_RECORD_SIZE;
+
+    datagram.SetSite(*Strings[GetUInt16(&p_rec[0])]);
+    datagram.SetModuleName(*Strings[GetUInt16(&p_rec[2])]);
+    datagram.SetModuleVers(*Strings[GetUInt16(&p_rec[4])]);
+    datagram.SetModuleArch(*Strings[GetUInt16(&p_rec[6])]);
+    datagram.SetModuleMode(*Strings[GetUInt16(&p_rec[8])]);
+    datagram.SetUser(*Strings[GetUInt16(&p_rec[10])]);
+    datagram.SetHostName(*Strings[GetUInt16(&p_rec[12])]);
+    datagram.SetFlags(GetUInt16(&p_rec[14]));
+    datagram.SetNCPUs(GetUInt32(&p_rec[16]));
+    datagram.SetNumOfHostCPUs(GetUInt32(&p_rec[20]));
+    datagram.SetNGPUs(GetUInt16(&p_rec[24]));
+    datagram.SetNumOfHostGPUs(GetUInt16(&p_rec[26]));
+    datagram.SetNumOfNodes(GetUInt16(&p_rec[28]));
+
+    uint64_t time = ((uint64_t)GetUInt32(&p_rec[32]) << 32) | GetUInt32(&p_rec[36]);
+    CSmallTimeAndDate dt((time_t)time);
+    datagram.SetTimeAndDate(dt);
+
+    // the record passes the same checks as v1 datagram
+    datagram.Finish();
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+int CStatPacket::GetNumOfRecords(void) const
+{
+    return(NumOfRecords);
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t CStatPacket::GetChecksum(const uint8_t* p_data,size_t size)
+{
+    uint32_t h = STAT_PACKET_FNV_BASIS;
+    for(size_t i=0; i < size; i++) {
+        // the checksum field is taken as zero
+        uint8_t byte = ((i >= 12) && (i < 16)) ? 0 : p_data[i];
+        h = (h ^ byte) * STAT_PACKET_FNV_PRIME;
+    }
+    return(h);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
@@ -0,0 +1,130 @@
+#ifndef StatPacketH
+#define StatPacketH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include <SoftStat.hpp>
+#include "StatStringPool.hpp"
+#include <vector>
+#include <map>
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+//------------------------------------------------------------------------------
+
+// maximum size of v2 packet (bytes)
+#define STAT_PACKET_MAX_SIZE        8192
+
+// maximum length of one string of the string table
+#define STAT_PACKET_MAX_STRING      255
+
+//------------------------------------------------------------------------------
+
+/// multi-record datagram (protocol v2)
+/*! v1 datagram (CAddStatDatagram) carries one record padded to a fixed size,
+    v2 packet carries many compact records sharing one string table:
+
+    header (16 bytes, network byte order)
+        uint32  magic "AMS2"
+        uint8   version (2)
+        uint8   flags
+        uint16  number of strings
+        uint16  number of records
+        uint16  size of the string table (bytes)
+        uint32  FNV-1a checksum of the packet with zero checksum field
+    string table
+        uint8   length, chars (without terminator), repeated
+    records (40 bytes each)
+        uint16  site, module name, version, arch, mode, user, host (string indexes)
+        uint16  flags
+        uint32  number of CPUs, number of host CPUs
+        uint16  number of GPUs, number of host GPUs, number of nodes
+        uint16  reserved
+        uint32  time (s since the epoch), high and low half
+
+    a packet is never as long as v1 datagram, the size tells the versions apart
+*/
+
+class CStatPacket {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatPacket(void);
+
+// encoding --------------------------------------------------------------------
+    //! start new packet
+    void Clear(void);
+
+    //! add record, false if it does not fit into the packet
+    bool AddRecord(const CAddStatDatagram& datagram);
+
+    //! assemble packet and set its checksum
+    void Finish(void);
+
+    //! assembled packet
+    const void* GetData(void) const;
+
+    //! size of assembled packet
+    size_t GetSize(void) const;
+
+// decoding --------------------------------------------------------------------
+    //! does the payload start with v2 header?
+    static bool IsPacket(const void* p_data,size_t size);
+
+    //! validate packet and decode its string table
+    /*! false if the packet is malformed or its checksum is wrong */
+    bool Parse(const void* p_data,size_t size);
+
+    //! decode record, index must be lower than GetNumOfRecords()
+    void GetRecord(int index,CAddStatDatagram& datagram) const;
+
+// information methods ---------------------------------------------------------
+    //! number of records (added or parsed)
+    int GetNumOfRecords(void) const;
+
+// section of private data -----------------------------------------------------
+private:
+    // encoding
+    std::map<std::string,uint16_t>  StringIndex;
+    std::vector<uint8_t>            StringTable;
+    std::vector<uint8_t>            Records;
+    std::vector<uint8_t>            Data;
+
+    // decoding - strings are shared by packets of the same clients
+    const uint8_t*                  SourceRecords;
+    CStatStringPool                 StringPool;
+    std::vector<const CSmallString*> Strings;
+    int                             NumOfRecords;
+
+    //! space needed by the string if it is not in the table yet
+    size_t GetNewStringSize(const CSmallString& str) const;
+
+    //! get index of string in the table, it is added if necessary
+    uint16_t AddString(const CSmallString& str);
+
+    //! checksum of the packet
+    static uint32_t GetChecksum(const uint8_t* p_data,size_t size);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
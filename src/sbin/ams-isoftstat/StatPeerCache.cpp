@@ -0,0 +1,364 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include "StatPeerCache.hpp"
+#include "AMSStatServer.hpp"
+#include <ErrorSystem.hpp>
+#include <boost/functional/hash.hpp>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+
+//------------------------------------------------------------------------------
+
+// sleep time of idle resolver (us)
+#define RESOLVER_IDLE_TIME 100000
+
+// maximum number of queued refresh requests
+#define RESOLVER_MAX_REQUESTS 1024
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatPeerCache::SKey::operator == (const SKey& right) const
+{
+    return( (Hi == right.Hi) && (Lo == right.Lo) );
+}
+
+//------------------------------------------------------------------------------
+
+size_t CStatPeerCache::SKeyHash::operator () (const SKey& key) const
+{
+    size_t seed = 0;
+    boost::hash_combine(seed,key.Hi);
+    boost::hash_combine(seed,key.Lo);
+    return(seed);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatPeerCache::CStatPeerCache(void)
+{
+    ACL = NULL;
+    Terminated = false;
+    TTL = 300000;
+    MaxSize = 10000;
+    OrderHead = 0;
+
+    NumOfHits = 0;
+    NumOfMisses = 0;
+    NumOfDroppedRequests = 0;
+    NumOfEvictions = 0;
+    NumOfRefreshes = 0;
+    NumOfLookups = 0;
+    TotalLookupTime = 0;
+    MaxLookupTime = 0;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatPeerCache::SetCache(int ttl,size_t max_size)
+{
+    TTL = (long int)ttl*1000;
+    MaxSize = max_size;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatPeerCache::SetACL(CStatClientACL* p_acl)
+{
+    ACL = p_acl;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatPeerCache::ShutdownResolver(void)
+{
+    Terminated = true;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatPeerCache::IsAuthorized(const struct sockaddr* p_addr,socklen_t addr_len)
+{
+    // numeric rules need no DNS
+    int rule = ACL->MatchAddress(p_addr);
+    if( (rule != ACL_NO_MATCH) || (ACL->HasNameRules() == false) ) {
+        return(ACL->Decide(rule));
+    }
+
+    SKey        key = MakeKey(p_addr);
+    long int    now = CAMSStatServer::GetTimeInMS();
+
+    Mutex.Lock();
+
+    boost::unordered_map<SKey,SPeer,SKeyHash>::iterator it = Peers.find(key);
+    if( it != Peers.end() ) {
+        NumOfHits++;
+        rule = it->second.Rule;
+        // expired - use the old decision and let the resolver refresh it,
+        // a dropped request is repeated by the next datagram
+        if( (it->second.Expire <= now) && (it->second.Pending == false) ) {
+            it->second.Pending = QueueRequest(key,p_addr,addr_len);
+        }
+        Mutex.Unlock();
+        return(ACL->Decide(rule));
+    }
+
+    NumOfMisses++;
+    Mutex.Unlock();
+
+    // unknown peer - resolve it now, name rules cannot be decided otherwise
+    rule = Resolve(p_addr,addr_len);
+    Update(key,rule);
+
+    return(ACL->Decide(rule));
+}
+
+//------------------------------------------------------------------------------
+
+void CStatPeerCache::ExecuteThread(void)
+{
+    while( Terminated == false ) {
+        SRequest    request;
+        bool        found = false;
+
+        Mutex.Lock();
+        if( Requests.empty() == false ) {
+            request = Requests.front();
+            Requests.pop_front();
+            found = true;
+        }
+        Mutex.Unlock();
+
+        if( found == false ) {
+            usleep(RESOLVER_IDLE_TIME);
+            continue;
+        }
+
+        int rule = Resolve((struct sockaddr*)&request.Addr,request.AddrLen);
+        Update(request.Key,rule);
+
+        Mutex.Lock();
+        NumOfRefreshes++;
+        Mutex.Unlock();
+    }
+}
+
+//------------------------------------------------------------------------------
+
+const CStatPeerCache::SKey CStatPeerCache::MakeKey(const struct sockaddr* p_addr)
+{
+    unsigned char addr[16];
+
+    // the port is ignored, clients send from ephemeral ports
+    memset(addr,0,16);
+    switch(p_addr->sa_family) {
+        case AF_INET: {
+            const struct sockaddr_in* p_in = (const struct sockaddr_in*)p_addr;
+            addr[10] = 0xff;
+            addr[11] = 0xff;
+            memcpy(&addr[12],&p_in->sin_addr,4);
+            break;
+        }
+        case AF_INET6: {
+            const struct sockaddr_in6* p_in6 = (const struct sockaddr_in6*)p_addr;
+            memcpy(addr,&p_in6->sin6_addr,16);
+            break;
+        }
+        default:
+            // other families share one decision
+            break;
+    }
+
+    SKey key;
+    memcpy(&key.Hi,&addr[0],8);
+    memcpy(&key.Lo,&addr[8],8);
+    return(key);
+}
+
+//------------------------------------------------------------------------------
+
+int CStatPeerCache::Resolve(const struct sockaddr* p_addr,socklen_t addr_len)
+{
+    char host[NI_MAXHOST];
+    memset(host,0,NI_MAXHOST);
+
+    long int start = CAMSStatServer::GetTimeInMS();
+
+    // get client hostname -----------------------
+    int s = getnameinfo(p_addr, addr_len, host, NI_MAXHOST-1,
+                        NULL, 0, 0);
+
+    long int time = CAMSStatServer::GetTimeInMS() - start;
+
+    Mutex.Lock();
+    NumOfLookups++;
+    TotalLookupTime += time;
+    if( MaxLookupTime < time ) MaxLookupTime = time;
+    Mutex.Unlock();
+
+    if(s != 0) {
+        // client hostname is not available
+        Server.ReportError(STAT_ERROR_DNS,p_addr,addr_len);
+        return(ACL_NO_MATCH);
+    }
+
+    return(ACL->MatchName(host));
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatPeerCache::QueueRequest(const SKey& key,const struct sockaddr* p_addr,socklen_t addr_len)
+{
+    // keep memory bounded, evicted addresses can be requested again
+    if( Requests.size() >= RESOLVER_MAX_REQUESTS ) {
+        NumOfDroppedRequests++;
+        return(false);
+    }
+
+    SRequest request;
+    request.Key = key;
+    memcpy(&request.Addr,p_addr,addr_len);
+    request.AddrLen = addr_len;
+    Requests.push_back(request);
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+CStatPeerCache::SPeer& CStatPeerCache::FindOrAdd(const SKey& key)
+{
+    boost::unordered_map<SKey,SPeer,SKeyHash>::iterator it = Peers.find(key);
+    if( it != Peers.end() ) return(it->second);
+
+    // keep memory bounded - the oldest address is replaced by the new one
+    if( Order.size() < MaxSize ) {
+        Order.push_back(key);
+    } else {
+        Peers.erase(Order[OrderHead]);
+        Order[OrderHead] = key;
+        OrderHead = (OrderHead + 1) % Order.size();
+        NumOfEvictions++;
+    }
+
+    SPeer& peer = Peers[key];
+    peer.Rule = ACL_NO_MATCH;
+    peer.Pending = false;
+    peer.Expire = 0;
+    return(peer);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatPeerCache::Update(const SKey& key,int rule)
+{
+    Mutex.Lock();
+
+    // the address could be evicted while it was resolved
+    SPeer& peer = FindOrAdd(key);
+    peer.Rule = rule;
+    peer.Pending = false;
+    peer.Expire = CAMSStatServer::GetTimeInMS() + TTL;
+
+    Mutex.Unlock();
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+size_t CStatPeerCache::GetSize(void)
+{
+    Mutex.Lock();
+    size_t size = Peers.size();
+    Mutex.Unlock();
+    return(size);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatPeerCache::GetNumOfHits(void)
+{
+    return(NumOfHits);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatPeerCache::GetNumOfMisses(void)
+{
+    return(NumOfMisses);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatPeerCache::GetNumOfDroppedRequests(void)
+{
+    return(NumOfDroppedRequests);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatPeerCache::GetNumOfEvictions(void)
+{
+    return(NumOfEvictions);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatPeerCache::GetNumOfRefreshes(void)
+{
+    return(NumOfRefreshes);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatPeerCache::GetNumOfLookups(void)
+{
+    return(NumOfLookups);
+}
+
+//------------------------------------------------------------------------------
+
+double CStatPeerCache::GetAverageLookupTime(void)
+{
+    if( NumOfLookups == 0 ) return(0.0);
+    return((double)TotalLookupTime/NumOfLookups);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatPeerCache::GetMaxLookupTime(void)
+{
+    return(MaxLookupTime);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
@@ -0,0 +1,160 @@
+#ifndef StatPeerCacheH
+#define StatPeerCacheH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <SmallString.hpp>
+#include <SmallThread.hpp>
+#include <SimpleMutex.hpp>
+#include "StatClientACL.hpp"
+#include <boost/unordered_map.hpp>
+#include <string>
+#include <deque>
+#include <vector>
+#include <stdint.h>
+#include <sys/socket.h>
+
+//------------------------------------------------------------------------------
+
+/// authorization decisions cached per peer address
+/*! address rules of the access list are decided without the cache,
+    the first datagram from an unknown address is resolved synchronously,
+    expired decisions are still used while they are refreshed by the
+    resolver thread, thus DNS is queried at most once per address and TTL,
+    the oldest addresses are evicted when the cache is full and refresh
+    requests are dropped when the resolver queue is full
+*/
+
+class CStatPeerCache : public CSmallThread {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatPeerCache(void);
+
+// setup methods ---------------------------------------------------------------
+    //! set TTL of decisions (s) and the maximum number of cached addresses
+    void SetCache(int ttl,size_t max_size);
+
+    //! set access list
+    void SetACL(CStatClientACL* p_acl);
+
+    //! request resolver termination
+    void ShutdownResolver(void);
+
+// executive methods -----------------------------------------------------------
+    //! is the peer authorized? (receiver threads)
+    bool IsAuthorized(const struct sockaddr* p_addr,socklen_t addr_len);
+
+// information methods ---------------------------------------------------------
+    //! number of cached addresses
+    size_t GetSize(void);
+
+    //! number of decisions served from the cache
+    long int GetNumOfHits(void);
+
+    //! number of addresses resolved in the receiver thread
+    long int GetNumOfMisses(void);
+
+    //! number of refresh requests dropped because the queue was full
+    long int GetNumOfDroppedRequests(void);
+
+    //! number of addresses evicted from the full cache
+    long int GetNumOfEvictions(void);
+
+    //! number of decisions refreshed by the resolver thread
+    long int GetNumOfRefreshes(void);
+
+    //! number of DNS lookups
+    long int GetNumOfLookups(void);
+
+    //! average DNS lookup time (ms)
+    double GetAverageLookupTime(void);
+
+    //! maximum DNS lookup time (ms)
+    long int GetMaxLookupTime(void);
+
+// section of private data -----------------------------------------------------
+private:
+    // address without port, IPv4 addresses are mapped to IPv6
+    struct SKey {
+        uint64_t    Hi;
+        uint64_t    Lo;
+
+        bool operator == (const SKey& right) const;
+    };
+
+    struct SKeyHash {
+        size_t operator () (const SKey& key) const;
+    };
+
+    struct SPeer {
+        int                     Rule;       // matching ACL rule
+        bool                    Pending;    // refresh is queued
+        long int                Expire;     // ms
+    };
+
+    struct SRequest {
+        SKey                    Key;
+        struct sockaddr_storage Addr;
+        socklen_t               AddrLen;
+    };
+
+    CStatClientACL*                         ACL;
+    CSimpleMutex                            Mutex;
+    boost::unordered_map<SKey,SPeer,SKeyHash> Peers;
+    std::deque<SRequest>                    Requests;
+    std::vector<SKey>                       Order;      // cached addresses in insertion order (ring)
+    size_t                                  OrderHead;  // the oldest address
+    volatile bool                           Terminated;
+    long int                                TTL;        // ms
+    size_t                                  MaxSize;
+
+    // statistics
+    long int                                NumOfHits;
+    long int                                NumOfMisses;
+    long int                                NumOfDroppedRequests;
+    long int                                NumOfEvictions;
+    long int                                NumOfRefreshes;
+    long int                                NumOfLookups;
+    long int                                TotalLookupTime;
+    long int                                MaxLookupTime;
+
+    //! resolver loop
+    virtual void ExecuteThread(void);
+
+    //! address without port, no allocation is done on the datagram path
+    static const SKey MakeKey(const struct sockaddr* p_addr);
+
+    //! resolve peer name and find matching rule
+    int Resolve(const struct sockaddr* p_addr,socklen_t addr_len);
+
+    //! queue refresh of the address, false if the queue is full (under Mutex)
+    bool QueueRequest(const SKey& key,const struct sockaddr* p_addr,socklen_t addr_len);
+
+    //! find the address or add it, the oldest address is evicted (under Mutex)
+    SPeer& FindOrAdd(const SKey& key);
+
+    //! store decision
+    void Update(const SKey& key,int rule);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
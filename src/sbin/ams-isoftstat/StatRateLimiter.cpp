@@ -0,0 +1,268 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include "StatRateLimiter.hpp"
+#include "AMSStatServer.hpp"
+#include <boost/functional/hash.hpp>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+
+// part of active clients released when the table is full (1/n)
+#define RATE_EVICT_FRACTION 16
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatRateLimiter::SKey::operator == (const SKey& right) const
+{
+    return( (Hi == right.Hi) && (Lo == right.Lo) );
+}
+
+//------------------------------------------------------------------------------
+
+size_t CStatRateLimiter::SKeyHash::operator () (const SKey& key) const
+{
+    size_t seed = 0;
+    boost::hash_combine(seed,key.Hi);
+    boost::hash_combine(seed,key.Lo);
+    return(seed);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatRateLimiter::MoreDropped(const std::pair<SKey,SBucket>& left,
+                                   const std::pair<SKey,SBucket>& right)
+{
+    return(left.second.NumOfDropped > right.second.NumOfDropped);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatRateLimiter::CStatRateLimiter(void)
+{
+    Rate = 0;
+    Burst = 1;
+    MaxClients = 1;
+    NumOfDropped = 0;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatRateLimiter::SetLimit(double rate,double burst,size_t max_clients)
+{
+    Rate = rate / 1000000.0;
+    Burst = burst;
+    if( Burst < 1 ) Burst = 1;
+    MaxClients = max_clients;
+    if( MaxClients < 1 ) MaxClients = 1;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatRateLimiter::IsAllowed(const struct sockaddr* p_addr)
+{
+    SKey key;
+    if( MakeKey(p_addr,key) == false ) return(true);
+
+    long int now = CAMSStatServer::GetTimeInUS();
+
+    Mutex.Lock();
+
+    TBuckets::iterator it = Buckets.find(key);
+    if( it == Buckets.end() ) {
+        // keep memory bounded
+        if( Buckets.size() >= MaxClients ) Evict(now);
+        SBucket bucket;
+        bucket.Tokens = Burst;
+        bucket.Last = now;
+        bucket.NumOfPassed = 0;
+        bucket.NumOfDropped = 0;
+        it = Buckets.insert(std::make_pair(key,bucket)).first;
+    }
+
+    // refill
+    SBucket& bucket = it->second;
+    bucket.Tokens += (now - bucket.Last) * Rate;
+    if( bucket.Tokens > Burst ) bucket.Tokens = Burst;
+    bucket.Last = now;
+
+    bool allowed = bucket.Tokens >= 1.0;
+    if( allowed ) {
+        bucket.Tokens -= 1.0;
+        bucket.NumOfPassed++;
+    } else {
+        bucket.NumOfDropped++;
+        NumOfDropped++;
+    }
+
+    Mutex.Unlock();
+
+    return(allowed);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatRateLimiter::Evict(long int now)
+{
+    // idle clients would have full buckets, nothing is lost by their removal
+    TBuckets::iterator it = Buckets.begin();
+    while( it != Buckets.end() ) {
+        const SBucket& bucket = it->second;
+        if( bucket.Tokens + (now - bucket.Last) * Rate >= Burst ) {
+            it = Buckets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if( Buckets.size() < MaxClients ) return;
+
+    // all clients are active - the least recently seen are released, a part
+    // of the table at once so that the scan is not repeated for each new client
+    size_t count = Buckets.size() / RATE_EVICT_FRACTION;
+    if( count < 1 ) count = 1;
+
+    std::vector<long int> last;
+    last.reserve(Buckets.size());
+    for(it = Buckets.begin(); it != Buckets.end(); ++it) {
+        last.push_back(it->second.Last);
+    }
+    std::nth_element(last.begin(),last.begin() + (count-1),last.end());
+    long int oldest = last[count-1];
+
+    it = Buckets.begin();
+    while( (it != Buckets.end()) && (count > 0) ) {
+        if( it->second.Last <= oldest ) {
+            it = Buckets.erase(it);
+            count--;
+        } else {
+            ++it;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatRateLimiter::MakeKey(const struct sockaddr* p_addr,SKey& key)
+{
+    unsigned char addr[16];
+
+    // IPv4 addresses are stored as IPv4-mapped IPv6 addresses
+    switch(p_addr->sa_family) {
+        case AF_INET: {
+            const struct sockaddr_in* p_in = (const struct sockaddr_in*)p_addr;
+            memset(addr,0,10);
+            addr[10] = 0xff;
+            addr[11] = 0xff;
+            memcpy(&addr[12],&p_in->sin_addr,4);
+            break;
+        }
+        case AF_INET6: {
+            const struct sockaddr_in6* p_in6 = (const struct sockaddr_in6*)p_addr;
+            memcpy(addr,&p_in6->sin6_addr,16);
+            break;
+        }
+        default:
+            return(false);
+    }
+
+    memcpy(&key.Hi,&addr[0],8);
+    memcpy(&key.Lo,&addr[8],8);
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+const std::string CStatRateLimiter::MakeAddress(const SKey& key)
+{
+    unsigned char   addr[16];
+    char            buffer[INET6_ADDRSTRLEN];
+
+    memcpy(&addr[0],&key.Hi,8);
+    memcpy(&addr[8],&key.Lo,8);
+
+    static const unsigned char mapped[12] = { 0,0,0,0,0,0,0,0,0,0,0xff,0xff };
+    if( memcmp(addr,mapped,12) == 0 ) {
+        inet_ntop(AF_INET,&addr[12],buffer,sizeof(buffer));
+    } else {
+        inet_ntop(AF_INET6,addr,buffer,sizeof(buffer));
+    }
+    return(std::string(buffer));
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+size_t CStatRateLimiter::GetNumOfClients(void)
+{
+    Mutex.Lock();
+    size_t size = Buckets.size();
+    Mutex.Unlock();
+    return(size);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatRateLimiter::GetNumOfDropped(void)
+{
+    return(NumOfDropped);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatRateLimiter::GetTopClients(std::vector<SStatLimitedClient>& clients,size_t max_clients)
+{
+    std::vector< std::pair<SKey,SBucket> > limited;
+
+    Mutex.Lock();
+    for(TBuckets::iterator it = Buckets.begin(); it != Buckets.end(); ++it) {
+        if( it->second.NumOfDropped > 0 ) limited.push_back(*it);
+    }
+    Mutex.Unlock();
+
+    size_t n = std::min(limited.size(),max_clients);
+    std::partial_sort(limited.begin(),limited.begin() + n,limited.end(),MoreDropped);
+
+    clients.clear();
+    for(size_t i=0; i < n; i++) {
+        SStatLimitedClient client;
+        client.Address = MakeAddress(limited[i].first);
+        client.NumOfPassed = limited[i].second.NumOfPassed;
+        client.NumOfDropped = limited[i].second.NumOfDropped;
+        clients.push_back(client);
+    }
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
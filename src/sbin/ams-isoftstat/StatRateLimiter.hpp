@@ -0,0 +1,117 @@
+#ifndef StatRateLimiterH
+#define StatRateLimiterH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <SimpleMutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/socket.h>
+
+//------------------------------------------------------------------------------
+
+/// client with dropped datagrams
+struct SStatLimitedClient {
+    std::string Address;        // numeric address
+    long int    NumOfPassed;
+    long int    NumOfDropped;
+};
+
+//------------------------------------------------------------------------------
+
+/// token bucket per client address
+/*! each client can send rate datagrams per second on average and burst
+    datagrams at once, the bucket table is bounded, idle clients (full
+    buckets) are evicted first when it is full, then the least recently
+    seen clients
+*/
+
+class CStatRateLimiter {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatRateLimiter(void);
+
+// setup methods ---------------------------------------------------------------
+    //! set rate (datagrams/s), burst (datagrams) and maximum number of clients
+    void SetLimit(double rate,double burst,size_t max_clients);
+
+// executive methods -----------------------------------------------------------
+    //! take one token of the client, false if the datagram should be dropped (receiver threads)
+    bool IsAllowed(const struct sockaddr* p_addr);
+
+// information methods ---------------------------------------------------------
+    //! number of tracked clients
+    size_t GetNumOfClients(void);
+
+    //! number of dropped datagrams
+    long int GetNumOfDropped(void);
+
+    //! clients with the most dropped datagrams
+    void GetTopClients(std::vector<SStatLimitedClient>& clients,size_t max_clients);
+
+// section of private data -----------------------------------------------------
+private:
+    struct SKey {
+        uint64_t    Hi;
+        uint64_t    Lo;
+
+        bool operator == (const SKey& right) const;
+    };
+
+    struct SKeyHash {
+        size_t operator () (const SKey& key) const;
+    };
+
+    struct SBucket {
+        double      Tokens;
+        long int    Last;           // us
+        long int    NumOfPassed;
+        long int    NumOfDropped;
+    };
+
+    typedef boost::unordered_map<SKey,SBucket,SKeyHash> TBuckets;
+
+    CSimpleMutex    Mutex;
+    TBuckets        Buckets;
+    double          Rate;           // tokens per us
+    double          Burst;
+    size_t          MaxClients;
+    long int        NumOfDropped;
+
+    //! make key from the address, the port is ignored
+    static bool MakeKey(const struct sockaddr* p_addr,SKey& key);
+
+    //! make numeric address from the key
+    static const std::string MakeAddress(const SKey& key);
+
+    //! release idle clients, the least recently seen if none is idle
+    void Evict(long int now);
+
+    //! order clients by the number of dropped datagrams
+    static bool MoreDropped(const std::pair<SKey,SBucket>& left,
+                            const std::pair<SKey,SBucket>& right);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,561 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include "StatReceiver.hpp"
+#include "StatAllocCounter.hpp"
+#include "AMSStatServer.hpp"
+#include <ErrorSystem.hpp>
+#include <sys/types.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <poll.h>
+#include <netinet/in.h>
+
+//------------------------------------------------------------------------------
+
+// how often the receiver checks for termination (ms)
+#define RECEIVER_POLL_TIMEOUT 500
+
+// space for SO_RXQ_OVFL ancillary data
+#define RECEIVER_CONTROL_SIZE CMSG_SPACE(sizeof(uint32_t))
+
+// receive slot alignment
+#define RECEIVER_SLOT_ALIGN 16
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatReceiver::CStatReceiver(int id)
+{
+    ID = id;
+    Terminated = false;
+    BatchSize = 1;
+    RecvBufSize = 0;
+
+    // v2 packet is never as long as v1 datagram, the bigger one decides
+    SlotSize = sizeof(CAddStatDatagram);
+    if( SlotSize < STAT_PACKET_MAX_SIZE ) SlotSize = STAT_PACKET_MAX_SIZE;
+    SlotSize = (SlotSize + RECEIVER_SLOT_ALIGN - 1) / RECEIVER_SLOT_ALIGN * RECEIVER_SLOT_ALIGN;
+    RecvSlots.resize(SlotSize);
+
+    ActualRecvBufSize = 0;
+
+    NumOfRequests = 0;
+    NumOfRecvCalls = 0;
+    NumOfRecvDatagrams = 0;
+    MaxRecvBatch = 0;
+    NumOfInvalid = 0;
+    NumOfPackets = 0;
+    NumOfPacketRecords = 0;
+    NumOfRateLimited = 0;
+    NumOfBadChecksum = 0;
+    NumOfUnauthorized = 0;
+    NumOfDuplicates = 0;
+    NumOfAccepted = 0;
+    NumOfAllocations = 0;
+    NumOfDropped = 0;
+}
+
+//------------------------------------------------------------------------------
+
+CStatReceiver::~CStatReceiver(void)
+{
+    for(size_t i=0; i < Sockets.size(); i++) {
+        close(Sockets[i]);
+    }
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatReceiver::OpenSocket(int port,bool reuse_port,bool all_families)
+{
+    struct addrinfo hints;
+    struct addrinfo *result, *rp;
+    int  s;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;    /* Allow IPv4 or IPv6 */
+    hints.ai_socktype = SOCK_DGRAM; /* Datagram socket */
+    hints.ai_flags = AI_PASSIVE;    /* For wildcard IP address */
+    hints.ai_protocol = 0;          /* Any protocol */
+    hints.ai_canonname = NULL;
+    hints.ai_addr = NULL;
+    hints.ai_next = NULL;
+
+    s = getaddrinfo(NULL,CSmallString(port), &hints, &result);
+    if(s != 0) {
+        CSmallString error;
+        error << "getaddrinfo: " << gai_strerror(s);
+        ES_ERROR(error);
+        return(false);
+    }
+
+    //  getaddrinfo() returns a list of address structures.
+    // Try each address until we successfully bind(2).
+    // If socket(2) (or bind(2)) fails, we (close the socket
+    // and) try the next address.
+
+    for(rp = result; rp != NULL; rp = rp->ai_next) {
+        int sfd = socket(rp->ai_family, rp->ai_socktype,
+                         rp->ai_protocol);
+        if( sfd == -1 ) continue;
+
+        int on = 1;
+
+        // the kernel spreads datagrams among all sockets bound to the same port
+        if( reuse_port ) {
+            if( setsockopt(sfd,SOL_SOCKET,SO_REUSEPORT,&on,sizeof(on)) != 0 ) {
+                ES_ERROR("unable to set SO_REUSEPORT");
+                close(sfd);
+                continue;
+            }
+        }
+
+        // IPv6 socket must not claim the IPv4 port when both are bound
+        if( all_families && (rp->ai_family == AF_INET6) ) {
+            setsockopt(sfd,IPPROTO_IPV6,IPV6_V6ONLY,&on,sizeof(on));
+        }
+
+        // SO_RCVBUFFORCE ignores rmem_max but it requires CAP_NET_ADMIN
+        if( RecvBufSize > 0 ) {
+            if( setsockopt(sfd,SOL_SOCKET,SO_RCVBUFFORCE,&RecvBufSize,sizeof(RecvBufSize)) != 0 ) {
+                setsockopt(sfd,SOL_SOCKET,SO_RCVBUF,&RecvBufSize,sizeof(RecvBufSize));
+            }
+        }
+        socklen_t optlen = sizeof(ActualRecvBufSize);
+        getsockopt(sfd,SOL_SOCKET,SO_RCVBUF,&ActualRecvBufSize,&optlen);
+
+        // the kernel reports its drop counter with each datagram
+        if( setsockopt(sfd,SOL_SOCKET,SO_RXQ_OVFL,&on,sizeof(on)) != 0 ) {
+            ES_ERROR("unable to set SO_RXQ_OVFL, kernel drops are not counted");
+        }
+
+        if( bind(sfd, rp->ai_addr, rp->ai_addrlen) == 0) { // Success
+            Sockets.push_back(sfd);
+            KernelDrops.push_back(0);
+            if( all_families == false ) break;
+            continue;
+        }
+
+        close(sfd);
+    }
+
+    freeaddrinfo(result); // No longer needed
+
+    if( Sockets.empty() ) { // No address succeeded
+        ES_ERROR("could not bind");
+        return(false);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatReceiver::SetReceiveBuffer(int size)
+{
+    RecvBufSize = size;
+    if( RecvBufSize < 0 ) RecvBufSize = 0;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatReceiver::SetBatchSize(int batch_size)
+{
+    BatchSize = batch_size;
+    if( BatchSize < 1 ) BatchSize = 1;
+
+    // reusable buffers for batched receive
+    RecvSlots.resize(BatchSize*SlotSize);
+    if( BatchSize > 1 ) {
+        RecvMsgs.resize(BatchSize);
+        RecvIOVs.resize(BatchSize);
+        RecvPeers.resize(BatchSize);
+        RecvControls.resize(BatchSize*RECEIVER_CONTROL_SIZE);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CStatReceiver::ShutdownReceiver(void)
+{
+    Terminated = true;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatReceiver::ExecuteThread(void)
+{
+    std::vector<struct pollfd> pfds(Sockets.size());
+
+    while(Terminated == false) {
+
+        // wait for datagram -------------------------
+        for(size_t i=0; i < Sockets.size(); i++) {
+            pfds[i].fd = Sockets[i];
+            pfds[i].events = POLLIN;
+            pfds[i].revents = 0;
+        }
+
+        int ready = poll(&pfds[0],pfds.size(),RECEIVER_POLL_TIMEOUT);
+
+        if( ready <= 0 ) continue;                  // timeout or interrupted
+
+        for(size_t i=0; i < pfds.size(); i++) {
+            if( (pfds[i].revents & POLLIN) == 0 ) continue;
+
+            // get datagrams -------------------------
+            if( BatchSize > 1 ) {
+                ReceiveDatagrams(i);
+            } else {
+                ReceiveDatagram(i);
+            }
+        }
+
+        // published for the summary and metrics
+        NumOfAllocations = CStatAllocCounter::GetNumOfAllocations();
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CStatReceiver::ReceiveDatagram(size_t index)
+{
+    struct sockaddr_storage peer_addr;
+    struct msghdr           msg;
+    struct iovec            iov;
+    char                    control[RECEIVER_CONTROL_SIZE];
+    ssize_t                 nread;
+
+    iov.iov_base = &RecvSlots[0];
+    iov.iov_len = SlotSize;
+    memset(&msg,0,sizeof(msg));
+    msg.msg_name = &peer_addr;
+    msg.msg_namelen = sizeof(struct sockaddr_storage);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    nread = recvmsg(Sockets[index],&msg,0);
+
+    NumOfRequests++;
+    NumOfRecvCalls++;
+
+    if(nread == -1) return;                     // Ignore failed request
+
+    UpdateKernelDrops(index,&msg);
+
+    NumOfRecvDatagrams++;
+    if( MaxRecvBatch < 1 ) MaxRecvBatch = 1;
+
+    if( msg.msg_flags & MSG_TRUNC ) {           // Ignore oversized request
+        NumOfInvalid++;
+        return;
+    }
+
+    ProcessDatagram(&RecvSlots[0],nread,(struct sockaddr *)&peer_addr,msg.msg_namelen);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatReceiver::ReceiveDatagrams(size_t index)
+{
+    // reset buffers, the kernel overwrites the lengths
+    for(int i=0; i < BatchSize; i++) {
+        RecvIOVs[i].iov_base = &RecvSlots[i*SlotSize];
+        RecvIOVs[i].iov_len = SlotSize;
+        memset(&RecvMsgs[i],0,sizeof(struct mmsghdr));
+        RecvMsgs[i].msg_hdr.msg_iov = &RecvIOVs[i];
+        RecvMsgs[i].msg_hdr.msg_iovlen = 1;
+        RecvMsgs[i].msg_hdr.msg_name = &RecvPeers[i];
+        RecvMsgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+        RecvMsgs[i].msg_hdr.msg_control = &RecvControls[i*RECEIVER_CONTROL_SIZE];
+        RecvMsgs[i].msg_hdr.msg_controllen = RECEIVER_CONTROL_SIZE;
+    }
+
+    // the socket is readable, get all queued datagrams up to the batch size
+    int nmsgs = recvmmsg(Sockets[index],&RecvMsgs[0],BatchSize,MSG_DONTWAIT,NULL);
+
+    NumOfRecvCalls++;
+
+    if( nmsgs <= 0 ) {
+        NumOfRequests++;                        // Ignore failed request
+        return;
+    }
+
+    NumOfRequests += nmsgs;
+    NumOfRecvDatagrams += nmsgs;
+    if( MaxRecvBatch < nmsgs ) MaxRecvBatch = nmsgs;
+
+    // the last datagram carries the most recent counter
+    UpdateKernelDrops(index,&RecvMsgs[nmsgs-1].msg_hdr);
+
+    for(int i=0; i < nmsgs; i++) {
+        if( RecvMsgs[i].msg_hdr.msg_flags & MSG_TRUNC ) {  // Ignore oversized request
+            NumOfInvalid++;
+            continue;
+        }
+        ProcessDatagram(&RecvSlots[i*SlotSize],RecvMsgs[i].msg_len,
+                        (struct sockaddr *)&RecvPeers[i],RecvMsgs[i].msg_hdr.msg_namelen);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CStatReceiver::UpdateKernelDrops(size_t index,struct msghdr* p_msg)
+{
+    // SO_RXQ_OVFL carries the cumulative number of datagrams dropped on
+    // the socket, it is attached only when some datagrams were dropped
+    for(struct cmsghdr* p_cmsg = CMSG_FIRSTHDR(p_msg); p_cmsg != NULL;
+        p_cmsg = CMSG_NXTHDR(p_msg,p_cmsg)) {
+        if( (p_cmsg->cmsg_level == SOL_SOCKET) && (p_cmsg->cmsg_type == SO_RXQ_OVFL) ) {
+            uint32_t drops;
+            memcpy(&drops,CMSG_DATA(p_cmsg),sizeof(drops));
+            KernelDrops[index] = drops;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CStatReceiver::ProcessDatagram(const char* p_data,size_t size,
+                                    struct sockaddr* p_peer_addr,socklen_t peer_addr_len)
+{
+    // the size tells the protocol versions apart
+    bool v1 = size == sizeof(CAddStatDatagram);
+    if( (v1 == false) && (CStatPacket::IsPacket(p_data,size) == false) ) {
+        NumOfInvalid++;                         // Ignore incomplete request
+        return;
+    }
+
+    // noisy clients are dropped before any work --
+    if( Server.IsWithinRateLimit(p_peer_addr) == false ) {
+        NumOfRateLimited++;
+        return;
+    }
+
+    // validate datagram -------------------------
+    CAddStatDatagram datagram;
+    if( v1 ) {
+        memcpy(&datagram,p_data,sizeof(datagram));
+        if( datagram.IsValid() == false ) {
+            NumOfBadChecksum++;
+            Server.ReportError(STAT_ERROR_BAD_CHECKSUM,p_peer_addr,peer_addr_len);
+            return;
+        }
+    } else {
+        if( Packet.Parse(p_data,size) == false ) {
+            NumOfBadChecksum++;
+            Server.ReportError(STAT_ERROR_BAD_PACKET,p_peer_addr,peer_addr_len);
+            return;
+        }
+    }
+
+    // is client authorized? ---------------------
+    if( Server.IsPeerAuthorized(p_peer_addr,peer_addr_len) == false ) {
+        NumOfUnauthorized++;
+        // the address is formatted only when the error is logged
+        Server.ReportError(STAT_ERROR_UNAUTHORIZED,p_peer_addr,peer_addr_len);
+        return;
+    }
+
+    if( v1 ) {
+        AcceptRecord(datagram);
+        return;
+    }
+
+    // records of v2 packet pass the same path as v1 datagrams
+    NumOfPackets++;
+    for(int i=0; i < Packet.GetNumOfRecords(); i++) {
+        CAddStatDatagram record;
+        Packet.GetRecord(i,record);
+        NumOfPacketRecords++;
+        AcceptRecord(record);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CStatReceiver::AcceptRecord(const CAddStatDatagram& datagram)
+{
+    // drop retransmissions ----------------------
+    if( Server.IsDuplicate(datagram) == true ) {
+        NumOfDuplicates++;
+        return;
+    }
+
+    // pass datagram to the writers --------------
+    if( Server.DispatchDatagram(ID,datagram) == true ) {
+        NumOfAccepted++;
+    } else {
+        NumOfDropped++;
+    }
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+int CStatReceiver::GetID(void) const
+{
+    return(ID);
+}
+
+//------------------------------------------------------------------------------
+
+int CStatReceiver::GetNumOfSockets(void) const
+{
+    return(Sockets.size());
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatReceiver::GetNumOfRequests(void) const
+{
+    return(NumOfRequests);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatReceiver::GetNumOfRecvCalls(void) const
+{
+    return(NumOfRecvCalls);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatReceiver::GetNumOfRecvDatagrams(void) const
+{
+    return(NumOfRecvDatagrams);
+}
+
+//------------------------------------------------------------------------------
+
+int CStatReceiver::GetMaxRecvBatch(void) const
+{
+    return(MaxRecvBatch);
+}
+
+//------------------------------------------------------------------------------
+
+int CStatReceiver::GetBatchSize(void) const
+{
+    return(BatchSize);
+}
+
+//------------------------------------------------------------------------------
+
+int CStatReceiver::GetReceiveBuffer(void) const
+{
+    return(ActualRecvBufSize);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatReceiver::GetNumOfKernelDrops(void) const
+{
+    long int drops = 0;
+    for(size_t i=0; i < KernelDrops.size(); i++) {
+        drops += KernelDrops[i];
+    }
+    return(drops);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatReceiver::GetNumOfInvalid(void) const
+{
+    return(NumOfInvalid);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatReceiver::GetNumOfPackets(void) const
+{
+    return(NumOfPackets);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatReceiver::GetNumOfPacketRecords(void) const
+{
+    return(NumOfPacketRecords);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatReceiver::GetNumOfRateLimited(void) const
+{
+    return(NumOfRateLimited);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatReceiver::GetNumOfBadChecksum(void) const
+{
+    return(NumOfBadChecksum);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatReceiver::GetNumOfUnauthorized(void) const
+{
+    return(NumOfUnauthorized);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatReceiver::GetNumOfDuplicates(void) const
+{
+    return(NumOfDuplicates);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatReceiver::GetNumOfAccepted(void) const
+{
+    return(NumOfAccepted);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatReceiver::GetNumOfDropped(void) const
+{
+    return(NumOfDropped);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatReceiver::GetNumOfAllocations(void) const
+{
+    return(NumOfAllocations);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
@@ -0,0 +1,173 @@
+#ifndef StatReceiverH
+#define StatReceiverH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <SoftStat.hpp>
+#include <SmallThread.hpp>
+#include "StatPacket.hpp"
+#include <vector>
+#include <sys/socket.h>
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+
+/// receiver thread - it reads, validates and authorizes datagrams and passes
+/// them to the database writers, v1 datagrams and v2 packets are accepted
+
+class CStatReceiver : public CSmallThread {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatReceiver(int id);
+    ~CStatReceiver(void);
+
+// setup methods ---------------------------------------------------------------
+    //! set SO_RCVBUF of sockets opened later, 0 keeps the system default
+    void SetReceiveBuffer(int size);
+
+    //! open and bind the UDP socket(s)
+    /*! with reuse_port the socket can be shared with other receivers,
+        with all_families the receiver binds to all returned addresses
+        (e.g. IPv4 and IPv6) instead of only the first one */
+    bool OpenSocket(int port,bool reuse_port,bool all_families);
+
+    //! set the maximum number of datagrams received by one call
+    void SetBatchSize(int batch_size);
+
+    //! request receiver termination
+    void ShutdownReceiver(void);
+
+// information methods ---------------------------------------------------------
+    //! receiver id
+    int GetID(void) const;
+
+    //! number of bound sockets
+    int GetNumOfSockets(void) const;
+
+    //! number of receive requests
+    long int GetNumOfRequests(void) const;
+
+    //! number of receive calls
+    long int GetNumOfRecvCalls(void) const;
+
+    //! number of received datagrams
+    long int GetNumOfRecvDatagrams(void) const;
+
+    //! maximum number of datagrams received by one call
+    int GetMaxRecvBatch(void) const;
+
+    //! receive batch size
+    int GetBatchSize(void) const;
+
+    //! receive buffer size reported by the kernel
+    int GetReceiveBuffer(void) const;
+
+    //! number of datagrams dropped by the kernel (SO_RXQ_OVFL)
+    long int GetNumOfKernelDrops(void) const;
+
+    //! number of datagrams with wrong size
+    long int GetNumOfInvalid(void) const;
+
+    //! number of v2 packets
+    long int GetNumOfPackets(void) const;
+
+    //! number of records in v2 packets
+    long int GetNumOfPacketRecords(void) const;
+
+    //! number of datagrams dropped by the client rate limit
+    long int GetNumOfRateLimited(void) const;
+
+    //! number of datagrams with wrong checksum (malformed v2 packets included)
+    long int GetNumOfBadChecksum(void) const;
+
+    //! number of datagrams from unauthorized clients
+    long int GetNumOfUnauthorized(void) const;
+
+    //! number of retransmitted records dropped by deduplication
+    long int GetNumOfDuplicates(void) const;
+
+    //! number of records passed to the writers
+    long int GetNumOfAccepted(void) const;
+
+    //! number of records the writers did not accept (full ring or spool failure)
+    long int GetNumOfDropped(void) const;
+
+    //! number of heap allocations done by the receiver thread
+    long int GetNumOfAllocations(void) const;
+
+// section of private data -----------------------------------------------------
+private:
+    int                                     ID;
+    std::vector<int>                        Sockets;
+    volatile bool                           Terminated;
+    int                                     RecvBufSize;
+    int                                     ActualRecvBufSize;
+    std::vector<uint32_t>                   KernelDrops;    // per socket
+
+    // batched receive, one slot holds v1 datagram or v2 packet
+    int                                     BatchSize;
+    size_t                                  SlotSize;
+    std::vector<char>                       RecvSlots;
+    std::vector<struct mmsghdr>             RecvMsgs;
+    std::vector<struct iovec>               RecvIOVs;
+    std::vector<struct sockaddr_storage>    RecvPeers;
+    std::vector<char>                       RecvControls;
+    CStatPacket                             Packet;
+
+    // statistics
+    long int                                NumOfRequests;
+    long int                                NumOfRecvCalls;
+    long int                                NumOfRecvDatagrams;
+    int                                     MaxRecvBatch;
+    long int                                NumOfInvalid;
+    long int                                NumOfPackets;
+    long int                                NumOfPacketRecords;
+    long int                                NumOfRateLimited;
+    long int                                NumOfBadChecksum;
+    long int                                NumOfUnauthorized;
+    long int                                NumOfDuplicates;
+    long int                                NumOfAccepted;
+    long int                                NumOfDropped;
+    volatile long int                       NumOfAllocations;
+
+    //! main receiver loop
+    virtual void ExecuteThread(void);
+
+    //! receive one datagram by recvmsg
+    void ReceiveDatagram(size_t index);
+
+    //! receive up to BatchSize datagrams by recvmmsg
+    void ReceiveDatagrams(size_t index);
+
+    //! update kernel drop counter of the socket from ancillary data
+    void UpdateKernelDrops(size_t index,struct msghdr* p_msg);
+
+    //! validate datagram or packet and pass its records to the writers
+    void ProcessDatagram(const char* p_data,size_t size,
+                         struct sockaddr* p_peer_addr,socklen_t peer_addr_len);
+
+    //! drop retransmitted record or pass it to the writers
+    void AcceptRecord(const CAddStatDatagram& datagram);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
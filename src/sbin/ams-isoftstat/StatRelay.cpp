@@ -0,0 +1,287 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include "StatRelay.hpp"
+#include "StatSpool.hpp"
+#include "AMSStatServer.hpp"
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+
+// sleep time of idle relay (us)
+#define RELAY_IDLE_TIME 1000
+
+// send and acknowledgement timeout (ms)
+#define RELAY_IO_TIMEOUT 30000
+
+// delay between reconnect attempts, it doubles up to the maximum (ms)
+#define RELAY_MIN_RETRY 1000
+#define RELAY_MAX_RETRY 60000
+
+// termination is checked this often while waiting for the next attempt (us)
+#define RELAY_RETRY_STEP 100000
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatRelay::CStatRelay(void)
+{
+    Terminated = false;
+    FlushRequested = false;
+    Port = STAT_STREAM_PORT;
+    BatchSize = 1000;
+    Spool = NULL;
+    Connected = false;
+    Sequence = 0;
+    RetryDelay = RELAY_MIN_RETRY;
+    OutageStart = 0;
+
+    NumOfBatches = 0;
+    NumOfForwarded = 0;
+    NumOfFailures = 0;
+    NumOfSentBytes = 0;
+    NumOfPayloadBytes = 0;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatRelay::SetUpstream(const CSmallString& host,int port)
+{
+    Host = host;
+    Port = port;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatRelay::SetBatch(int batch_size)
+{
+    BatchSize = batch_size;
+    if( BatchSize < 1 ) BatchSize = 1;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatRelay::SetSpool(CStatSpool* p_spool)
+{
+    Spool = p_spool;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatRelay::ShutdownRelay(void)
+{
+    Terminated = true;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatRelay::RequestFlush(void)
+{
+    FlushRequested = true;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatRelay::ExecuteThread(void)
+{
+    for(;;) {
+        bool terminated = Terminated;
+        bool flush_requested = FlushRequested;
+        if( flush_requested ) FlushRequested = false;
+
+        bool idle = ! DrainSpool();
+
+        // send batch if it is full, the flush timer expired or on exit
+        bool sent = true;
+        if( Batch.empty() == false ) {
+            if( ((int)Batch.size() >= BatchSize) || flush_requested || terminated ) {
+                sent = SendBatch();
+            }
+        }
+
+        // unsent datagrams are replayed from the spool after restart
+        if( terminated && (Batch.empty() || (sent == false)) ) break;
+        if( sent == false ) {
+            WaitForRetry();
+        } else if( idle ) {
+            usleep(RELAY_IDLE_TIME);
+        }
+    }
+
+    Stream.Close();
+    Connected = false;
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatRelay::DrainSpool(void)
+{
+    CAddStatDatagram    datagram;
+    bool                found = false;
+
+    // the batch is kept while the upstream is not available
+    while( ((int)Batch.size() < BatchSize) && Spool->Read(datagram) ) {
+        Batch.push_back(datagram);
+        Payload.clear();
+        found = true;
+    }
+
+    return(found);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatRelay::EncodeBatch(void)
+{
+    Payload.clear();
+    Packet.Clear();
+    for(size_t i=0; i < Batch.size(); i++) {
+        if( Packet.AddRecord(Batch[i]) == true ) continue;
+        // the packet is full
+        Packet.Finish();
+        CStatStream::AddPacket(Payload,Packet.GetData(),Packet.GetSize());
+        Packet.Clear();
+        Packet.AddRecord(Batch[i]);
+    }
+    Packet.Finish();
+    CStatStream::AddPacket(Payload,Packet.GetData(),Packet.GetSize());
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatRelay::SendBatch(void)
+{
+    if( Stream.IsOpen() == false ) {
+        if( Stream.Connect(Host,Port,RELAY_IO_TIMEOUT) == false ) {
+            NumOfFailures++;
+            if( OutageStart == 0 ) OutageStart = CAMSStatServer::GetTimeInMS();
+            return(false);
+        }
+    }
+
+    // the payload is encoded once and kept for retries
+    if( Payload.empty() ) EncodeBatch();
+
+    Sequence++;
+    long int sent_bytes = Stream.GetNumOfSentBytes();
+    uint32_t seq = 0;
+    uint32_t nrecs = 0;
+    bool     result = Stream.WriteBatch(Sequence,Payload,true) && Stream.ReadAck(seq,nrecs);
+    NumOfSentBytes += Stream.GetNumOfSentBytes() - sent_bytes;
+
+    if( (result == false) || (seq != Sequence) ) {
+        Server.ReportError(STAT_ERROR_RELAY);
+        Stream.Close();
+        Connected = false;
+        NumOfFailures++;
+        if( OutageStart == 0 ) OutageStart = CAMSStatServer::GetTimeInMS();
+        return(false);
+    }
+
+    Connected = true;
+    OutageStart = 0;
+    RetryDelay = RELAY_MIN_RETRY;
+
+    NumOfBatches++;
+    NumOfForwarded += Batch.size();
+    NumOfPayloadBytes += Payload.size();
+    Spool->Commit(Batch.size());
+    Batch.clear();
+    Payload.clear();
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatRelay::WaitForRetry(void)
+{
+    long int deadline = CAMSStatServer::GetTimeInMS() + RetryDelay;
+    while( (Terminated == false) && (CAMSStatServer::GetTimeInMS() < deadline) ) {
+        usleep(RELAY_RETRY_STEP);
+    }
+
+    RetryDelay *= 2;
+    if( RetryDelay > RELAY_MAX_RETRY ) RetryDelay = RELAY_MAX_RETRY;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatRelay::IsConnected(void) const
+{
+    return(Connected);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatRelay::GetOutageTime(void) const
+{
+    long int start = OutageStart;
+    if( start == 0 ) return(0);
+    return(CAMSStatServer::GetTimeInMS() - start);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatRelay::GetNumOfBatches(void) const
+{
+    return(NumOfBatches);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatRelay::GetNumOfForwarded(void) const
+{
+    return(NumOfForwarded);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatRelay::GetNumOfFailures(void) const
+{
+    return(NumOfFailures);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatRelay::GetNumOfSentBytes(void) const
+{
+    return(NumOfSentBytes);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatRelay::GetNumOfPayloadBytes(void) const
+{
+    return(NumOfPayloadBytes);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
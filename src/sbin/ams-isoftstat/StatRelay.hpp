@@ -0,0 +1,132 @@
+#ifndef StatRelayH
+#define StatRelayH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include <SoftStat.hpp>
+#include <SmallThread.hpp>
+#include "StatStream.hpp"
+#include "StatPacket.hpp"
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class CStatSpool;
+
+/// relay thread - it forwards spooled datagrams to the central instance
+/*! datagrams accepted on a cluster head node are spooled locally, the relay
+    reads them in batches, packs them into v2 packets and sends compressed
+    batches over the stream, the spool checkpoint is moved only after the
+    batch is acknowledged, thus nothing is lost while the upstream is not
+    reachable, a batch can be delivered twice if the acknowledgement is lost
+*/
+
+class CStatRelay : public CSmallThread {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatRelay(void);
+
+// setup methods ---------------------------------------------------------------
+    //! set central instance
+    void SetUpstream(const CSmallString& host,int port);
+
+    //! set maximum number of records in one batch
+    void SetBatch(int batch_size);
+
+    //! set spool of accepted datagrams
+    void SetSpool(CStatSpool* p_spool);
+
+    //! request relay termination, unsent datagrams stay in the spool
+    void ShutdownRelay(void);
+
+    //! request sending of the partial batch (main thread timer)
+    void RequestFlush(void);
+
+// information methods ---------------------------------------------------------
+    //! is the upstream connected?
+    bool IsConnected(void) const;
+
+    //! duration of the current upstream outage (ms), 0 if connected
+    long int GetOutageTime(void) const;
+
+    //! number of acknowledged batches
+    long int GetNumOfBatches(void) const;
+
+    //! number of acknowledged records
+    long int GetNumOfForwarded(void) const;
+
+    //! number of failed sends (connection errors)
+    long int GetNumOfFailures(void) const;
+
+    //! number of bytes sent to the upstream
+    long int GetNumOfSentBytes(void) const;
+
+    //! number of uncompressed payload bytes sent to the upstream
+    long int GetNumOfPayloadBytes(void) const;
+
+// section of private data -----------------------------------------------------
+private:
+    volatile bool                   Terminated;
+    volatile bool                   FlushRequested;
+    CSmallString                    Host;
+    int                             Port;
+    int                             BatchSize;
+    CStatSpool*                     Spool;
+    CStatStream                     Stream;
+    volatile bool                   Connected;
+
+    // batch is kept until it is acknowledged
+    std::vector<CAddStatDatagram>   Batch;
+    std::vector<uint8_t>            Payload;
+    CStatPacket                     Packet;
+    uint32_t                        Sequence;
+
+    // reconnect
+    int                             RetryDelay;     // ms
+    volatile long int               OutageStart;    // ms, 0 if connected
+
+    // statistics
+    long int                        NumOfBatches;
+    long int                        NumOfForwarded;
+    long int                        NumOfFailures;
+    volatile long int               NumOfSentBytes;
+    volatile long int               NumOfPayloadBytes;
+
+    //! relay loop
+    virtual void ExecuteThread(void);
+
+    //! read datagrams from the spool into the batch
+    bool DrainSpool(void);
+
+    //! pack batch into v2 packets
+    void EncodeBatch(void);
+
+    //! send batch and wait for acknowledgement
+    bool SendBatch(void);
+
+    //! wait before the next attempt, return early on termination
+    void WaitForRetry(void);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
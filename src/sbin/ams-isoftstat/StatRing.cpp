@@ -0,0 +1,108 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include "StatRing.hpp"
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatRing::CStatRing(size_t capacity)
+    : Capacity(capacity),Queue(capacity)
+{
+    NumOfPushed = 0;
+    NumOfPopped = 0;
+    NumOfDrops = 0;
+    HighWaterMark = 0;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatRing::Push(const CAddStatDatagram& datagram)
+{
+    if( Queue.push(datagram) == false ) {
+        NumOfDrops.fetch_add(1,boost::memory_order_relaxed);
+        return(false);
+    }
+
+    long int pushed = NumOfPushed.fetch_add(1,boost::memory_order_relaxed) + 1;
+    long int depth = pushed - NumOfPopped.load(boost::memory_order_relaxed);
+    if( depth > HighWaterMark.load(boost::memory_order_relaxed) ) {
+        HighWaterMark.store(depth,boost::memory_order_relaxed);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatRing::Pop(CAddStatDatagram& datagram)
+{
+    if( Queue.pop(datagram) == false ) return(false);
+    NumOfPopped.fetch_add(1,boost::memory_order_relaxed);
+    return(true);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+size_t CStatRing::GetCapacity(void) const
+{
+    return(Capacity);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatRing::GetDepth(void) const
+{
+    long int depth = NumOfPushed.load(boost::memory_order_relaxed)
+                   - NumOfPopped.load(boost::memory_order_relaxed);
+    if( depth < 0 ) depth = 0;
+    return(depth);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatRing::GetHighWaterMark(void) const
+{
+    return(HighWaterMark.load(boost::memory_order_relaxed));
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatRing::GetNumOfDrops(void) const
+{
+    return(NumOfDrops.load(boost::memory_order_relaxed));
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatRing::GetNumOfPushed(void) const
+{
+    return(NumOfPushed.load(boost::memory_order_relaxed));
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
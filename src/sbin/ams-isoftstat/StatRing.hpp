@@ -0,0 +1,72 @@
+#ifndef StatRingH
+#define StatRingH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <SoftStat.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+#include <boost/atomic.hpp>
+
+//------------------------------------------------------------------------------
+
+/// bounded single-producer/single-consumer queue of validated datagrams
+
+class CStatRing {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatRing(size_t capacity);
+
+// executive methods -----------------------------------------------------------
+    //! add datagram (producer), return false and count drop if the ring is full
+    bool Push(const CAddStatDatagram& datagram);
+
+    //! get datagram (consumer), return false if the ring is empty
+    bool Pop(CAddStatDatagram& datagram);
+
+// information methods ---------------------------------------------------------
+    //! ring capacity
+    size_t GetCapacity(void) const;
+
+    //! current number of queued datagrams
+    long int GetDepth(void) const;
+
+    //! maximum number of queued datagrams
+    long int GetHighWaterMark(void) const;
+
+    //! number of datagrams dropped because the ring was full
+    long int GetNumOfDrops(void) const;
+
+    //! number of datagrams added to the ring
+    long int GetNumOfPushed(void) const;
+
+// section of private data -----------------------------------------------------
+private:
+    size_t                                          Capacity;
+    boost::lockfree::spsc_queue<CAddStatDatagram>   Queue;
+    boost::atomic<long int>                         NumOfPushed;    // written by producer
+    boost::atomic<long int>                         NumOfPopped;    // written by consumer
+    boost::atomic<long int>                         NumOfDrops;     // written by producer
+    boost::atomic<long int>                         HighWaterMark;  // written by producer
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
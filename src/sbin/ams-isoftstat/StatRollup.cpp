@@ -0,0 +1,334 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include "StatRollup.hpp"
+#include "AMSStatServer.hpp"
+#include <ErrorSystem.hpp>
+#include <boost/functional/hash.hpp>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+
+// sleep time of idle rollup thread (us)
+#define ROLLUP_IDLE_TIME 100000
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatRollup::SKey::operator == (const SKey& right) const
+{
+    return( (Length == right.Length) && (Period == right.Period) &&
+            (Site == right.Site) && (ModuleName == right.ModuleName) &&
+            (ModuleVers == right.ModuleVers) && (ModuleArch == right.ModuleArch) &&
+            (ModuleMode == right.ModuleMode) );
+}
+
+//------------------------------------------------------------------------------
+
+size_t CStatRollup::SKeyHash::operator () (const SKey& key) const
+{
+    size_t seed = 0;
+    boost::hash_combine(seed,key.Length);
+    boost::hash_combine(seed,key.Period);
+    boost::hash_combine(seed,key.Site);
+    boost::hash_combine(seed,key.ModuleName);
+    boost::hash_combine(seed,key.ModuleVers);
+    boost::hash_combine(seed,key.ModuleArch);
+    boost::hash_combine(seed,key.ModuleMode);
+    return(seed);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatRollup::CStatRollup(void)
+{
+    Storage = NULL;
+    Session = NULL;
+    Connected = true;
+    Terminated = false;
+    FlushRequested = false;
+
+    NumOfFlushedRows = 0;
+    NumOfFailedFlushes = 0;
+}
+
+//------------------------------------------------------------------------------
+
+CStatRollup::~CStatRollup(void)
+{
+    CloseRollup();
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatRollup::InitRollup(CStatStorage* p_storage)
+{
+    Storage = p_storage;
+    return(OpenSession());
+}
+
+//------------------------------------------------------------------------------
+
+void CStatRollup::CloseRollup(void)
+{
+    if( Session != NULL ) delete Session;
+    Session = NULL;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatRollup::ShutdownRollup(void)
+{
+    Terminated = true;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatRollup::RequestFlush(void)
+{
+    FlushRequested = true;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatRollup::ExecuteThread(void)
+{
+    // database I/O is kept out of the event loop
+    for(;;) {
+        bool terminated = Terminated;
+        bool flush_requested = FlushRequested;
+        if( flush_requested ) FlushRequested = false;
+
+        // the writers are stopped before termination, emit the last rollups
+        if( flush_requested || terminated ) Flush();
+        if( terminated ) break;
+
+        usleep(ROLLUP_IDLE_TIME);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CStatRollup::Add(const std::vector<SStatRollupRecord>& records)
+{
+    if( records.empty() ) return;
+
+    Mutex.Lock();
+    for(size_t i=0; i < records.size(); i++) {
+        AddRecord(ROLLUP_HOUR,records[i]);
+        AddRecord(ROLLUP_DAY,records[i]);
+    }
+    Mutex.Unlock();
+}
+
+//------------------------------------------------------------------------------
+
+void CStatRollup::AddRecord(int length,const SStatRollupRecord& record)
+{
+    SKey key;
+    key.Length = length;
+    key.Period = record.Time - record.Time % length;
+    key.Site = record.Site;
+    key.ModuleName = record.ModuleName;
+    key.ModuleVers = record.ModuleVers;
+    key.ModuleArch = record.ModuleArch;
+    key.ModuleMode = record.ModuleMode;
+
+    TBuckets::iterator it = Buckets.find(key);
+    if( it == Buckets.end() ) {
+        it = Buckets.insert(std::make_pair(key,SBucket())).first;
+        it->second.NumOfRecords = 0;
+    }
+
+    it->second.NumOfRecords++;
+    it->second.Users.insert(record.User);
+    it->second.Hosts.insert(record.HostName);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatRollup::Flush(void)
+{
+    std::vector<SRow>   rows;
+    time_t              now = time(NULL);
+
+    // take pending counters
+    Mutex.Lock();
+    TBuckets::iterator it = Buckets.begin();
+    while( it != Buckets.end() ) {
+        SBucket& bucket = it->second;
+        if( bucket.NumOfRecords > 0 ) {
+            SRow row;
+            row.Key = it->first;
+            row.NumOfRecords = bucket.NumOfRecords;
+            row.NumOfUsers = bucket.Users.size();
+            row.NumOfHosts = bucket.Hosts.size();
+            rows.push_back(row);
+            bucket.NumOfRecords = 0;
+        }
+        ++it;
+    }
+    Mutex.Unlock();
+
+    // the flush interval is the delay between reconnect attempts
+    if( rows.empty() || ((Connected || Reconnect()) && (WriteRows(rows) == true)) ) {
+        NumOfFlushedRows += rows.size();
+        ReleaseBuckets(now);
+        return(true);
+    }
+
+    // return counters back, they are merged by the next flush,
+    // the buckets with their sets are kept until then
+    NumOfFailedFlushes++;
+    Server.ReportError(STAT_ERROR_ROLLUP);
+
+    Mutex.Lock();
+    for(size_t i=0; i < rows.size(); i++) {
+        TBuckets::iterator it = Buckets.find(rows[i].Key);
+        if( it == Buckets.end() ) {
+            it = Buckets.insert(std::make_pair(rows[i].Key,SBucket())).first;
+            it->second.NumOfRecords = 0;
+        }
+        it->second.NumOfRecords += rows[i].NumOfRecords;
+    }
+    Mutex.Unlock();
+
+    return(false);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatRollup::ReleaseBuckets(time_t now)
+{
+    // closed periods are released once all their counters are written,
+    // later records start with empty sets and are merged by the database
+    Mutex.Lock();
+    TBuckets::iterator it = Buckets.begin();
+    while( it != Buckets.end() ) {
+        if( (it->second.NumOfRecords == 0) && (it->first.Period + 2*it->first.Length < now) ) {
+            it = Buckets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    Mutex.Unlock();
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatRollup::WriteRows(const std::vector<SRow>& rows)
+{
+    // errors are reported once per flush by the caller
+    if( Session->StartTransaction() == false ) {
+        Connected = false;
+        return(false);
+    }
+
+    for(size_t i=0; i < rows.size(); i++) {
+        SStatRollupRow row;
+        row.Length = rows[i].Key.Length;
+        row.Period = rows[i].Key.Period;
+        row.Site = rows[i].Key.Site;
+        row.ModuleName = rows[i].Key.ModuleName;
+        row.ModuleVers = rows[i].Key.ModuleVers;
+        row.ModuleArch = rows[i].Key.ModuleArch;
+        row.ModuleMode = rows[i].Key.ModuleMode;
+        row.NumOfRecords = rows[i].NumOfRecords;
+        row.NumOfUsers = rows[i].NumOfUsers;
+        row.NumOfHosts = rows[i].NumOfHosts;
+
+        if( Session->MergeRollup(row) == false ) {
+            Session->RollbackTransaction();
+            return(false);
+        }
+    }
+
+    if( Session->CommitTransaction() == false ) {
+        Session->RollbackTransaction();
+        return(false);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatRollup::OpenSession(void)
+{
+    // silent - it is repeated by each reconnect attempt, callers report it
+    Session = Storage->CreateSession();
+    if( Session == NULL ) return(false);
+
+    return(Session->PrepareRollup());
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatRollup::Reconnect(void)
+{
+    // the session of the lost connection cannot be used anymore
+    if( Session != NULL ) delete Session;
+    Session = NULL;
+
+    if( OpenSession() == false ) return(false);
+
+    Connected = true;
+    return(true);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+size_t CStatRollup::GetNumOfBuckets(void)
+{
+    Mutex.Lock();
+    size_t size = Buckets.size();
+    Mutex.Unlock();
+    return(size);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatRollup::GetNumOfFlushedRows(void)
+{
+    return(NumOfFlushedRows);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatRollup::GetNumOfFailedFlushes(void)
+{
+    return(NumOfFailedFlushes);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
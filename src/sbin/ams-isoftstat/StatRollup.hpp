@@ -0,0 +1,163 @@
+#ifndef StatRollupH
+#define StatRollupH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include <SimpleMutex.hpp>
+#include <SmallThread.hpp>
+#include "StatStorage.hpp"
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <vector>
+#include <time.h>
+
+//------------------------------------------------------------------------------
+
+/// committed record as seen by the rollup (key ids)
+struct SStatRollupRecord {
+    time_t  Time;
+    int     Site;
+    int     ModuleName;
+    int     ModuleVers;
+    int     ModuleArch;
+    int     ModuleMode;
+    int     User;
+    int     HostName;
+};
+
+//------------------------------------------------------------------------------
+
+/// hourly and daily counters of committed records
+/*! records are aggregated in memory by period, site, module name, version,
+    arch and mode together with the sets of distinct users and hosts,
+    the counters are merged into STATISTICS_HOURLY and STATISTICS_DAILY
+    tables of the storage by the rollup thread when the main thread requests
+    it and when the rollup is shut down, buckets of closed
+    periods are released once their counters are written, distinct counts
+    are exact unless the server was restarted within the period or a record
+    arrived after its bucket was released, in such a case the larger value
+    is kept (see doc/firebird.txt)
+*/
+
+class CStatRollup : public CSmallThread {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatRollup(void);
+    ~CStatRollup(void);
+
+// setup methods ---------------------------------------------------------------
+    //! open storage session and prepare statements
+    bool InitRollup(CStatStorage* p_storage);
+
+    //! release storage session
+    void CloseRollup(void);
+
+    //! request termination, counters are flushed before the thread exits
+    void ShutdownRollup(void);
+
+// executive methods -----------------------------------------------------------
+    //! add committed records (writer threads)
+    void Add(const std::vector<SStatRollupRecord>& records);
+
+    //! request merge of counters into database (main thread)
+    void RequestFlush(void);
+
+// information methods ---------------------------------------------------------
+    //! number of buckets in memory
+    size_t GetNumOfBuckets(void);
+
+    //! number of rows merged into rollup tables
+    long int GetNumOfFlushedRows(void);
+
+    //! number of flushes that failed
+    long int GetNumOfFailedFlushes(void);
+
+// section of private data -----------------------------------------------------
+private:
+    struct SKey {
+        int     Length;     // period length (s)
+        time_t  Period;     // period start (s)
+        int     Site;
+        int     ModuleName;
+        int     ModuleVers;
+        int     ModuleArch;
+        int     ModuleMode;
+
+        bool operator == (const SKey& right) const;
+    };
+
+    struct SKeyHash {
+        size_t operator () (const SKey& key) const;
+    };
+
+    struct SBucket {
+        long int                    NumOfRecords;   // not flushed yet
+        boost::unordered_set<int>   Users;
+        boost::unordered_set<int>   Hosts;
+    };
+
+    struct SRow {
+        SKey        Key;
+        long int    NumOfRecords;
+        int         NumOfUsers;
+        int         NumOfHosts;
+    };
+
+    typedef boost::unordered_map<SKey,SBucket,SKeyHash> TBuckets;
+
+    CSimpleMutex            Mutex;
+    TBuckets                Buckets;
+    CStatStorage*           Storage;
+    CStatStorageSession*    Session;
+    bool                    Connected;
+    volatile bool           Terminated;
+    volatile bool           FlushRequested;
+
+    // statistics
+    long int                NumOfFlushedRows;
+    long int                NumOfFailedFlushes;
+
+    //! flush loop
+    virtual void ExecuteThread(void);
+
+    //! merge counters into database
+    bool Flush(void);
+
+    //! add record to the bucket of given period length
+    void AddRecord(int length,const SStatRollupRecord& record);
+
+    //! write rows in one transaction
+    bool WriteRows(const std::vector<SRow>& rows);
+
+    //! release written buckets of closed periods
+    void ReleaseBuckets(time_t now);
+
+    //! create storage session and prepare statements
+    bool OpenSession(void);
+
+    //! open new session after the connection was lost
+    bool Reconnect(void);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,486 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include "StatSQLiteStorage.hpp"
+#include <ErrorSystem.hpp>
+
+//------------------------------------------------------------------------------
+
+// number of parameters of one STATISTICS row
+#define STAT_SQLITE_ROW_ITEMS 14
+
+// how long a connection waits for the database lock (ms)
+#define STAT_SQLITE_BUSY_TIMEOUT 10000
+
+// column list of STATISTICS insert
+#define STAT_SQLITE_COLUMNS \
+    "\"Site\",\"ModuleName\",\"ModuleVers\",\"ModuleArch\",\"ModuleMode\",\"User\",\"HostName\"," \
+    "\"NCPUS\",\"NHostCPUS\",\"NGPUS\",\"NHostGPUS\",\"NNODES\",\"Flags\",\"Time\""
+
+// values of one STATISTICS row, time is stored as text in local time
+#define STAT_SQLITE_VALUES \
+    "(?,?,?,?,?,?,?,?,?,?,?,?,?,datetime(?,'unixepoch','localtime'))"
+
+// schema of the database, the same tables as in init.fb
+static const char* SQLiteSchema[] = {
+    "CREATE TABLE IF NOT EXISTS \"KEYS\" ("
+        "\"ID\" INTEGER PRIMARY KEY,"
+        "\"Key\" TEXT NOT NULL UNIQUE)",
+    "CREATE TABLE IF NOT EXISTS \"STATISTICS\" ("
+        "\"Site\" INTEGER,\"ModuleName\" INTEGER,\"ModuleVers\" INTEGER,"
+        "\"ModuleArch\" INTEGER,\"ModuleMode\" INTEGER,\"User\" INTEGER,"
+        "\"HostName\" INTEGER,\"NCPUS\" INTEGER,\"NHostCPUS\" INTEGER,"
+        "\"NGPUS\" INTEGER,\"NHostGPUS\" INTEGER,\"NNODES\" INTEGER,"
+        "\"Flags\" INTEGER,\"Time\" TEXT)",
+    "CREATE TABLE IF NOT EXISTS \"STATISTICS_HOURLY\" ("
+        "\"Period\" TEXT NOT NULL,\"Site\" INTEGER NOT NULL,\"ModuleName\" INTEGER NOT NULL,"
+        "\"ModuleVers\" INTEGER NOT NULL,\"ModuleArch\" INTEGER NOT NULL,"
+        "\"ModuleMode\" INTEGER NOT NULL,\"NumOfRecords\" INTEGER,"
+        "\"NumOfUsers\" INTEGER,\"NumOfHosts\" INTEGER,"
+        "PRIMARY KEY (\"Period\",\"Site\",\"ModuleName\",\"ModuleVers\",\"ModuleArch\",\"ModuleMode\"))",
+    "CREATE TABLE IF NOT EXISTS \"STATISTICS_DAILY\" ("
+        "\"Period\" TEXT NOT NULL,\"Site\" INTEGER NOT NULL,\"ModuleName\" INTEGER NOT NULL,"
+        "\"ModuleVers\" INTEGER NOT NULL,\"ModuleArch\" INTEGER NOT NULL,"
+        "\"ModuleMode\" INTEGER NOT NULL,\"NumOfRecords\" INTEGER,"
+        "\"NumOfUsers\" INTEGER,\"NumOfHosts\" INTEGER,"
+        "PRIMARY KEY (\"Period\",\"Site\",\"ModuleName\",\"ModuleVers\",\"ModuleArch\",\"ModuleMode\"))",
+    NULL
+};
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatSQLiteSession::CStatSQLiteSession(sqlite3* p_db)
+{
+    Database = p_db;
+    InsertStmt = NULL;
+    BlockStmt = NULL;
+    BlockRows = 1;
+    HourlyStmt = NULL;
+    DailyStmt = NULL;
+    CountStmt = NULL;
+}
+
+//------------------------------------------------------------------------------
+
+CStatSQLiteSession::~CStatSQLiteSession(void)
+{
+    // finalizing NULL statement is harmless
+    sqlite3_finalize(InsertStmt);
+    sqlite3_finalize(BlockStmt);
+    sqlite3_finalize(HourlyStmt);
+    sqlite3_finalize(DailyStmt);
+    sqlite3_finalize(CountStmt);
+    sqlite3_close(Database);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatSQLiteSession::PrepareInsert(int& block_rows)
+{
+    // silent - it is repeated by each reconnect attempt, callers report it
+    CSmallString sql;
+
+    sql = "INSERT INTO \"STATISTICS\" (" STAT_SQLITE_COLUMNS ") VALUES " STAT_SQLITE_VALUES;
+
+    if( sqlite3_prepare_v2(Database,sql,-1,&InsertStmt,NULL) != SQLITE_OK ) return(false);
+
+    // multi-row insert - block_rows rows by one statement
+    if( block_rows > STORAGE_MAX_BLOCK_ROWS ) block_rows = STORAGE_MAX_BLOCK_ROWS;
+    if( block_rows > 1 ) {
+        sql = "INSERT INTO \"STATISTICS\" (" STAT_SQLITE_COLUMNS ") VALUES ";
+        for(int r=0; r < block_rows; r++) {
+            if( r > 0 ) sql << ",";
+            sql << STAT_SQLITE_VALUES;
+        }
+
+        // single-row inserts are still available
+        if( sqlite3_prepare_v2(Database,sql,-1,&BlockStmt,NULL) != SQLITE_OK ) block_rows = 1;
+    }
+    BlockRows = block_rows;
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSQLiteSession::PrepareRollup(void)
+{
+    // counters are added, distinct counts are kept at maximum
+    // silent - it is repeated by each reconnect attempt, callers report it
+    const char* p_tables[2] = { "STATISTICS_HOURLY", "STATISTICS_DAILY" };
+    sqlite3_stmt** p_stmts[2] = { &HourlyStmt, &DailyStmt };
+
+    for(int i=0; i < 2; i++) {
+        CSmallString sql;
+        sql << "INSERT INTO \"" << p_tables[i] << "\" (\"Period\",\"Site\",\"ModuleName\","
+               "\"ModuleVers\",\"ModuleArch\",\"ModuleMode\",\"NumOfRecords\",\"NumOfUsers\","
+               "\"NumOfHosts\") VALUES(datetime(?,'unixepoch'),?,?,?,?,?,?,?,?) "
+               "ON CONFLICT (\"Period\",\"Site\",\"ModuleName\",\"ModuleVers\",\"ModuleArch\","
+               "\"ModuleMode\") DO UPDATE SET "
+               "\"NumOfRecords\" = \"NumOfRecords\" + excluded.\"NumOfRecords\","
+               "\"NumOfUsers\" = MAX(\"NumOfUsers\",excluded.\"NumOfUsers\"),"
+               "\"NumOfHosts\" = MAX(\"NumOfHosts\",excluded.\"NumOfHosts\")";
+
+        if( sqlite3_prepare_v2(Database,sql,-1,p_stmts[i],NULL) != SQLITE_OK ) return(false);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSQLiteSession::PrepareCount(void)
+{
+    CSmallString sql;
+
+    sql = "SELECT COUNT(*) FROM \"STATISTICS\" s JOIN \"KEYS\" k ON s.\"Site\" = k.\"ID\" "
+          "WHERE k.\"Key\" = ?";
+
+    // reported by the caller
+    if( sqlite3_prepare_v2(Database,sql,-1,&CountStmt,NULL) != SQLITE_OK ) return(false);
+
+    return(true);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatSQLiteSession::StartTransaction(void)
+{
+    // take the write lock now, deferred upgrade could fail with SQLITE_BUSY
+    // in the middle of the transaction
+    // per-batch errors are silent, the writer reports them
+    return(sqlite3_exec(Database,"BEGIN IMMEDIATE",NULL,NULL,NULL) == SQLITE_OK);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSQLiteSession::CommitTransaction(void)
+{
+    return(sqlite3_exec(Database,"COMMIT",NULL,NULL,NULL) == SQLITE_OK);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSQLiteSession::RollbackTransaction(void)
+{
+    // the transaction can be already rolled back by the failed statement
+    if( sqlite3_get_autocommit(Database) != 0 ) return(true);
+
+    return(sqlite3_exec(Database,"ROLLBACK",NULL,NULL,NULL) == SQLITE_OK);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSQLiteSession::InsertRecord(const SStatRecord& record)
+{
+    BindRow(InsertStmt,1,record);
+
+    int rc = sqlite3_step(InsertStmt);
+    sqlite3_reset(InsertStmt);
+
+    return(rc == SQLITE_DONE);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSQLiteSession::InsertBlock(const SStatRecord* p_records)
+{
+    for(int r=0; r < BlockRows; r++) {
+        BindRow(BlockStmt,r*STAT_SQLITE_ROW_ITEMS+1,p_records[r]);
+    }
+
+    int rc = sqlite3_step(BlockStmt);
+    sqlite3_reset(BlockStmt);
+
+    return(rc == SQLITE_DONE);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSQLiteSession::MergeRollup(const SStatRollupRow& row)
+{
+    sqlite3_stmt* p_stmt = row.Length == ROLLUP_HOUR ? HourlyStmt : DailyStmt;
+
+    sqlite3_bind_int64(p_stmt,1,row.Period);
+    sqlite3_bind_int(p_stmt,2,row.Site);
+    sqlite3_bind_int(p_stmt,3,row.ModuleName);
+    sqlite3_bind_int(p_stmt,4,row.ModuleVers);
+    sqlite3_bind_int(p_stmt,5,row.ModuleArch);
+    sqlite3_bind_int(p_stmt,6,row.ModuleMode);
+    sqlite3_bind_int64(p_stmt,7,row.NumOfRecords);
+    sqlite3_bind_int(p_stmt,8,row.NumOfUsers);
+    sqlite3_bind_int(p_stmt,9,row.NumOfHosts);
+
+    int rc = sqlite3_step(p_stmt);
+    sqlite3_reset(p_stmt);
+
+    return(rc == SQLITE_DONE);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatSQLiteSession::CountRecords(const CSmallString& site)
+{
+    // autocommit - each count sees recent commits
+    sqlite3_bind_text(CountStmt,1,site,-1,SQLITE_TRANSIENT);
+
+    long int count = -1;
+    if( sqlite3_step(CountStmt) == SQLITE_ROW ) {
+        count = sqlite3_column_int64(CountStmt,0);
+    } else {
+        CStatSQLiteStorage::PrintError(Database,"unable to count STATISTICS rows");
+    }
+    sqlite3_reset(CountStmt);
+
+    return(count);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatSQLiteSession::BindRow(sqlite3_stmt* p_stmt,int first,const SStatRecord& record)
+{
+    for(int i=0; i < STORAGE_NUM_OF_KEYS; i++) {
+        sqlite3_bind_int(p_stmt,first+i,record.Keys[i]);
+    }
+    sqlite3_bind_int(p_stmt,first+7,record.NCPUs);
+    sqlite3_bind_int(p_stmt,first+8,record.NHostCPUs);
+    sqlite3_bind_int(p_stmt,first+9,record.NGPUs);
+    sqlite3_bind_int(p_stmt,first+10,record.NHostGPUs);
+    sqlite3_bind_int(p_stmt,first+11,record.NNodes);
+    sqlite3_bind_int(p_stmt,first+12,record.Flags);
+    sqlite3_bind_int64(p_stmt,first+13,record.Time.GetSecondsFromBeginning());
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatSQLiteStorage::CStatSQLiteStorage(void)
+{
+    KeyDatabase = NULL;
+    KeySelectStmt = NULL;
+    KeyInsertStmt = NULL;
+}
+
+//------------------------------------------------------------------------------
+
+CStatSQLiteStorage::~CStatSQLiteStorage(void)
+{
+    Close();
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSQLiteStorage::Open(const CSmallString& name,const CSmallString& /*user*/,
+                              const CSmallString& /*password*/)
+{
+    // the database is a local file, no credentials are needed
+    Name = name;
+
+    KeyDatabase = OpenConnection();
+    if( KeyDatabase == NULL ) {
+        CSmallString error;
+        error << "unable to open database '" << Name << "'";
+        ES_ERROR(error);
+        return(false);
+    }
+
+    if( CreateSchema() == false ) {
+        ES_ERROR("unable to create the database schema");
+        return(false);
+    }
+
+    if( sqlite3_prepare_v2(KeyDatabase,"SELECT \"ID\" FROM \"KEYS\" WHERE \"Key\" = ?",
+                           -1,&KeySelectStmt,NULL) != SQLITE_OK ) {
+        PrintError(KeyDatabase,"unable to prepare KEYS query");
+        return(false);
+    }
+
+    if( sqlite3_prepare_v2(KeyDatabase,"INSERT INTO \"KEYS\" (\"Key\") VALUES(?)",
+                           -1,&KeyInsertStmt,NULL) != SQLITE_OK ) {
+        PrintError(KeyDatabase,"unable to prepare KEYS insert");
+        return(false);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatSQLiteStorage::Close(void)
+{
+    sqlite3_finalize(KeySelectStmt);
+    KeySelectStmt = NULL;
+    sqlite3_finalize(KeyInsertStmt);
+    KeyInsertStmt = NULL;
+    sqlite3_close(KeyDatabase);
+    KeyDatabase = NULL;
+}
+
+//------------------------------------------------------------------------------
+
+CStatStorageSession* CStatSQLiteStorage::CreateSession(void)
+{
+    // each session has its own connection, they cannot be shared by threads
+    sqlite3* p_db = OpenConnection();
+    if( p_db == NULL ) return(NULL);
+    return(new CStatSQLiteSession(p_db));
+}
+
+//------------------------------------------------------------------------------
+
+sqlite3* CStatSQLiteStorage::OpenConnection(void)
+{
+    sqlite3* p_db = NULL;
+
+    // silent - sessions are opened by each reconnect attempt, callers report it
+    if( sqlite3_open_v2(Name,&p_db,SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE,NULL) != SQLITE_OK ) {
+        sqlite3_close(p_db);
+        return(NULL);
+    }
+
+    sqlite3_busy_timeout(p_db,STAT_SQLITE_BUSY_TIMEOUT);
+
+    // WAL - readers do not block the writer, commits are sequential appends,
+    // NORMAL synchronization is safe in WAL mode, only the last commits
+    // can be lost by a power failure
+    if( (sqlite3_exec(p_db,"PRAGMA journal_mode=WAL",NULL,NULL,NULL) != SQLITE_OK) ||
+        (sqlite3_exec(p_db,"PRAGMA synchronous=NORMAL",NULL,NULL,NULL) != SQLITE_OK) ) {
+        sqlite3_close(p_db);
+        return(NULL);
+    }
+
+    return(p_db);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSQLiteStorage::CreateSchema(void)
+{
+    for(int i=0; SQLiteSchema[i] != NULL; i++) {
+        if( sqlite3_exec(KeyDatabase,SQLiteSchema[i],NULL,NULL,NULL) != SQLITE_OK ) {
+            PrintError(KeyDatabase,"unable to create table");
+            return(false);
+        }
+    }
+    return(true);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatSQLiteStorage::LoadKeys(CStatKeyCache& cache)
+{
+    cache.Clear();
+
+    sqlite3_stmt* p_stmt = NULL;
+    if( sqlite3_prepare_v2(KeyDatabase,"SELECT \"ID\",\"Key\" FROM \"KEYS\"",
+                           -1,&p_stmt,NULL) != SQLITE_OK ) {
+        PrintError(KeyDatabase,"unable to prepare sql query");
+        return(false);
+    }
+
+    int rc;
+    while( (rc = sqlite3_step(p_stmt)) == SQLITE_ROW ) {
+        int id = sqlite3_column_int(p_stmt,0);
+        if( cache.Add((const char*)sqlite3_column_text(p_stmt,1),id) == false ) break;
+    }
+
+    if( (rc != SQLITE_ROW) && (rc != SQLITE_DONE) ) {
+        PrintError(KeyDatabase,"unable to execute sql query");
+        sqlite3_finalize(p_stmt);
+        return(false);
+    }
+
+    sqlite3_finalize(p_stmt);
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+int CStatSQLiteStorage::CreateKey(const CSmallString& key)
+{
+    // autocommit - new keys are committed immediately, thus a cached key id
+    // is never invalidated by rollback of the datagram transaction,
+    // errors are reported by the caller
+
+    // find key id, it can be in the database if the cache is full
+    sqlite3_bind_text(KeySelectStmt,1,key,-1,SQLITE_TRANSIENT);
+
+    int id = -1;
+    int rc = sqlite3_step(KeySelectStmt);
+    if( rc == SQLITE_ROW ) {
+        id = sqlite3_column_int(KeySelectStmt,0);
+    }
+    sqlite3_reset(KeySelectStmt);
+
+    if( rc == SQLITE_ROW ) return(id);
+    if( rc != SQLITE_DONE ) return(-1);
+
+    // create new key
+    sqlite3_bind_text(KeyInsertStmt,1,key,-1,SQLITE_TRANSIENT);
+
+    rc = sqlite3_step(KeyInsertStmt);
+    sqlite3_reset(KeyInsertStmt);
+
+    if( rc != SQLITE_DONE ) return(-1);
+
+    return(sqlite3_last_insert_rowid(KeyDatabase));
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSQLiteStorage::Reconnect(void)
+{
+    // the database is a local file, its connection cannot be lost
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSQLiteStorage::IsConnected(void)
+{
+    return(true);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatSQLiteStorage::PrintError(sqlite3* p_db,const char* p_action)
+{
+    CSmallString error;
+    error << p_action;
+    if( p_db != NULL ) error << " (" << sqlite3_errmsg(p_db) << ")";
+    ES_ERROR(error);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
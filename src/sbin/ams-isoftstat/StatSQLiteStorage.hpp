@@ -0,0 +1,110 @@
+#ifndef StatSQLiteStorageH
+#define StatSQLiteStorageH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <sqlite3.h>
+#include "StatStorage.hpp"
+
+//------------------------------------------------------------------------------
+
+/// SQLite session - each session has its own connection to the database file
+
+class CStatSQLiteSession : public CStatStorageSession {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatSQLiteSession(sqlite3* p_db);
+    ~CStatSQLiteSession(void);
+
+// setup methods ---------------------------------------------------------------
+    virtual bool PrepareInsert(int& block_rows);
+    virtual bool PrepareRollup(void);
+    virtual bool PrepareCount(void);
+
+// executive methods -----------------------------------------------------------
+    virtual bool StartTransaction(void);
+    virtual bool CommitTransaction(void);
+    virtual bool RollbackTransaction(void);
+    virtual bool InsertRecord(const SStatRecord& record);
+    virtual bool InsertBlock(const SStatRecord* p_records);
+    virtual bool MergeRollup(const SStatRollupRow& row);
+    virtual long int CountRecords(const CSmallString& site);
+
+// section of private data -----------------------------------------------------
+private:
+    sqlite3*        Database;
+    sqlite3_stmt*   InsertStmt;
+    sqlite3_stmt*   BlockStmt;
+    int             BlockRows;
+    sqlite3_stmt*   HourlyStmt;
+    sqlite3_stmt*   DailyStmt;
+    sqlite3_stmt*   CountStmt;
+
+    //! bind parameters of one STATISTICS row starting at the parameter first
+    static void BindRow(sqlite3_stmt* p_stmt,int first,const SStatRecord& record);
+};
+
+//------------------------------------------------------------------------------
+
+/// embedded SQLite storage in WAL mode
+/*! the schema is created when the database file is opened for the first time,
+    writers are serialized by the database lock, readers are not blocked
+*/
+
+class CStatSQLiteStorage : public CStatStorage {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatSQLiteStorage(void);
+    ~CStatSQLiteStorage(void);
+
+// setup methods ---------------------------------------------------------------
+    virtual bool Open(const CSmallString& name,const CSmallString& user,
+                      const CSmallString& password);
+    virtual void Close(void);
+    virtual CStatStorageSession* CreateSession(void);
+
+// executive methods -----------------------------------------------------------
+    virtual bool LoadKeys(CStatKeyCache& cache);
+    virtual int CreateKey(const CSmallString& key);
+    virtual bool Reconnect(void);
+    virtual bool IsConnected(void);
+
+// information methods ---------------------------------------------------------
+    //! print the last error of the connection
+    static void PrintError(sqlite3* p_db,const char* p_action);
+
+// section of private data -----------------------------------------------------
+private:
+    CSmallString    Name;
+    sqlite3*        KeyDatabase;
+    sqlite3_stmt*   KeySelectStmt;
+    sqlite3_stmt*   KeyInsertStmt;
+
+    //! open new connection to the database file
+    sqlite3* OpenConnection(void);
+
+    //! create tables if they do not exist
+    bool CreateSchema(void);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
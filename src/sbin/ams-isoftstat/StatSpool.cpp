@@ -0,0 +1,511 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include "StatSpool.hpp"
+#include <ErrorSystem.hpp>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+
+//------------------------------------------------------------------------------
+
+// record is complete
+#define SPOOL_MAGIC         0x53545350
+
+// record header
+struct SSpoolHeader {
+    uint32_t    Magic;
+    uint32_t    Size;
+};
+
+// record size aligned to 8 bytes
+#define SPOOL_RECORD_SIZE   ((sizeof(SSpoolHeader) + sizeof(CAddStatDatagram) + 7) & ~((size_t)7))
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatSpool::CStatSpool(void)
+{
+    SegmentSize = 0;
+    Capacity = 0;
+    Limit = 0;
+    MaxSegments = 0;
+
+    WriteSeg.Number = -1;
+    WriteSeg.FD = -1;
+    WriteSeg.Data = NULL;
+    WriteRec = 0;
+
+    ReadSeg.Number = -1;
+    ReadSeg.FD = -1;
+    ReadSeg.Data = NULL;
+    ReadRec = 0;
+    PendingGap = 0;
+
+    CheckSeg = 0;
+    CheckRec = 0;
+
+    NumOfAppended = 0;
+    NumOfCommitted = 0;
+    NumOfFailed = 0;
+    NumOfOverflows = 0;
+    NumOfDamaged = 0;
+}
+
+//------------------------------------------------------------------------------
+
+CStatSpool::~CStatSpool(void)
+{
+    Close();
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatSpool::SetLimit(size_t limit)
+{
+    Limit = limit;
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSpool::Open(const CFileName& dir,size_t segment_size)
+{
+    Dir = dir;
+    SegmentSize = segment_size;
+    Capacity = SegmentSize / SPOOL_RECORD_SIZE;
+
+    if( Capacity < 1 ) {
+        ES_ERROR("spool segment is too small");
+        return(false);
+    }
+
+    // at least one segment is always kept
+    MaxSegments = 0;
+    if( Limit > 0 ) {
+        MaxSegments = Limit / SegmentSize;
+        if( MaxSegments < 1 ) MaxSegments = 1;
+    }
+
+    if( (mkdir(Dir,0700) != 0) && (errno != EEXIST) ) {
+        CSmallString error;
+        error << "unable to create spool directory '" << Dir << "' (" << strerror(errno) << ")";
+        ES_ERROR(error);
+        return(false);
+    }
+
+    // find existing segments
+    long int first_seg = -1;
+    long int last_seg = -1;
+
+    DIR* p_dir = opendir(Dir);
+    if( p_dir == NULL ) {
+        CSmallString error;
+        error << "unable to open spool directory '" << Dir << "'";
+        ES_ERROR(error);
+        return(false);
+    }
+
+    struct dirent* p_entry;
+    while( (p_entry = readdir(p_dir)) != NULL ) {
+        if( strncmp(p_entry->d_name,"spool.",6) != 0 ) continue;
+        char* p_end = NULL;
+        long int number = strtol(p_entry->d_name + 6,&p_end,10);
+        if( (p_end == p_entry->d_name + 6) || (*p_end != '\0') ) continue;
+        if( (first_seg < 0) || (number < first_seg) ) first_seg = number;
+        if( number > last_seg ) last_seg = number;
+    }
+    closedir(p_dir);
+
+    // resume from the checkpoint
+    if( LoadCheckpoint() == false ) {
+        CheckSeg = first_seg >= 0 ? first_seg : 0;
+        CheckRec = 0;
+    }
+    if( (first_seg >= 0) && (CheckSeg < first_seg) ) {
+        CheckSeg = first_seg;
+        CheckRec = 0;
+    }
+    if( last_seg < CheckSeg ) last_seg = CheckSeg;
+
+    // remove committed segments
+    for(long int i = first_seg; (i >= 0) && (i < CheckSeg); i++) {
+        unlink(GetSegmentName(i));
+    }
+
+    // append position - end of the last segment
+    if( MapSegment(WriteSeg,last_seg) == false ) return(false);
+    WriteRec = 0;
+    while( (WriteRec < Capacity) && IsRecordValid(WriteSeg,WriteRec) ) WriteRec++;
+
+    // read position - checkpoint
+    if( MapSegment(ReadSeg,CheckSeg) == false ) return(false);
+    ReadRec = CheckRec;
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatSpool::Close(void)
+{
+    if( WriteSeg.Data != NULL ) msync(WriteSeg.Data,SegmentSize,MS_SYNC);
+    UnmapSegment(WriteSeg);
+    UnmapSegment(ReadSeg);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatSpool::Append(const CAddStatDatagram& datagram)
+{
+    Mutex.Lock();
+
+    // rotate segment
+    if( WriteRec >= Capacity ) {
+        long int number = WriteSeg.Number + 1;
+
+        // the limit counts segments from the checkpoint, the spool is full
+        // until the writer commits the oldest segment
+        if( (MaxSegments > 0) && (number - CheckSeg >= MaxSegments) ) {
+            NumOfOverflows++;
+            Mutex.Unlock();
+            return(false);
+        }
+
+        // the full segment is made durable before the next one is used
+        if( WriteSeg.Data != NULL ) msync(WriteSeg.Data,SegmentSize,MS_SYNC);
+        UnmapSegment(WriteSeg);
+        if( MapSegment(WriteSeg,number) == false ) {
+            // keep the position so that the next append retries the same segment
+            WriteSeg.Number = number - 1;
+            NumOfFailed++;
+            Mutex.Unlock();
+            return(false);
+        }
+        WriteRec = 0;
+    }
+
+    // payload first, magic last - incomplete records are ignored after crash
+    unsigned char*  p_rec = GetRecord(WriteSeg,WriteRec);
+    uint32_t        magic = SPOOL_MAGIC;
+    uint32_t        size = sizeof(CAddStatDatagram);
+
+    memcpy(p_rec + sizeof(SSpoolHeader),&datagram,sizeof(CAddStatDatagram));
+    memcpy(p_rec + sizeof(uint32_t),&size,sizeof(uint32_t));
+    __sync_synchronize();
+    memcpy(p_rec,&magic,sizeof(uint32_t));
+
+    WriteRec++;
+    NumOfAppended++;
+
+    Mutex.Unlock();
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSpool::HasRoom(long int nrecs)
+{
+    if( MaxSegments == 0 ) return(true);
+
+    Mutex.Lock();
+    long int used = (WriteSeg.Number - CheckSeg)*Capacity + WriteRec;
+    bool room = used + nrecs <= MaxSegments*Capacity;
+    Mutex.Unlock();
+
+    return(room);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSpool::Read(CAddStatDatagram& datagram)
+{
+    Mutex.Lock();
+    long int write_seg = WriteSeg.Number;
+    long int write_rec = WriteRec;
+    Mutex.Unlock();
+
+    for(;;) {
+        if( (ReadSeg.Number == write_seg) && (ReadRec >= write_rec) ) return(false);
+
+        // move to the next segment
+        if( ReadRec >= Capacity ) {
+            long int number = ReadSeg.Number + 1;
+            UnmapSegment(ReadSeg);
+            if( MapSegment(ReadSeg,number) == false ) {
+                ReadSeg.Number = number - 1;
+                return(false);
+            }
+            ReadRec = 0;
+            continue;
+        }
+
+        if( IsRecordValid(ReadSeg,ReadRec) == false ) {
+            // damaged record - skip it, the checkpoint moves past it
+            // together with the next committed record
+            ES_ERROR("damaged spool record");
+            NumOfDamaged++;
+            PendingGap++;
+            ReadRec++;
+            continue;
+        }
+
+        memcpy(&datagram,GetRecord(ReadSeg,ReadRec) + sizeof(SSpoolHeader),sizeof(CAddStatDatagram));
+        ReadRec++;
+        ReadGaps.push_back(PendingGap);
+        PendingGap = 0;
+        return(true);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSpool::Commit(long int nrecs)
+{
+    if( nrecs <= 0 ) return(true);
+
+    // skipped damaged records are committed with the records that follow
+    // them, trailing ones once all read records are committed
+    long int nslots = nrecs;
+    for(long int i=0; (i < nrecs) && (ReadGaps.empty() == false); i++) {
+        nslots += ReadGaps.front();
+        ReadGaps.pop_front();
+    }
+    if( ReadGaps.empty() ) {
+        nslots += PendingGap;
+        PendingGap = 0;
+    }
+
+    Mutex.Lock();
+
+    long int first_seg = CheckSeg;
+    CheckRec += nslots;
+    while( CheckRec >= Capacity ) {
+        CheckRec -= Capacity;
+        CheckSeg++;
+    }
+    NumOfCommitted += nrecs;
+
+    Mutex.Unlock();
+
+    bool result = SaveCheckpoint();
+
+    // remove fully committed segments
+    for(long int i = first_seg; i < CheckSeg; i++) {
+        unlink(GetSegmentName(i));
+    }
+
+    return(result);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+const CFileName CStatSpool::GetSegmentName(long int number)
+{
+    char name[32];
+    snprintf(name,sizeof(name),"spool.%08ld",number);
+    return(Dir / CFileName(name));
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSpool::MapSegment(SSegment& seg,long int number)
+{
+    CFileName name = GetSegmentName(number);
+
+    seg.FD = open(name,O_RDWR|O_CREAT,0600);
+    if( seg.FD == -1 ) {
+        CSmallString error;
+        error << "unable to open spool segment '" << name << "' (" << strerror(errno) << ")";
+        ES_ERROR(error);
+        return(false);
+    }
+
+    // new segment is zero filled, i.e. it contains no records
+    struct stat st;
+    if( (fstat(seg.FD,&st) != 0) ||
+        ( ((size_t)st.st_size < SegmentSize) && (ftruncate(seg.FD,SegmentSize) != 0) ) ) {
+        CSmallString error;
+        error << "unable to resize spool segment '" << name << "' (" << strerror(errno) << ")";
+        ES_ERROR(error);
+        close(seg.FD);
+        seg.FD = -1;
+        return(false);
+    }
+
+    void* p_data = mmap(NULL,SegmentSize,PROT_READ|PROT_WRITE,MAP_SHARED,seg.FD,0);
+    if( p_data == MAP_FAILED ) {
+        CSmallString error;
+        error << "unable to map spool segment '" << name << "' (" << strerror(errno) << ")";
+        ES_ERROR(error);
+        close(seg.FD);
+        seg.FD = -1;
+        return(false);
+    }
+
+    seg.Data = (unsigned char*)p_data;
+    seg.Number = number;
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatSpool::UnmapSegment(SSegment& seg)
+{
+    if( seg.Data != NULL ) munmap(seg.Data,SegmentSize);
+    if( seg.FD != -1 ) close(seg.FD);
+    seg.Data = NULL;
+    seg.FD = -1;
+}
+
+//------------------------------------------------------------------------------
+
+unsigned char* CStatSpool::GetRecord(SSegment& seg,long int rec)
+{
+    return(seg.Data + rec*SPOOL_RECORD_SIZE);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSpool::IsRecordValid(SSegment& seg,long int rec)
+{
+    SSpoolHeader header;
+    memcpy(&header,GetRecord(seg,rec),sizeof(SSpoolHeader));
+    return( (header.Magic == SPOOL_MAGIC) && (header.Size == sizeof(CAddStatDatagram)) );
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSpool::SaveCheckpoint(void)
+{
+    CFileName name = Dir / "checkpoint";
+    CFileName tmp_name = Dir / "checkpoint.tmp";
+
+    FILE* p_fout = fopen(tmp_name,"w");
+    if( p_fout == NULL ) {
+        ES_ERROR("unable to save spool checkpoint");
+        return(false);
+    }
+    fprintf(p_fout,"%ld %ld\n",CheckSeg,CheckRec);
+    fflush(p_fout);
+    fsync(fileno(p_fout));
+    fclose(p_fout);
+
+    // atomic replace
+    if( rename(tmp_name,name) != 0 ) {
+        ES_ERROR("unable to save spool checkpoint");
+        return(false);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatSpool::LoadCheckpoint(void)
+{
+    CFileName name = Dir / "checkpoint";
+
+    FILE* p_fin = fopen(name,"r");
+    if( p_fin == NULL ) return(false);
+
+    long int seg = 0;
+    long int rec = 0;
+    bool result = fscanf(p_fin,"%ld %ld",&seg,&rec) == 2;
+    fclose(p_fin);
+
+    if( (result == false) || (seg < 0) || (rec < 0) || (rec >= Capacity) ) {
+        ES_ERROR("damaged spool checkpoint");
+        return(false);
+    }
+
+    CheckSeg = seg;
+    CheckRec = rec;
+
+    return(true);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+long int CStatSpool::GetBacklog(void)
+{
+    Mutex.Lock();
+    long int backlog = (WriteSeg.Number - CheckSeg)*Capacity + WriteRec - CheckRec;
+    Mutex.Unlock();
+    return(backlog);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatSpool::GetNumOfAppended(void)
+{
+    return(NumOfAppended);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatSpool::GetNumOfCommitted(void)
+{
+    return(NumOfCommitted);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatSpool::GetNumOfFailed(void)
+{
+    return(NumOfFailed);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatSpool::GetNumOfOverflows(void)
+{
+    return(NumOfOverflows);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatSpool::GetNumOfDamaged(void)
+{
+    return(NumOfDamaged);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
@@ -0,0 +1,149 @@
+#ifndef StatSpoolH
+#define StatSpoolH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <SoftStat.hpp>
+#include <FileName.hpp>
+#include <SimpleMutex.hpp>
+#include <deque>
+
+//------------------------------------------------------------------------------
+
+/// append-only write-ahead spool of accepted datagrams
+/*! the spool consists of memory mapped segments (spool.NNNNNNNN) with fixed
+    size records, the replay position is stored in the checkpoint file after
+    each commit and segments are removed once they are fully committed,
+    records are appended by the receivers and read by one writer,
+    a segment is synchronized to the disk when it is full - records
+    of the current segment survive a crash of the server but not
+    a crash of the system
+*/
+
+class CStatSpool {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatSpool(void);
+    ~CStatSpool(void);
+
+// setup methods ---------------------------------------------------------------
+    //! set the maximum size of spool segments on the disk (0 = unlimited)
+    void SetLimit(size_t limit);
+
+    //! open spool in the directory, resume from the checkpoint
+    bool Open(const CFileName& dir,size_t segment_size);
+
+    //! close spool
+    void Close(void);
+
+// executive methods -----------------------------------------------------------
+    //! append datagram (receiver threads)
+    bool Append(const CAddStatDatagram& datagram);
+
+    //! can nrecs records be appended without exceeding the limit?
+    bool HasRoom(long int nrecs);
+
+    //! read next datagram (writer thread), return false if nothing is spooled
+    bool Read(CAddStatDatagram& datagram);
+
+    //! move checkpoint by nrecs read records that were written to the database
+    bool Commit(long int nrecs);
+
+// information methods ---------------------------------------------------------
+    //! number of records waiting for commit
+    long int GetBacklog(void);
+
+    //! number of appended records
+    long int GetNumOfAppended(void);
+
+    //! number of committed records
+    long int GetNumOfCommitted(void);
+
+    //! number of records that could not be appended
+    long int GetNumOfFailed(void);
+
+    //! number of records rejected because the spool was full
+    long int GetNumOfOverflows(void);
+
+    //! number of damaged records skipped by the replay
+    long int GetNumOfDamaged(void);
+
+// section of private data -----------------------------------------------------
+private:
+    struct SSegment {
+        long int        Number;
+        int             FD;
+        unsigned char*  Data;
+    };
+
+    CSimpleMutex    Mutex;
+    CFileName       Dir;
+    size_t          SegmentSize;
+    long int        Capacity;       // records per segment
+    size_t          Limit;
+    long int        MaxSegments;    // 0 = unlimited
+
+    // append position
+    SSegment        WriteSeg;
+    long int        WriteRec;
+
+    // read position
+    SSegment        ReadSeg;
+    long int        ReadRec;
+    std::deque<int> ReadGaps;       // damaged records before each uncommitted read record
+    int             PendingGap;     // damaged records after the last read record
+
+    // checkpoint
+    long int        CheckSeg;
+    long int        CheckRec;
+
+    // statistics
+    long int        NumOfAppended;
+    long int        NumOfCommitted;
+    long int        NumOfFailed;
+    long int        NumOfOverflows;
+    long int        NumOfDamaged;
+
+    //! name of segment file
+    const CFileName GetSegmentName(long int number);
+
+    //! map segment
+    bool MapSegment(SSegment& seg,long int number);
+
+    //! unmap segment
+    void UnmapSegment(SSegment& seg);
+
+    //! record in the segment
+    unsigned char* GetRecord(SSegment& seg,long int rec);
+
+    //! is record complete?
+    bool IsRecordValid(SSegment& seg,long int rec);
+
+    //! save checkpoint file
+    bool SaveCheckpoint(void);
+
+    //! load checkpoint file
+    bool LoadCheckpoint(void);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef StatStorageH
+#define StatStorageH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <SmallString.hpp>
+#include <SmallTimeAndDate.hpp>
+#include "StatKeyCache.hpp"
+#include <time.h>
+
+//------------------------------------------------------------------------------
+
+// number of keys of one STATISTICS row
+#define STORAGE_NUM_OF_KEYS 7
+
+// maximum number of rows inserted by one block
+#define STORAGE_MAX_BLOCK_ROWS 64
+
+// rollup period lengths (s), periods are aligned to UTC
+#define ROLLUP_HOUR     3600
+#define ROLLUP_DAY      86400
+
+//------------------------------------------------------------------------------
+
+/// STATISTICS row with resolved keys
+struct SStatRecord {
+    int                 Keys[STORAGE_NUM_OF_KEYS];  // Site,ModuleName,ModuleVers,ModuleArch,
+                                                    // ModuleMode,User,HostName
+    int                 NCPUs;
+    int                 NHostCPUs;
+    int                 NGPUs;
+    int                 NHostGPUs;
+    int                 NNodes;
+    int                 Flags;
+    CSmallTimeAndDate   Time;
+};
+
+//------------------------------------------------------------------------------
+
+/// row of STATISTICS_HOURLY or STATISTICS_DAILY table
+struct SStatRollupRow {
+    int         Length;     // period length (s)
+    time_t      Period;     // period start (s)
+    int         Site;
+    int         ModuleName;
+    int         ModuleVers;
+    int         ModuleArch;
+    int         ModuleMode;
+    long int    NumOfRecords;
+    int         NumOfUsers;
+    int         NumOfHosts;
+};
+
+//------------------------------------------------------------------------------
+
+/// one connection or transaction context of the storage
+/*! each session is used by one thread only, the statements must be prepared
+    before the first transaction is started
+*/
+
+class CStatStorageSession {
+public:
+// constructor and destructors -------------------------------------------------
+    virtual ~CStatStorageSession(void);
+
+// setup methods ---------------------------------------------------------------
+    //! prepare STATISTICS inserts, block_rows is decreased if blocks are not supported
+    virtual bool PrepareInsert(int& block_rows) = 0;
+
+    //! prepare rollup merges
+    virtual bool PrepareRollup(void) = 0;
+
+    //! prepare the count of site records
+    virtual bool PrepareCount(void) = 0;
+
+// executive methods -----------------------------------------------------------
+    //! start transaction
+    virtual bool StartTransaction(void) = 0;
+
+    //! commit transaction
+    virtual bool CommitTransaction(void) = 0;
+
+    //! rollback transaction
+    virtual bool RollbackTransaction(void) = 0;
+
+    //! insert one STATISTICS row
+    virtual bool InsertRecord(const SStatRecord& record) = 0;
+
+    //! insert block_rows STATISTICS rows by one statement
+    virtual bool InsertBlock(const SStatRecord* p_records) = 0;
+
+    //! merge counters into rollup table, numbers of records are added
+    virtual bool MergeRollup(const SStatRollupRow& row) = 0;
+
+    //! return the number of STATISTICS rows of the site, -1 on error
+    virtual long int CountRecords(const CSmallString& site) = 0;
+};
+
+//------------------------------------------------------------------------------
+
+/// database holding KEYS, STATISTICS and rollup tables
+/*! keys are created by one thread at a time (the caller serializes
+    LoadKeys and CreateKey), the other work is done by sessions
+*/
+
+class CStatStorage {
+public:
+// constructor and destructors -------------------------------------------------
+    virtual ~CStatStorage(void);
+
+    //! create storage by the backend name, NULL if the backend is not known
+    static CStatStorage* Create(const CSmallString& backend);
+
+// setup methods ---------------------------------------------------------------
+    //! open database, user and password are ignored by embedded backends
+    virtual bool Open(const CSmallString& name,const CSmallString& user,
+                      const CSmallString& password) = 0;
+
+    //! close database, all sessions must be deleted before
+    virtual void Close(void) = 0;
+
+    //! create new session, NULL on error
+    virtual CStatStorageSession* CreateSession(void) = 0;
+
+// executive methods -----------------------------------------------------------
+    //! load all keys into the key cache
+    virtual bool LoadKeys(CStatKeyCache& cache) = 0;
+
+    //! find key in the database or create it, return -1 on error
+    virtual int CreateKey(const CSmallString& key) = 0;
+
+    //! open the key connection again after it was lost
+    virtual bool Reconnect(void) = 0;
+
+// information methods ---------------------------------------------------------
+    //! is the key connection alive? false once CreateKey found it lost
+    virtual bool IsConnected(void) = 0;
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
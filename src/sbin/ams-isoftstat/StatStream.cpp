@@ -0,0 +1,454 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include "StatStream.hpp"
+#include <ErrorSystem.hpp>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <zlib.h>
+
+//------------------------------------------------------------------------------
+
+#define STAT_STREAM_BATCH_MAGIC     0x414D5342  // "AMSB"
+#define STAT_STREAM_ACK_MAGIC       0x414D534B  // "AMSK"
+#define STAT_STREAM_BATCH_HEADER    5
+#define STAT_STREAM_ACK_HEADER      3
+#define STAT_STREAM_FLAG_COMPRESSED 0x01
+
+// size of one non-blocking read (bytes)
+#define STAT_STREAM_READ_SIZE       65536
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatStream::CStatStream(void)
+{
+    FD = -1;
+    InputStart = 0;
+    NumOfSentBytes = 0;
+    NumOfPayloadBytes = 0;
+}
+
+//------------------------------------------------------------------------------
+
+CStatStream::~CStatStream(void)
+{
+    Close();
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatStream::Connect(const CSmallString& host,int port,int timeout)
+{
+    Close();
+
+    struct addrinfo hints;
+    struct addrinfo* result;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    int s = getaddrinfo(host,CSmallString(port),&hints,&result);
+    if( s != 0 ) {
+        CSmallString error;
+        error << "getaddrinfo: " << gai_strerror(s);
+        ES_ERROR(error);
+        return(false);
+    }
+
+    struct addrinfo* rp;
+    for(rp = result; rp != NULL; rp = rp->ai_next) {
+        FD = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+        if( FD == -1 ) continue;
+        if( ConnectAddress(rp->ai_addr,rp->ai_addrlen,timeout) == true ) break;
+        close(FD);
+        FD = -1;
+    }
+    freeaddrinfo(result);
+
+    if( FD == -1 ) {
+        CSmallString error;
+        error << "unable to connect to " << host << ":" << port;
+        ES_ERROR(error);
+        return(false);
+    }
+
+    // the sender waits for acknowledgement of each batch
+    int on = 1;
+    setsockopt(FD,IPPROTO_TCP,TCP_NODELAY,&on,sizeof(on));
+    if( timeout > 0 ) SetTimeout(timeout);
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatStream::ConnectUnix(const CSmallString& path)
+{
+    Close();
+
+    struct sockaddr_un addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if( path.GetLength() >= sizeof(addr.sun_path) ) {
+        ES_ERROR("path of Unix socket is too long");
+        return(false);
+    }
+    strncpy(addr.sun_path,path,sizeof(addr.sun_path)-1);
+
+    FD = socket(AF_UNIX,SOCK_STREAM,0);
+    if( FD == -1 ) {
+        ES_ERROR("unable to create Unix socket");
+        return(false);
+    }
+
+    if( connect(FD,(struct sockaddr*)&addr,sizeof(addr)) != 0 ) {
+        close(FD);
+        FD = -1;
+        CSmallString error;
+        error << "unable to connect to " << path;
+        ES_ERROR(error);
+        return(false);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatStream::ConnectAddress(const struct sockaddr* p_addr,socklen_t addr_len,int timeout)
+{
+    if( timeout <= 0 ) return(connect(FD,p_addr,addr_len) == 0);
+
+    // non-blocking connect, SO_SNDTIMEO does not apply to it
+    int flags = fcntl(FD,F_GETFL,0);
+    if( (flags == -1) || (fcntl(FD,F_SETFL,flags | O_NONBLOCK) != 0) ) return(false);
+
+    bool result = connect(FD,p_addr,addr_len) == 0;
+    if( (result == false) && (errno == EINPROGRESS) ) {
+        struct pollfd pfd;
+        pfd.fd = FD;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        int ret;
+        while( ((ret = poll(&pfd,1,timeout)) < 0) && (errno == EINTR) );
+        if( ret > 0 ) {
+            int         error = 0;
+            socklen_t   len = sizeof(error);
+            result = (getsockopt(FD,SOL_SOCKET,SO_ERROR,&error,&len) == 0) && (error == 0);
+        }
+    }
+
+    if( fcntl(FD,F_SETFL,flags) != 0 ) return(false);
+    return(result);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatStream::Attach(int fd)
+{
+    Close();
+    FD = fd;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatStream::Close(void)
+{
+    if( FD != -1 ) close(FD);
+    FD = -1;
+    Input.clear();
+    InputStart = 0;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatStream::SetTimeout(int timeout)
+{
+    if( FD == -1 ) return;
+
+    struct timeval tv;
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    setsockopt(FD,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+    setsockopt(FD,SOL_SOCKET,SO_SNDTIMEO,&tv,sizeof(tv));
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatStream::SetNonBlocking(void)
+{
+    if( FD == -1 ) return(false);
+
+    int flags = fcntl(FD,F_GETFL,0);
+    if( flags == -1 ) return(false);
+    return(fcntl(FD,F_SETFL,flags | O_NONBLOCK) == 0);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatStream::WriteBatch(uint32_t seq,const std::vector<uint8_t>& payload,bool compress)
+{
+    // errors are reported by the caller
+    if( payload.size() > STAT_STREAM_MAX_PAYLOAD ) return(false);
+
+    const uint8_t*  p_data = payload.empty() ? NULL : &payload[0];
+    size_t          size = payload.size();
+    uint32_t        flags = 0;
+
+    if( compress && (size > 0) ) {
+        uLongf csize = compressBound(size);
+        Buffer.resize(csize);
+        if( compress2(&Buffer[0],&csize,p_data,size,Z_DEFAULT_COMPRESSION) != Z_OK ) return(false);
+        p_data = &Buffer[0];
+        size = csize;
+        flags |= STAT_STREAM_FLAG_COMPRESSED;
+    }
+
+    uint32_t header[STAT_STREAM_BATCH_HEADER];
+    header[0] = htonl(STAT_STREAM_BATCH_MAGIC);
+    header[1] = htonl(seq);
+    header[2] = htonl(flags);
+    header[3] = htonl(size);
+    header[4] = htonl(payload.size());
+
+    if( WriteAll(header,sizeof(header)) == false ) return(false);
+    if( (size > 0) && (WriteAll(p_data,size) == false) ) return(false);
+
+    NumOfPayloadBytes += payload.size();
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatStream::ReceiveData(void)
+{
+    // taken batches are discarded first
+    if( InputStart > 0 ) {
+        Input.erase(Input.begin(),Input.begin() + InputStart);
+        InputStart = 0;
+    }
+
+    size_t used = Input.size();
+    Input.resize(used + STAT_STREAM_READ_SIZE);
+
+    ssize_t nread;
+    do {
+        nread = recv(FD,&Input[used],STAT_STREAM_READ_SIZE,0);
+    } while( (nread < 0) && (errno == EINTR) );
+
+    if( nread <= 0 ) {
+        Input.resize(used);
+        if( nread == 0 ) return(false);                 // connection closed
+        return( (errno == EAGAIN) || (errno == EWOULDBLOCK) );
+    }
+
+    Input.resize(used + nread);
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+EStatStreamBatch CStatStream::GetBatch(uint32_t& seq,std::vector<uint8_t>& payload)
+{
+    // errors are reported by the caller, the peer is not known here
+    uint32_t header[STAT_STREAM_BATCH_HEADER];
+    size_t   avail = Input.size() - InputStart;
+    if( avail < sizeof(header) ) return(STAT_STREAM_INCOMPLETE);
+    memcpy(header,&Input[InputStart],sizeof(header));
+
+    if( ntohl(header[0]) != STAT_STREAM_BATCH_MAGIC ) return(STAT_STREAM_MALFORMED);
+    uint32_t flags = ntohl(header[2]);
+    size_t size = ntohl(header[3]);
+    size_t raw_size = ntohl(header[4]);
+    if( (size > STAT_STREAM_MAX_PAYLOAD) || (raw_size > STAT_STREAM_MAX_PAYLOAD) ) {
+        return(STAT_STREAM_MALFORMED);
+    }
+    bool compressed = (flags & STAT_STREAM_FLAG_COMPRESSED) != 0;
+    if( (compressed == false) && (size != raw_size) ) return(STAT_STREAM_MALFORMED);
+    if( compressed && ((size == 0) || (raw_size == 0)) ) return(STAT_STREAM_MALFORMED);
+
+    if( avail < sizeof(header) + size ) return(STAT_STREAM_INCOMPLETE);
+
+    const uint8_t* p_data = &Input[InputStart + sizeof(header)];
+    InputStart += sizeof(header) + size;
+    seq = ntohl(header[1]);
+
+    if( compressed == false ) {
+        payload.assign(p_data,p_data + size);
+        return(STAT_STREAM_BATCH);
+    }
+
+    payload.resize(raw_size);
+    uLongf dsize = raw_size;
+    if( (uncompress(&payload[0],&dsize,p_data,size) != Z_OK) || (dsize != raw_size) ) {
+        return(STAT_STREAM_MALFORMED);
+    }
+
+    return(STAT_STREAM_BATCH);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatStream::WriteAck(uint32_t seq,uint32_t nrecs)
+{
+    uint32_t ack[STAT_STREAM_ACK_HEADER];
+    ack[0] = htonl(STAT_STREAM_ACK_MAGIC);
+    ack[1] = htonl(seq);
+    ack[2] = htonl(nrecs);
+    return(WriteAll(ack,sizeof(ack)));
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatStream::ReadAck(uint32_t& seq,uint32_t& nrecs)
+{
+    uint32_t ack[STAT_STREAM_ACK_HEADER];
+    if( ReadAll(ack,sizeof(ack)) == false ) return(false);
+
+    // the stream is not synchronized, reported by the caller
+    if( ntohl(ack[0]) != STAT_STREAM_ACK_MAGIC ) return(false);
+    seq = ntohl(ack[1]);
+    nrecs = ntohl(ack[2]);
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatStream::AddPacket(std::vector<uint8_t>& payload,const void* p_data,size_t size)
+{
+    uint32_t prefix = htonl(size);
+    const uint8_t* p_prefix = (const uint8_t*)&prefix;
+    payload.insert(payload.end(),p_prefix,p_prefix + sizeof(prefix));
+    payload.insert(payload.end(),(const uint8_t*)p_data,(const uint8_t*)p_data + size);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatStream::GetPacket(const std::vector<uint8_t>& payload,size_t& pos,
+                            const void*& p_data,size_t& size)
+{
+    uint32_t prefix;
+    if( pos + sizeof(prefix) > payload.size() ) return(false);
+    memcpy(&prefix,&payload[pos],sizeof(prefix));
+    size = ntohl(prefix);
+    if( pos + sizeof(prefix) + size > payload.size() ) return(false);
+    p_data = &payload[pos + sizeof(prefix)];
+    pos += sizeof(prefix) + size;
+    return(true);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatStream::ReadAll(void* p_data,size_t size)
+{
+    uint8_t* p_dest = (uint8_t*)p_data;
+    while( size > 0 ) {
+        ssize_t nread = recv(FD,p_dest,size,0);
+        if( nread == 0 ) return(false);                 // connection closed
+        if( nread < 0 ) {
+            if( errno == EINTR ) continue;
+            return(false);                              // error or timeout
+        }
+        p_dest += nread;
+        size -= nread;
+    }
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatStream::WriteAll(const void* p_data,size_t size)
+{
+    const uint8_t* p_src = (const uint8_t*)p_data;
+    while( size > 0 ) {
+        // broken connection must not raise SIGPIPE
+        ssize_t nwritten = send(FD,p_src,size,MSG_NOSIGNAL);
+        if( nwritten < 0 ) {
+            if( errno == EINTR ) continue;
+            return(false);
+        }
+        p_src += nwritten;
+        size -= nwritten;
+        NumOfSentBytes += nwritten;
+    }
+    return(true);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatStream::IsOpen(void) const
+{
+    return(FD != -1);
+}
+
+//------------------------------------------------------------------------------
+
+int CStatStream::GetFD(void) const
+{
+    return(FD);
+}
+
+//------------------------------------------------------------------------------
+
+size_t CStatStream::GetNumOfReceivedBytes(void) const
+{
+    return(Input.size() - InputStart);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatStream::GetNumOfSentBytes(void) const
+{
+    return(NumOfSentBytes);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatStream::GetNumOfPayloadBytes(void) const
+{
+    return(NumOfPayloadBytes);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
@@ -0,0 +1,149 @@
+#ifndef StatStreamH
+#define StatStreamH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include <SmallString.hpp>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/socket.h>
+
+//------------------------------------------------------------------------------
+
+// default port of the stream listener
+#define STAT_STREAM_PORT            32599
+
+// maximum size of batch payload (bytes, uncompressed)
+#define STAT_STREAM_MAX_PAYLOAD     (16*1024*1024)
+
+//------------------------------------------------------------------------------
+
+/// result of taking batch from received data
+enum EStatStreamBatch {
+    STAT_STREAM_INCOMPLETE = 0,     // more data is needed
+    STAT_STREAM_BATCH,              // batch was taken
+    STAT_STREAM_MALFORMED           // stream is not synchronized or batch is broken
+};
+
+//------------------------------------------------------------------------------
+
+/// reliable stream of record batches (relay and bulk import)
+/*! batch frame (network byte order):
+        uint32  magic "AMSB"
+        uint32  sequence number
+        uint32  flags (1 = payload is compressed by zlib)
+        uint32  size of payload in the frame
+        uint32  size of uncompressed payload
+        payload - v2 packets, each prefixed by uint32 size
+    every batch is acknowledged by the receiving side:
+        uint32  magic "AMSK"
+        uint32  sequence number of the batch
+        uint32  number of accepted records
+*/
+
+class CStatStream {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatStream(void);
+    ~CStatStream(void);
+
+// setup methods ---------------------------------------------------------------
+    //! connect to the listener, the timeout (ms) applies to connect and then to I/O
+    bool Connect(const CSmallString& host,int port,int timeout=0);
+
+    //! connect to the listener on Unix socket
+    bool ConnectUnix(const CSmallString& path);
+
+    //! use already connected socket
+    void Attach(int fd);
+
+    //! close connection
+    void Close(void);
+
+    //! set send and receive timeout (ms), 0 = wait forever
+    void SetTimeout(int timeout);
+
+    //! do not block in receive, batches are taken by ReceiveData and GetBatch
+    bool SetNonBlocking(void);
+
+// executive methods -----------------------------------------------------------
+    //! send batch
+    bool WriteBatch(uint32_t seq,const std::vector<uint8_t>& payload,bool compress);
+
+    //! read data available on non-blocking socket, false on error or closed connection
+    bool ReceiveData(void);
+
+    //! take the next complete batch from received data
+    EStatStreamBatch GetBatch(uint32_t& seq,std::vector<uint8_t>& payload);
+
+    //! acknowledge batch
+    bool WriteAck(uint32_t seq,uint32_t nrecs);
+
+    //! wait for acknowledgement
+    bool ReadAck(uint32_t& seq,uint32_t& nrecs);
+
+    //! append packet to payload
+    static void AddPacket(std::vector<uint8_t>& payload,const void* p_data,size_t size);
+
+    //! get next packet of payload, false at the end or if the payload is malformed
+    static bool GetPacket(const std::vector<uint8_t>& payload,size_t& pos,
+                          const void*& p_data,size_t& size);
+
+// information methods ---------------------------------------------------------
+    //! is connection open?
+    bool IsOpen(void) const;
+
+    //! socket descriptor
+    int GetFD(void) const;
+
+    //! number of received bytes not taken by GetBatch yet
+    size_t GetNumOfReceivedBytes(void) const;
+
+    //! number of bytes sent
+    long int GetNumOfSentBytes(void) const;
+
+    //! number of uncompressed payload bytes sent
+    long int GetNumOfPayloadBytes(void) const;
+
+// section of private data -----------------------------------------------------
+private:
+    int                     FD;
+    std::vector<uint8_t>    Buffer;
+    std::vector<uint8_t>    Input;          // received data
+    size_t                  InputStart;     // first byte not taken yet
+    long int                NumOfSentBytes;
+    long int                NumOfPayloadBytes;
+
+    //! connect the socket, wait at most timeout ms (0 = system default)
+    bool ConnectAddress(const struct sockaddr* p_addr,socklen_t addr_len,int timeout);
+
+    //! read exactly size bytes
+    bool ReadAll(void* p_data,size_t size);
+
+    //! write exactly size bytes
+    bool WriteAll(const void* p_data,size_t size);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
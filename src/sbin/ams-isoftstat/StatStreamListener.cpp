@@ -0,0 +1,421 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include "StatStreamListener.hpp"
+#include "StatAllocCounter.hpp"
+#include "AMSStatServer.hpp"
+#include <ErrorSystem.hpp>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+
+// how often the listener checks for termination (ms)
+#define LISTENER_POLL_TIMEOUT 500
+
+// connections stalled in the middle of a batch are closed after this time (ms)
+#define LISTENER_IO_TIMEOUT 10000
+
+// delay before a held batch is queued again when the writers are full (ms)
+#define LISTENER_QUEUE_RETRY 1
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatStreamListener::CStatStreamListener(void)
+{
+    ID = 0;
+    Terminated = false;
+
+    NumOfConnections = 0;
+    NumOfUnauthorized = 0;
+    NumOfBatches = 0;
+    NumOfBadBatches = 0;
+    NumOfAccepted = 0;
+    NumOfAllocations = 0;
+    NumOfDuplicates = 0;
+}
+
+//------------------------------------------------------------------------------
+
+CStatStreamListener::~CStatStreamListener(void)
+{
+    for(size_t i=0; i < Connections.size(); i++) {
+        delete Connections[i];
+    }
+    for(size_t i=0; i < Sockets.size(); i++) {
+        close(Sockets[i]);
+    }
+    if( UnixPath.GetLength() > 0 ) unlink(UnixPath);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatStreamListener::SetID(int id)
+{
+    ID = id;
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatStreamListener::OpenSocket(const CSmallString& address,int port)
+{
+    struct addrinfo hints;
+    struct addrinfo* result;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    int s = getaddrinfo(address,CSmallString(port),&hints,&result);
+    if( s != 0 ) {
+        CSmallString error;
+        error << "getaddrinfo: " << gai_strerror(s);
+        ES_ERROR(error);
+        return(false);
+    }
+
+    int sfd = -1;
+    struct addrinfo* rp;
+    for(rp = result; rp != NULL; rp = rp->ai_next) {
+        sfd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+        if( sfd == -1 ) continue;
+        int on = 1;
+        setsockopt(sfd,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+        if( (bind(sfd, rp->ai_addr, rp->ai_addrlen) == 0) && (listen(sfd,16) == 0) ) break;
+        close(sfd);
+        sfd = -1;
+    }
+    freeaddrinfo(result);
+
+    if( sfd == -1 ) {
+        CSmallString error;
+        error << "unable to bind stream listener " << address << ":" << port;
+        ES_ERROR(error);
+        return(false);
+    }
+
+    Sockets.push_back(sfd);
+    LocalSockets.push_back(false);
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatStreamListener::OpenUnixSocket(const CSmallString& path)
+{
+    struct sockaddr_un addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if( path.GetLength() >= sizeof(addr.sun_path) ) {
+        ES_ERROR("path of Unix socket is too long");
+        return(false);
+    }
+    strncpy(addr.sun_path,path,sizeof(addr.sun_path)-1);
+
+    int sfd = socket(AF_UNIX,SOCK_STREAM,0);
+    if( sfd == -1 ) {
+        ES_ERROR("unable to create Unix socket");
+        return(false);
+    }
+
+    // socket file of previous run
+    unlink(path);
+
+    // only the owner and its group can connect
+    mode_t mask = umask(0117);
+    bool bound = (bind(sfd,(struct sockaddr*)&addr,sizeof(addr)) == 0) && (listen(sfd,16) == 0);
+    umask(mask);
+
+    if( bound == false ) {
+        close(sfd);
+        CSmallString error;
+        error << "unable to bind stream listener " << path;
+        ES_ERROR(error);
+        return(false);
+    }
+
+    Sockets.push_back(sfd);
+    LocalSockets.push_back(true);
+    UnixPath = path;
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatStreamListener::ShutdownListener(void)
+{
+    Terminated = true;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatStreamListener::ExecuteThread(void)
+{
+    std::vector<struct pollfd> pfds;
+    size_t nsockets = Sockets.size();
+
+    while( Terminated == false ) {
+        // listening sockets first, then connections, a connection with
+        // a held batch is not read until the batch is queued
+        bool pending = false;
+        pfds.resize(nsockets + Connections.size());
+        for(size_t i=0; i < pfds.size(); i++) {
+            if( i < nsockets ) {
+                pfds[i].fd = Sockets[i];
+                pfds[i].events = POLLIN;
+            } else {
+                SConnection* p_conn = Connections[i-nsockets];
+                pfds[i].fd = p_conn->Stream.GetFD();
+                pfds[i].events = p_conn->Pending ? 0 : POLLIN;
+                if( p_conn->Pending ) pending = true;
+            }
+            pfds[i].revents = 0;
+        }
+
+        int timeout = pending ? LISTENER_QUEUE_RETRY : LISTENER_POLL_TIMEOUT;
+        if( poll(&pfds[0],pfds.size(),timeout) < 0 ) continue;
+
+        // serve connections in reverse order so that closed ones can be removed
+        for(size_t i=Connections.size(); i > 0; i--) {
+            if( ServeConnection(Connections[i-1],pfds[nsockets+i-1].revents != 0) == true ) continue;
+            delete Connections[i-1];
+            Connections.erase(Connections.begin() + (i-1));
+        }
+
+        for(size_t i=0; i < nsockets; i++) {
+            if( pfds[i].revents & POLLIN ) AcceptConnection(i);
+        }
+
+        // published for the summary and metrics
+        NumOfAllocations = CStatAllocCounter::GetNumOfAllocations();
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CStatStreamListener::AcceptConnection(size_t index)
+{
+    struct sockaddr_storage peer_addr;
+    socklen_t               peer_addr_len = sizeof(peer_addr);
+
+    int client = accept(Sockets[index],(struct sockaddr*)&peer_addr,&peer_addr_len);
+    if( client == -1 ) return;
+
+    // local clients passed the permissions of the socket file
+    if( (LocalSockets[index] == false) &&
+        (Server.IsPeerAuthorized((struct sockaddr*)&peer_addr,peer_addr_len) == false) ) {
+        NumOfUnauthorized++;
+        Server.ReportError(STAT_ERROR_STREAM_UNAUTHORIZED,(struct sockaddr*)&peer_addr,peer_addr_len);
+        close(client);
+        return;
+    }
+
+    SConnection* p_conn = new SConnection;
+    p_conn->Stream.Attach(client);
+    if( p_conn->Stream.SetNonBlocking() == false ) {
+        delete p_conn;
+        return;
+    }
+    memcpy(&p_conn->Peer,&peer_addr,peer_addr_len);
+    p_conn->PeerLen = peer_addr_len;
+    p_conn->LastData = CAMSStatServer::GetTimeInMS();
+    p_conn->Pending = false;
+    p_conn->Sequence = 0;
+    p_conn->Next = 0;
+    p_conn->Checked = false;
+    Connections.push_back(p_conn);
+    NumOfConnections++;
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatStreamListener::ServeConnection(SConnection* p_conn,bool readable)
+{
+    long int now = CAMSStatServer::GetTimeInMS();
+
+    if( readable ) {
+        if( p_conn->Stream.ReceiveData() == false ) return(false);  // closed or broken
+        p_conn->LastData = now;
+    }
+
+    for(;;) {
+        // held batch is acknowledged once all its records are queued
+        if( p_conn->Pending ) {
+            if( QueueBatch(p_conn) == false ) return(true);
+            p_conn->Pending = false;
+            NumOfBatches++;
+            // the acknowledgement fits into the socket buffer unless
+            // the client does not read them at all
+            if( p_conn->Stream.WriteAck(p_conn->Sequence,p_conn->Records.size()) == false ) return(false);
+        }
+
+        EStatStreamBatch result = p_conn->Stream.GetBatch(p_conn->Sequence,Payload);
+        if( result == STAT_STREAM_INCOMPLETE ) break;
+        if( (result == STAT_STREAM_MALFORMED) || (DecodeBatch(p_conn) == false) ) {
+            NumOfBadBatches++;
+            Server.ReportError(STAT_ERROR_BAD_BATCH,(struct sockaddr*)&p_conn->Peer,p_conn->PeerLen);
+            return(false);
+        }
+        p_conn->Pending = true;
+        p_conn->Next = 0;
+        p_conn->Checked = false;
+    }
+
+    // a client that stopped in the middle of a batch is disconnected,
+    // idle connections between batches are kept
+    if( (p_conn->Stream.GetNumOfReceivedBytes() > 0) && (now - p_conn->LastData > LISTENER_IO_TIMEOUT) ) {
+        return(false);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatStreamListener::DecodeBatch(SConnection* p_conn)
+{
+    // validate all packets before any record is taken
+    size_t      pos = 0;
+    const void* p_data;
+    size_t      size;
+    bool        valid = true;
+    while( valid && CStatStream::GetPacket(Payload,pos,p_data,size) ) {
+        valid = Packet.Parse(p_data,size);
+    }
+    if( (valid == false) || (pos != Payload.size()) ) return(false);
+
+    p_conn->Records.clear();
+    pos = 0;
+    while( CStatStream::GetPacket(Payload,pos,p_data,size) ) {
+        Packet.Parse(p_data,size);
+        for(int i=0; i < Packet.GetNumOfRecords(); i++) {
+            CAddStatDatagram record;
+            Packet.GetRecord(i,record);
+            p_conn->Records.push_back(record);
+        }
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatStreamListener::QueueBatch(SConnection* p_conn)
+{
+    // all records are spooled at once, thus a batch that is not acknowledged
+    // because of termination leaves nothing behind
+    if( (p_conn->Next == 0) && (Server.CanDispatchBatch(p_conn->Records.size()) == false) ) {
+        return(false);
+    }
+
+    while( p_conn->Next < p_conn->Records.size() ) {
+        const CAddStatDatagram& record = p_conn->Records[p_conn->Next];
+
+        // a retransmitted batch is dropped here, each record is checked once
+        if( p_conn->Checked == false ) {
+            p_conn->Checked = true;
+            if( Server.IsDuplicate(record) == true ) {
+                NumOfDuplicates++;
+                p_conn->Next++;
+                p_conn->Checked = false;
+                continue;
+            }
+        }
+
+        if( Server.DispatchDatagram(ID,record) == false ) return(false);
+        NumOfAccepted++;
+        p_conn->Next++;
+        p_conn->Checked = false;
+    }
+
+    return(true);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+long int CStatStreamListener::GetNumOfConnections(void) const
+{
+    return(NumOfConnections);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatStreamListener::GetNumOfUnauthorized(void) const
+{
+    return(NumOfUnauthorized);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatStreamListener::GetNumOfBatches(void) const
+{
+    return(NumOfBatches);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatStreamListener::GetNumOfBadBatches(void) const
+{
+    return(NumOfBadBatches);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatStreamListener::GetNumOfAccepted(void) const
+{
+    return(NumOfAccepted);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatStreamListener::GetNumOfDuplicates(void) const
+{
+    return(NumOfDuplicates);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatStreamListener::GetNumOfAllocations(void) const
+{
+    return(NumOfAllocations);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
@@ -0,0 +1,138 @@
+#ifndef StatStreamListenerH
+#define StatStreamListenerH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include <SoftStat.hpp>
+#include <SmallThread.hpp>
+#include "StatStream.hpp"
+#include "StatPacket.hpp"
+#include <vector>
+#include <sys/socket.h>
+
+//------------------------------------------------------------------------------
+
+/// stream listener thread - it accepts batches from relays and importers
+/*! TCP connections are authorized by the client access list when they are
+    accepted, access to the Unix socket is controlled by its permissions,
+    records of each batch are deduplicated and passed to the writers like
+    datagrams of a receiver (the listener has its own ring in every writer),
+    connections are non-blocking and served by poll, thus a slow client
+    does not delay the others, the listener requires the spool, a batch is
+    acknowledged after all its records were appended to the spool, thus
+    acknowledged records survive restart of the server during database
+    outage, a full spool holds the batch back and slows the sender down
+*/
+
+class CStatStreamListener : public CSmallThread {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatStreamListener(void);
+    ~CStatStreamListener(void);
+
+// setup methods ---------------------------------------------------------------
+    //! set writer ring of the listener
+    void SetID(int id);
+
+    //! open and bind the listening TCP socket
+    bool OpenSocket(const CSmallString& address,int port);
+
+    //! open and bind the listening Unix socket, a stale socket file is removed
+    bool OpenUnixSocket(const CSmallString& path);
+
+    //! request listener termination
+    void ShutdownListener(void);
+
+// information methods ---------------------------------------------------------
+    //! number of accepted connections
+    long int GetNumOfConnections(void) const;
+
+    //! number of connections from unauthorized clients
+    long int GetNumOfUnauthorized(void) const;
+
+    //! number of acknowledged batches
+    long int GetNumOfBatches(void) const;
+
+    //! number of malformed batches
+    long int GetNumOfBadBatches(void) const;
+
+    //! number of records passed to the writers
+    long int GetNumOfAccepted(void) const;
+
+    //! number of retransmitted records dropped by deduplication
+    long int GetNumOfDuplicates(void) const;
+
+    //! number of heap allocations done by the listener thread
+    long int GetNumOfAllocations(void) const;
+
+// section of private data -----------------------------------------------------
+private:
+    int                         ID;
+    std::vector<int>            Sockets;
+    std::vector<bool>           LocalSockets;   // Unix sockets
+    CSmallString                UnixPath;
+    volatile bool               Terminated;
+    std::vector<uint8_t>        Payload;
+    CStatPacket                 Packet;
+
+    struct SConnection {
+        CStatStream                     Stream;
+        struct sockaddr_storage         Peer;
+        socklen_t                       PeerLen;
+        long int                        LastData;   // ms
+        // batch waiting for room in the writer rings
+        bool                            Pending;
+        uint32_t                        Sequence;
+        std::vector<CAddStatDatagram>   Records;
+        size_t                          Next;       // first record not queued yet
+        bool                            Checked;    // Next was checked by dedup
+    };
+    std::vector<SConnection*>   Connections;
+
+    // statistics
+    long int                    NumOfConnections;
+    long int                    NumOfUnauthorized;
+    long int                    NumOfBatches;
+    long int                    NumOfBadBatches;
+    long int                    NumOfAccepted;
+    long int                    NumOfDuplicates;
+    volatile long int           NumOfAllocations;
+
+    //! listener loop
+    virtual void ExecuteThread(void);
+
+    //! accept new connection on listening socket
+    void AcceptConnection(size_t index);
+
+    //! read, queue and acknowledge received batches, false closes the connection
+    bool ServeConnection(SConnection* p_conn,bool readable);
+
+    //! validate payload and take its records
+    bool DecodeBatch(SConnection* p_conn);
+
+    //! queue records of pending batch, false if the writers are full
+    bool QueueBatch(SConnection* p_conn);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
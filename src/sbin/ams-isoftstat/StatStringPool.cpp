@@ -0,0 +1,144 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include "StatStringPool.hpp"
+#include <boost/functional/hash.hpp>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+
+// default number of pooled strings
+#define STRING_POOL_MAX_SIZE 4096
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+size_t SStatStringHash::operator () (const std::string& str) const
+{
+    return(boost::hash_range(str.data(),str.data() + str.size()));
+}
+
+//------------------------------------------------------------------------------
+
+size_t SStatStringHash::operator () (const SStatStringView& str) const
+{
+    return(boost::hash_range(str.Data,str.Data + str.Length));
+}
+
+//------------------------------------------------------------------------------
+
+bool SStatStringEqual::operator () (const std::string& left,const std::string& right) const
+{
+    return(left == right);
+}
+
+//------------------------------------------------------------------------------
+
+bool SStatStringEqual::operator () (const SStatStringView& left,const std::string& right) const
+{
+    return( (left.Length == right.size()) && (memcmp(left.Data,right.data(),left.Length) == 0) );
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatStringPool::CStatStringPool(void)
+{
+    MaxSize = STRING_POOL_MAX_SIZE;
+    NumOfHits = 0;
+    NumOfMisses = 0;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatStringPool::SetMaxSize(size_t max_size)
+{
+    MaxSize = max_size;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatStringPool::Clear(void)
+{
+    Strings.clear();
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+const CSmallString* CStatStringPool::Get(const char* p_str,size_t len)
+{
+    SStatStringView view;
+    view.Data = p_str;
+    view.Length = len;
+
+    TStrings::const_iterator it = Strings.find(view,SStatStringHash(),SStatStringEqual());
+    if( it != Strings.end() ) {
+        NumOfHits++;
+        return(&it->second);
+    }
+
+    NumOfMisses++;
+    std::string key(p_str,len);
+    CSmallString& str = Strings[key];
+    str = key.c_str();
+    return(&str);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatStringPool::IsFull(void) const
+{
+    return(Strings.size() >= MaxSize);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+size_t CStatStringPool::GetSize(void) const
+{
+    return(Strings.size());
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatStringPool::GetNumOfHits(void) const
+{
+    return(NumOfHits);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatStringPool::GetNumOfMisses(void) const
+{
+    return(NumOfMisses);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
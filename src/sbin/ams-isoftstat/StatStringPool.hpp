@@ -0,0 +1,100 @@
+#ifndef StatStringPoolH
+#define StatStringPoolH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+
+#include <SmallString.hpp>
+#include <boost/unordered_map.hpp>
+#include <string>
+#include <stddef.h>
+
+//------------------------------------------------------------------------------
+
+/// string without its own storage, e.g. a part of received packet
+struct SStatStringView {
+    const char* Data;
+    size_t      Length;
+};
+
+/// hash of stored strings and views, both give the same value
+struct SStatStringHash {
+    size_t operator () (const std::string& str) const;
+    size_t operator () (const SStatStringView& str) const;
+};
+
+/// comparison of views with stored strings
+struct SStatStringEqual {
+    bool operator () (const std::string& left,const std::string& right) const;
+    bool operator () (const SStatStringView& left,const std::string& right) const;
+};
+
+//------------------------------------------------------------------------------
+
+/// strings decoded from packets
+/*! each distinct string is converted to CSmallString once, lookups use
+    views of the packet buffer so repeated strings cost no allocation,
+    the pool is bounded, it is cleared when it is full
+*/
+
+class CStatStringPool {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatStringPool(void);
+
+// setup methods ---------------------------------------------------------------
+    //! set the maximum number of pooled strings
+    void SetMaxSize(size_t max_size);
+
+    //! remove all strings, returned pointers become invalid
+    void Clear(void);
+
+// executive methods -----------------------------------------------------------
+    //! get pooled copy of the string, the string is added if it is not pooled
+    const CSmallString* Get(const char* p_str,size_t len);
+
+    //! is the pool full? (it should be cleared before the next packet)
+    bool IsFull(void) const;
+
+// information methods ---------------------------------------------------------
+    //! number of pooled strings
+    size_t GetSize(void) const;
+
+    //! number of strings found in the pool
+    long int GetNumOfHits(void) const;
+
+    //! number of strings added to the pool
+    long int GetNumOfMisses(void) const;
+
+// section of private data -----------------------------------------------------
+private:
+    typedef boost::unordered_map<std::string,CSmallString,
+                                 SStatStringHash,SStatStringEqual> TStrings;
+
+    TStrings    Strings;
+    size_t      MaxSize;
+    long int    NumOfHits;
+    long int    NumOfMisses;
+};
+
+// -----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,773 @@
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include "StatWriter.hpp"
+#include "StatAllocCounter.hpp"
+#include "AMSStatServer.hpp"
+#include <ErrorSystem.hpp>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+
+// sleep time of idle writer (us)
+#define WRITER_IDLE_TIME 1000
+
+// delay between reconnect attempts, it doubles up to the maximum (ms)
+#define WRITER_MIN_RETRY 1000
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+CStatWriter::CStatWriter(int nrings,size_t ring_size)
+{
+    for(int i=0; i < nrings; i++) {
+        Rings.push_back(new CStatRing(ring_size));
+    }
+
+    Terminated = false;
+    FlushRequested = false;
+    Spool = NULL;
+    TransactionFailed = false;
+    Rollup = NULL;
+    Storage = NULL;
+    Session = NULL;
+    BlockRows = 1;
+
+    Connected = true;
+    RetryQueue = NULL;
+    RetryQueueSize = 0;
+    RetryDelay = WRITER_MIN_RETRY;
+    MaxRetryDelay = 60000;
+    OutageStart = 0;
+
+    BatchSize = 1;
+    BatchStart = 0;
+
+    NumOfSuccessful = 0;
+    NumOfFailed = 0;
+    NumOfBatches = 0;
+    NumOfFailedBatches = 0;
+    NumOfBlocks = 0;
+    NumOfAllocations = 0;
+    NumOfFailedBlocks = 0;
+    NumOfOutages = 0;
+    LongestOutage = 0;
+}
+
+//------------------------------------------------------------------------------
+
+CStatWriter::~CStatWriter(void)
+{
+    for(size_t i=0; i < Rings.size(); i++) {
+        delete Rings[i];
+    }
+    if( RetryQueue != NULL ) delete RetryQueue;
+    if( Session != NULL ) delete Session;
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatWriter::SetBatch(int batch_size)
+{
+    BatchSize = batch_size;
+    if( BatchSize < 1 ) BatchSize = 1;
+
+    Batch.reserve(BatchSize);
+    Records.resize(BatchSize);
+    Resolved.resize(BatchSize);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatWriter::SetBlockRows(int block_rows)
+{
+    BlockRows = block_rows;
+    if( BlockRows < 1 ) BlockRows = 1;
+    if( BlockRows > STORAGE_MAX_BLOCK_ROWS ) BlockRows = STORAGE_MAX_BLOCK_ROWS;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatWriter::SetSpool(CStatSpool* p_spool)
+{
+    Spool = p_spool;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatWriter::SetRollup(CStatRollup* p_rollup)
+{
+    Rollup = p_rollup;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatWriter::SetRetryQueue(int size)
+{
+    if( RetryQueue != NULL ) delete RetryQueue;
+    RetryQueue = NULL;
+    // without the queue, datagrams wait in the rings during the outage
+    RetryQueueSize = size > 0 ? size : 0;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatWriter::SetMaxRetryDelay(int delay)
+{
+    MaxRetryDelay = delay;
+    if( MaxRetryDelay < WRITER_MIN_RETRY ) MaxRetryDelay = WRITER_MIN_RETRY;
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatWriter::InitWriter(CStatStorage* p_storage)
+{
+    Storage = p_storage;
+
+    if( OpenSession() == false ) {
+        ES_ERROR("unable to open storage session");
+        return(false);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatWriter::ShutdownWriter(void)
+{
+    Terminated = true;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatWriter::RequestFlush(void)
+{
+    FlushRequested = true;
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatWriter::Push(int ring,const CAddStatDatagram& datagram)
+{
+    return(Rings[ring]->Push(datagram));
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+void CStatWriter::ExecuteThread(void)
+{
+    for(;;) {
+        // read the flag before draining, the receivers are already stopped
+        // when it is set, thus nothing can be queued after the last drain
+        bool terminated = Terminated;
+        // a request set after this point is served by the next round
+        bool flush_requested = FlushRequested;
+        if( flush_requested ) FlushRequested = false;
+
+        // database outage - the batch is kept, new datagrams wait
+        // in the retry queue or in the spool
+        if( (Connected == false) && (Reconnect() == false) ) {
+            if( terminated ) break;
+            WaitForRetry();
+            continue;
+        }
+
+        // drain rings or spool ----------------------
+        bool idle;
+        if( Spool != NULL ) {
+            idle = ! DrainSpool();
+        } else {
+            idle = ! DrainRings();
+        }
+
+        // flush batch if it is full or the flush timer expired
+        bool flushed = true;
+        if( (int)Batch.size() >= BatchSize ) {
+            flushed = FlushBatch();
+        } else if( (Batch.empty() == false) && flush_requested ) {
+            flushed = FlushBatch();
+        }
+
+        // published for the summary and metrics
+        NumOfAllocations = CStatAllocCounter::GetNumOfAllocations();
+
+        // spooled datagrams are replayed after restart, do not wait for them
+        if( terminated && (idle || (Spool != NULL)) ) break;
+        if( flushed == false ) {
+            WaitForRetry();
+        } else if( idle ) {
+            usleep(WRITER_IDLE_TIME);
+        }
+    }
+
+    // write pending datagrams
+    if( Connected ) FlushBatch();
+
+    // spooled datagrams are replayed after restart, the others are lost
+    if( (Connected == false) && (Spool == NULL) ) {
+        long int lost = Batch.size() + GetRingDepth() + GetRetryQueueDepth();
+        NumOfFailed += lost;
+        Batch.clear();
+        CSmallString error;
+        error << "database is not available, " << lost << " datagrams are lost";
+        ES_ERROR(error);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatWriter::OpenSession(void)
+{
+    Session = Storage->CreateSession();
+    if( Session == NULL ) return(false);
+
+    // statements are prepared once per session and then only
+    // executed with new parameters
+    // silent - it is repeated by each reconnect attempt, callers report it
+    if( Session->PrepareInsert(BlockRows) == false ) return(false);
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatWriter::LoseConnection(void)
+{
+    Connected = false;
+    OutageStart = CAMSStatServer::GetTimeInMS();
+    // the queue is allocated by the first outage and then kept,
+    // statistics are read by other threads
+    if( (RetryQueue == NULL) && (RetryQueueSize > 0) && (Spool == NULL) ) {
+        RetryQueue = new CStatRing(RetryQueueSize);
+    }
+    RetryDelay = WRITER_MIN_RETRY;
+    NumOfOutages++;
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatWriter::Reconnect(void)
+{
+    // the session of the lost connection cannot be used anymore
+    if( Session != NULL ) delete Session;
+    Session = NULL;
+
+    if( (OpenSession() == false) || (Server.ReconnectStorage() == false) ) {
+        Server.ReportError(STAT_ERROR_DB_UNAVAILABLE);
+        return(false);
+    }
+
+    long int outage = CAMSStatServer::GetTimeInMS() - OutageStart;
+    if( LongestOutage < outage ) LongestOutage = outage;
+
+    Connected = true;
+    OutageStart = 0;
+    RetryDelay = WRITER_MIN_RETRY;
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatWriter::WaitForRetry(void)
+{
+    // the receivers keep queuing, their rings are emptied into the retry
+    // queue so that short rings do not overflow during the outage
+    long int deadline = CAMSStatServer::GetTimeInMS() + RetryDelay;
+    while( (Terminated == false) && (CAMSStatServer::GetTimeInMS() < deadline) ) {
+        if( (Spool == NULL) && (RetryQueue != NULL) ) FillRetryQueue();
+        usleep(WRITER_IDLE_TIME);
+    }
+
+    RetryDelay *= 2;
+    if( RetryDelay > MaxRetryDelay ) RetryDelay = MaxRetryDelay;
+}
+
+//------------------------------------------------------------------------------
+
+void CStatWriter::FillRetryQueue(void)
+{
+    CAddStatDatagram    datagram;
+
+    // the queue is checked before the ring is popped, thus datagrams
+    // are dropped by the full rings and counted as ring drops
+    for(size_t i=0; i < Rings.size(); i++) {
+        while( (RetryQueue->GetDepth() < (long int)RetryQueue->GetCapacity())
+               && Rings[i]->Pop(datagram) ) {
+            RetryQueue->Push(datagram);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatWriter::DrainRings(void)
+{
+    CAddStatDatagram    datagram;
+    bool                found = false;
+    bool                progress = true;
+
+    // backlog of the outage goes first, new datagrams are queued behind it
+    // to keep the order
+    if( (RetryQueue != NULL) && (RetryQueue->GetDepth() > 0) ) {
+        FillRetryQueue();
+        while( ((int)Batch.size() < BatchSize) && RetryQueue->Pop(datagram) ) {
+            if( Batch.empty() ) BatchStart = CAMSStatServer::GetTimeInMS();
+            Batch.push_back(datagram);
+            found = true;
+        }
+        return(found);
+    }
+
+    // take datagrams from all rings in turn so that no receiver is starved
+    while( progress && ((int)Batch.size() < BatchSize) ) {
+        progress = false;
+        for(size_t i=0; (i < Rings.size()) && ((int)Batch.size() < BatchSize); i++) {
+            if( Rings[i]->Pop(datagram) == false ) continue;
+            if( Batch.empty() ) BatchStart = CAMSStatServer::GetTimeInMS();
+            Batch.push_back(datagram);
+            progress = true;
+            found = true;
+        }
+    }
+
+    return(found);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatWriter::DrainSpool(void)
+{
+    CAddStatDatagram    datagram;
+    bool                found = false;
+
+    // the batch is kept while the database is not available, the spool
+    // is read again only after the batch was written
+    while( ((int)Batch.size() < BatchSize) && Spool->Read(datagram) ) {
+        if( Batch.empty() ) BatchStart = CAMSStatServer::GetTimeInMS();
+        Batch.push_back(datagram);
+        found = true;
+    }
+
+    return(found);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+bool CStatWriter::FlushBatch(void)
+{
+    if( Batch.empty() ) return(true);
+
+    NumOfBatches++;
+    TransactionFailed = false;
+
+    // keys are created before the transaction is started, the key connection
+    // of SQLite cannot write while the session holds the write lock
+    bool resolved = ResolveBatch();
+
+    // the key connection is lost - keep the batch for the next attempt
+    if( TransactionFailed ) {
+        Server.ReportError(STAT_ERROR_DB_UNAVAILABLE);
+        LoseConnection();
+        return(false);
+    }
+
+    bool use_blocks = (BlockRows > 1) && ((int)Batch.size() >= BlockRows);
+    long int start = CAMSStatServer::GetTimeInUS();
+    bool result = resolved && WriteBatchToDatabase(use_blocks);
+    long int wait = (CAMSStatServer::GetTimeInMS() - BatchStart)*1000;
+    Server.ObserveBatch(Batch.size(),wait,CAMSStatServer::GetTimeInUS() - start);
+
+    // a block failed - repeat the batch with single-row inserts
+    if( (result == false) && resolved && use_blocks && (TransactionFailed == false) ) {
+        NumOfFailedBlocks++;
+        result = WriteBatchToDatabase(false);
+    }
+
+    if( result == true ) {
+        NumOfSuccessful += Batch.size();
+        if( Spool != NULL ) Spool->Commit(Batch.size());
+        Batch.clear();
+        return(true);
+    }
+
+    // database is not available - keep the batch for the next attempt
+    if( TransactionFailed ) {
+        LoseConnection();
+        return(false);
+    }
+
+    // the whole batch was rolled back - retry it record by record
+    // so that a single bad record cannot discard the others
+    NumOfFailedBatches++;
+
+    size_t i;
+    for(i=0; i < Batch.size(); i++) {
+        if( Resolved[i] && (WriteRecordToDatabase(Records[i]) == true) ) {
+            NumOfSuccessful++;
+        } else {
+            if( TransactionFailed ) break;
+            NumOfFailed++;
+        }
+    }
+
+    // commit processed records, the rest stays in the batch
+    if( Spool != NULL ) Spool->Commit(i);
+    Batch.erase(Batch.begin(),Batch.begin() + i);
+    if( TransactionFailed ) LoseConnection();
+
+    return(Batch.empty());
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatWriter::WriteBatchToDatabase(bool use_blocks)
+{
+    if( Session->StartTransaction() == false ) {
+        Server.ReportError(STAT_ERROR_DB_UNAVAILABLE);
+        TransactionFailed = true;
+        return(false);
+    }
+
+    Committed.clear();
+    size_t i = 0;
+
+    // full blocks first, the rest by single-row inserts
+    if( use_blocks ) {
+        for(; i + BlockRows <= Batch.size(); i += BlockRows) {
+            if( WriteBlockToDatabase(i) == false ){
+                Server.ReportError(STAT_ERROR_DB_WRITE);
+                Session->RollbackTransaction();
+                return(false);
+            }
+        }
+    }
+
+    for(; i < Batch.size(); i++) {
+        if( WriteDataToDatabase(Records[i]) == false ){
+            Server.ReportError(STAT_ERROR_DB_WRITE);
+            Session->RollbackTransaction();
+            return(false);
+        }
+    }
+
+    if( Session->CommitTransaction() == false ) {
+        Server.ReportError(STAT_ERROR_DB_WRITE);
+        Session->RollbackTransaction();
+        return(false);
+    }
+
+    if( Rollup != NULL ) Rollup->Add(Committed);
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatWriter::WriteRecordToDatabase(const SStatRecord& record)
+{
+    if( Session->StartTransaction() == false ) {
+        Server.ReportError(STAT_ERROR_DB_UNAVAILABLE);
+        TransactionFailed = true;
+        return(false);
+    }
+
+    Committed.clear();
+    if( WriteDataToDatabase(record) == false ){
+        Server.ReportError(STAT_ERROR_DB_WRITE);
+        Session->RollbackTransaction();
+        return(false);
+    }
+
+    if( Session->CommitTransaction() == false ) {
+        Server.ReportError(STAT_ERROR_DB_WRITE);
+        Session->RollbackTransaction();
+        return(false);
+    }
+
+    if( Rollup != NULL ) Rollup->Add(Committed);
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatWriter::WriteDataToDatabase(const SStatRecord& record)
+{
+    if( Session->InsertRecord(record) == false ) return(false);
+
+    AddToRollup(record);
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatWriter::WriteBlockToDatabase(size_t first)
+{
+    for(int r=0; r < BlockRows; r++) {
+        // discarded with the transaction if the block fails
+        AddToRollup(Records[first + r]);
+    }
+
+    NumOfBlocks++;
+    if( Session->InsertBlock(&Records[first]) == false ) return(false);
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatWriter::ResolveBatch(void)
+{
+    bool result = true;
+
+    for(size_t i=0; i < Batch.size(); i++) {
+        Resolved[i] = ResolveRecord(Batch[i],Records[i]);
+        if( Resolved[i] == true ) continue;
+        // the key cannot be created without the database
+        if( Server.IsStorageConnected() == false ) {
+            TransactionFailed = true;
+            return(false);
+        }
+        result = false;
+    }
+
+    return(result);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatWriter::ResolveRecord(CAddStatDatagram& datagram,SStatRecord& record)
+{
+    record.Keys[0] = Server.GetKeyID(datagram.GetSite());
+    record.Keys[1] = Server.GetKeyID(datagram.GetModuleName());
+    record.Keys[2] = Server.GetKeyID(datagram.GetModuleVers());
+    record.Keys[3] = Server.GetKeyID(datagram.GetModuleArch());
+    record.Keys[4] = Server.GetKeyID(datagram.GetModuleMode());
+    record.Keys[5] = Server.GetKeyID(datagram.GetUser());
+    record.Keys[6] = Server.GetKeyID(datagram.GetHostName());
+
+    for(int i=0; i < STORAGE_NUM_OF_KEYS; i++) {
+        // counted by the server as key failures
+        if( record.Keys[i] < 0 ) return(false);
+    }
+
+    record.NCPUs = datagram.GetNCPUs();
+    record.NHostCPUs = datagram.GetNumOfHostCPUs();
+    record.NGPUs = datagram.GetNGPUs();
+    record.NHostGPUs = datagram.GetNumOfHostGPUs();
+    record.NNodes = datagram.GetNumOfNodes();
+    record.Flags = datagram.GetFlags();
+    record.Time = datagram.GetTimeAndDate();
+
+    return(true);
+}
+
+//------------------------------------------------------------------------------
+
+void CStatWriter::AddToRollup(const SStatRecord& record)
+{
+    // counted by the rollup once the transaction is committed
+    if( Rollup == NULL ) return;
+
+    SStatRollupRecord rollup;
+    rollup.Time = record.Time.GetSecondsFromBeginning();
+    rollup.Site = record.Keys[0];
+    rollup.ModuleName = record.Keys[1];
+    rollup.ModuleVers = record.Keys[2];
+    rollup.ModuleArch = record.Keys[3];
+    rollup.ModuleMode = record.Keys[4];
+    rollup.User = record.Keys[5];
+    rollup.HostName = record.Keys[6];
+    Committed.push_back(rollup);
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
+
+long int CStatWriter::GetRingCapacity(void) const
+{
+    long int capacity = 0;
+    for(size_t i=0; i < Rings.size(); i++) {
+        capacity += Rings[i]->GetCapacity();
+    }
+    return(capacity);
+}
+
+//------------------------------------------------------------------------------
+
+size_t CStatWriter::GetRingSize(void) const
+{
+    if( Rings.empty() ) return(0);
+    return(Rings[0]->GetCapacity());
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetRingDepth(void) const
+{
+    long int depth = 0;
+    for(size_t i=0; i < Rings.size(); i++) {
+        depth += Rings[i]->GetDepth();
+    }
+    return(depth);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetRingHighWaterMark(void) const
+{
+    long int hwm = 0;
+    for(size_t i=0; i < Rings.size(); i++) {
+        if( hwm < Rings[i]->GetHighWaterMark() ) hwm = Rings[i]->GetHighWaterMark();
+    }
+    return(hwm);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetNumOfRingDrops(void) const
+{
+    long int drops = 0;
+    for(size_t i=0; i < Rings.size(); i++) {
+        drops += Rings[i]->GetNumOfDrops();
+    }
+    return(drops);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetNumOfSuccessful(void) const
+{
+    return(NumOfSuccessful);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetNumOfFailed(void) const
+{
+    return(NumOfFailed);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetNumOfBatches(void) const
+{
+    return(NumOfBatches);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetNumOfFailedBatches(void) const
+{
+    return(NumOfFailedBatches);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetNumOfBlocks(void) const
+{
+    return(NumOfBlocks);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetNumOfFailedBlocks(void) const
+{
+    return(NumOfFailedBlocks);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetNumOfAllocations(void) const
+{
+    return(NumOfAllocations);
+}
+
+//------------------------------------------------------------------------------
+
+bool CStatWriter::IsConnected(void) const
+{
+    return(Connected);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetOutageTime(void) const
+{
+    long int start = OutageStart;
+    if( start == 0 ) return(0);
+    return(CAMSStatServer::GetTimeInMS() - start);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetLongestOutage(void) const
+{
+    return(LongestOutage);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetNumOfOutages(void) const
+{
+    return(NumOfOutages);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetRetryQueueCapacity(void) const
+{
+    // the configured capacity, the queue need not be allocated yet
+    return(Spool == NULL ? RetryQueueSize : 0);
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetRetryQueueDepth(void) const
+{
+    CStatRing* p_queue = RetryQueue;
+    if( p_queue == NULL ) return(0);
+    return(p_queue->GetDepth());
+}
+
+//------------------------------------------------------------------------------
+
+long int CStatWriter::GetRetryQueueHighWaterMark(void) const
+{
+    CStatRing* p_queue = RetryQueue;
+    if( p_queue == NULL ) return(0);
+    return(p_queue->GetHighWaterMark());
+}
+
+//==============================================================================
+//------------------------------------------------------------------------------
+//==============================================================================
@@ -0,0 +1,228 @@
+#ifndef StatWriterH
+#define StatWriterH
+// =============================================================================
+// AMS - Advanced Module System
+// -----------------------------------------------------------------------------
+//    Copyright (C) 2004,2005,2008 Petr Kulhanek, kulhanek@chemi.muni.cz
+//
+//     This program is free software; you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation; either version 2 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License along
+//     with this program; if not, write to the Free Software Foundation, Inc.,
+//     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+// =============================================================================
+
+
+#include <SoftStat.hpp>
+#include <SmallThread.hpp>
+#include "StatStorage.hpp"
+#include "StatRing.hpp"
+#include "StatSpool.hpp"
+#include "StatRollup.hpp"
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+/// database writer thread - it drains its rings (one per receiver) or the spool
+/// and writes datagrams to the database in batches (group commit)
+/*! when the connection is lost, the batch is kept and the session is opened
+    again with exponential backoff, datagrams accepted meanwhile wait
+    in the bounded retry queue (or in the spool)
+*/
+
+class CStatWriter : public CSmallThread {
+public:
+// constructor and destructors -------------------------------------------------
+    CStatWriter(int nrings,size_t ring_size);
+    ~CStatWriter(void);
+
+// setup methods ---------------------------------------------------------------
+    //! set batch size
+    void SetBatch(int batch_size);
+
+    //! set number of rows inserted by one statement
+    void SetBlockRows(int block_rows);
+
+    //! replay datagrams from the spool instead of the rings
+    void SetSpool(CStatSpool* p_spool);
+
+    //! feed committed records to the rollup
+    void SetRollup(CStatRollup* p_rollup);
+
+    //! keep up to size datagrams in memory while the database is not available,
+    //! the queue is allocated when the first outage starts
+    void SetRetryQueue(int size);
+
+    //! set maximum delay between reconnect attempts (ms)
+    void SetMaxRetryDelay(int delay);
+
+    //! open storage session and prepare statements
+    bool InitWriter(CStatStorage* p_storage);
+
+    //! request writer termination, queued datagrams are written before exit
+    void ShutdownWriter(void);
+
+    //! request flush of the partial batch (main thread timer)
+    void RequestFlush(void);
+
+// executive methods -----------------------------------------------------------
+    //! queue datagram (called by the receiver owning the ring)
+    bool Push(int ring,const CAddStatDatagram& datagram);
+
+// information methods ---------------------------------------------------------
+    //! capacity of all rings
+    long int GetRingCapacity(void) const;
+
+    //! capacity of one ring
+    size_t GetRingSize(void) const;
+
+    //! current number of queued datagrams
+    long int GetRingDepth(void) const;
+
+    //! maximum number of queued datagrams in one ring
+    long int GetRingHighWaterMark(void) const;
+
+    //! number of datagrams dropped because a ring was full
+    long int GetNumOfRingDrops(void) const;
+
+    //! number of datagrams written to the database
+    long int GetNumOfSuccessful(void) const;
+
+    //! number of datagrams that could not be written
+    long int GetNumOfFailed(void) const;
+
+    //! number of batches
+    long int GetNumOfBatches(void) const;
+
+    //! number of batches retried record by record
+    long int GetNumOfFailedBatches(void) const;
+
+    //! number of executed block inserts
+    long int GetNumOfBlocks(void) const;
+
+    //! number of batches retried with single-row inserts after a block failed
+    long int GetNumOfFailedBlocks(void) const;
+
+    //! number of heap allocations done by the writer thread
+    long int GetNumOfAllocations(void) const;
+
+    //! is the database connected?
+    bool IsConnected(void) const;
+
+    //! duration of the current database outage (ms), 0 if connected
+    long int GetOutageTime(void) const;
+
+    //! duration of the longest finished outage (ms)
+    long int GetLongestOutage(void) const;
+
+    //! number of lost database connections
+    long int GetNumOfOutages(void) const;
+
+    //! capacity of the retry queue
+    long int GetRetryQueueCapacity(void) const;
+
+    //! current number of datagrams in the retry queue
+    long int GetRetryQueueDepth(void) const;
+
+    //! maximum number of datagrams in the retry queue
+    long int GetRetryQueueHighWaterMark(void) const;
+
+// section of private data -----------------------------------------------------
+private:
+    std::vector<CStatRing*>         Rings;
+    volatile bool                   Terminated;
+    volatile bool                   FlushRequested;
+    CStatStorage*                   Storage;
+    CStatStorageSession*            Session;
+    int                             BlockRows;
+    CStatSpool*                     Spool;
+    bool                            TransactionFailed;
+    CStatRollup*                    Rollup;
+    std::vector<SStatRollupRecord>  Committed;  // records of open transaction
+
+    // reconnect
+    volatile bool                   Connected;
+    CStatRing* volatile             RetryQueue;     // datagrams accepted during outage
+    int                             RetryQueueSize;
+    int                             RetryDelay;     // ms
+    int                             MaxRetryDelay;  // ms
+    volatile long int               OutageStart;    // ms, 0 if connected
+
+    // group commit
+    int                             BatchSize;
+    std::vector<CAddStatDatagram>   Batch;
+    long int                        BatchStart;
+    std::vector<SStatRecord>        Records;    // resolved batch
+    std::vector<bool>               Resolved;   // all keys of the record are known
+
+    // statistics
+    long int                        NumOfSuccessful;
+    long int                        NumOfFailed;
+    long int                        NumOfBatches;
+    long int                        NumOfFailedBatches;
+    long int                        NumOfBlocks;
+    long int                        NumOfFailedBlocks;
+    volatile long int               NumOfAllocations;
+    long int                        NumOfOutages;
+    long int                        LongestOutage;
+
+    //! main writer loop
+    virtual void ExecuteThread(void);
+
+    //! create storage session and prepare statements
+    bool OpenSession(void);
+
+    //! start the outage, the session is opened again by Reconnect
+    void LoseConnection(void);
+
+    //! open new session after the connection was lost
+    bool Reconnect(void);
+
+    //! wait before the next reconnect attempt, the rings are emptied meanwhile
+    void WaitForRetry(void);
+
+    //! move datagrams from rings to the retry queue while it has room
+    void FillRetryQueue(void);
+
+    //! move datagrams from rings to the batch, return false if rings are empty
+    bool DrainRings(void);
+
+    //! move datagrams from spool to the batch, return false if spool is empty
+    bool DrainSpool(void);
+
+    //! write all batched datagrams to database, false if the database is not available
+    bool FlushBatch(void);
+
+    //! write batched datagrams in one transaction
+    bool WriteBatchToDatabase(bool use_blocks);
+
+    //! write BlockRows records starting at first by one statement
+    bool WriteBlockToDatabase(size_t first);
+
+    //! write record in its own transaction
+    bool WriteRecordToDatabase(const SStatRecord& record);
+
+    //! write record to database
+    bool WriteDataToDatabase(const SStatRecord& record);
+
+    //! resolve keys of all batched datagrams, return false if some key is missing
+    bool ResolveBatch(void);
+
+    //! resolve all keys of the datagram
+    bool ResolveRecord(CAddStatDatagram& datagram,SStatRecord& record);
+
+    //! remember record for the rollup
+    void AddToRollup(const SStatRecord& record);
+};
+
+// -----------------------------------------------------------------------------
+
+#endif